@@ -0,0 +1,43 @@
+#ifndef _BROAD_PHASE_BENCHMARK_H_
+#define _BROAD_PHASE_BENCHMARK_H_
+
+#include "Behavior.h"
+#include "PhysicEngine.h"
+#include "GlobalVariables.h"
+#include "Renderer.h"
+#include "RenderWindow.h"
+
+#include <vector>
+
+class CBroadPhaseBenchmark : public CBehavior
+{
+private:
+	std::vector<SBroadPhaseBenchmarkResult> m_results;
+
+	virtual void Update(float frameTime) override
+	{
+		if (gVars->pRenderWindow->JustPressedKey(Key::F8))
+		{
+			m_results = gVars->pPhysicEngine->BenchmarkBroadPhases(60, 1.0f / 60.0f);
+		}
+
+		if (gVars->pRenderWindow->JustPressedKey(Key::F9))
+		{
+			gVars->pPhysicEngine->SetParallelBroadPhase(!gVars->pPhysicEngine->IsBroadPhaseParallel());
+		}
+
+		if (gVars->pRenderWindow->JustPressedKey(Key::F10))
+		{
+			gVars->pPhysicEngine->SetAutoBroadPhase(!gVars->pPhysicEngine->IsBroadPhaseAuto());
+		}
+
+		gVars->pRenderer->DisplayText("F6/F7: previous/next broad phase, F8: benchmark broad phases, F9: parallel pairs " + std::string(gVars->pPhysicEngine->IsBroadPhaseParallel() ? "on" : "off")
+			+ ", F10: automatic broad phase " + std::string(gVars->pPhysicEngine->IsBroadPhaseAuto() ? "on" : "off"));
+		for (const SBroadPhaseBenchmarkResult& result : m_results)
+		{
+			gVars->pRenderer->DisplayText(result.ToString());
+		}
+	}
+};
+
+#endif
@@ -10,28 +10,21 @@
 #include "Constraints/NoOverlap.h"
 #include "Constraints/CollisionResponse.h"
 #include "Constraints/WarmContacts.h"
-#include <unordered_set>
 
 #define ALIAS(source, var) auto& var = source . var ;
 
 class CPhysicsResponse : public CBehavior
 {
 private:
-	std::unordered_set<CPolygonPtr> set;
 	WarmContacts warmContacts;
 
+	// the constraints move the polygons without telling the broad phase, a polygon is only added once to its moved polygons
 	void UpdateTransforms()
 	{
-		set.reserve(gVars->pPhysicEngine->m_collidingPairs.size() * 2);
 		for (auto& collisions : gVars->pPhysicEngine->m_collidingPairs)
 		{
-			set.emplace(collisions.polyA);
-			set.emplace(collisions.polyB);
-		}
-
-		for (CPolygonPtr p : set)
-		{
-			p->OnTransformUpdated();
+			collisions.polyA->OnTransformUpdated();
+			collisions.polyB->OnTransformUpdated();
 		}
 	}
 
@@ -87,10 +87,11 @@ private:
 		broadPhase.GetCollidingPairsToCheck(pairsToCheck);
 		gVars->pRenderer->DisplayText("Amount of pairs to check : " + std::to_string(pairsToCheck.size()));
 
-		for (SPolygonPair pair : pairsToCheck)
+		const std::vector<CPolygonPtr>& worldPolygons = gVars->pWorld->GetPolygons();
+		for (const SPolygonPair& pair : pairsToCheck)
 		{
-			CPolygonPtr c1 = pair.GetpolyA();
-			CPolygonPtr c2 = pair.GetpolyB();
+			const CPolygonPtr& c1 = worldPolygons[pair.GetbodyA()];
+			const CPolygonPtr& c2 = worldPolygons[pair.GetbodyB()];
 			
 			Vec2 diffPos = c2->Getposition() - c1->Getposition();
 			Vec2 diffSpeed = c2->speed - c1->speed;
@@ -140,7 +141,7 @@ private:
 		circle->density = 0.0f;
 		circle->Setposition(pos);
 
-		broadPhase->OnObjectAdded(circle);
+		broadPhase.AddPolygon(circle);
 		m_circles.emplace_back(circle);
 
 		return circle;
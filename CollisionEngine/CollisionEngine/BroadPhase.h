@@ -2,13 +2,104 @@
 #define _BROAD_PHASE_H_
 
 #include "Polygon.h"
+#include "Parallel.h"
+#include "BroadPhases/MovedPolygons.h"
+#include "BroadPhases/ParallelPairs.h"
+#include "BroadPhases/StaticBodies.h"
 
+// The static bodies (infinite mass) are not given to OnObjectAdded : they are in the CStaticBodies set with SetStaticBodies,
+// and a broad phase only reports the pairs of its bodies together and with them.
+// The moved polygons are given to UpdateBodies at once before the query, rather than on every change of their transform.
 class IBroadPhase
 {
 public:
+	virtual ~IBroadPhase() = default;
+
 	virtual void OnObjectAdded(const CPolygonPtr& polygon) {} // = 0; // To call to add an object to the system
 	virtual void OnObjectRemoved(const CPolygonPtr& polygon) {} //= 0; // To call to remove an object from the system
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) = 0;
+	// The polygons moved since the previous call, each once, see TrackBody
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) {}
+
+	// To call before GetCollidingPairsToCheck
+	void UpdateMovedBodies()
+	{
+		if (movedPolygons.IsEmpty())
+			return;
+
+		UpdateBodies(movedPolygons.GetPolygons());
+		movedPolygons.Clear();
+	}
+
+	void SetStaticBodies(const CStaticBodies* newStaticBodies)
+	{
+		staticBodies = newStaticBodies;
+	}
+
+	// The broad phases going through AddPairs then find their pairs on every core, the same pairs in the same order whatever the amount of threads,
+	// and update their moved bodies through ForEachRange
+	void SetParallelPairs(bool newParallelPairs)
+	{
+		parallelPairs = newParallelPairs;
+	}
+
+protected:
+	const CStaticBodies* staticBodies = nullptr;
+	bool parallelPairs = false;
+
+	// Calls functor(begin, end, pairsToCheck) on [0, itemsCount), or on chunks of it on every core with their own pairs (see CParallelPairs),
+	// so the functor can't write in the broad phase, but in scratch buffers of its chunk (see CParallelPairs::GetChunk)
+	template<typename TFunctor>
+	void AddPairs(size_t itemsCount, std::vector<SPolygonPair>& pairsToCheck, TFunctor&& functor)
+	{
+		if (parallelPairs)
+			chunksPairs.AddPairs(itemsCount, pairsToCheck, functor);
+		else
+			functor(size_t(0), itemsCount, pairsToCheck);
+	}
+
+	// To call in GetCollidingPairsToCheck for every body of the broad phase
+	void AddStaticCollidingPairs(const CPolygonPtr& polygon, const AABB& aabb, std::vector<SPolygonPair>& pairsToCheck) const
+	{
+		if (staticBodies != nullptr)
+			staticBodies->AddCollidingPairs(polygon, aabb, pairsToCheck);
+	}
+
+	bool HasStaticBodies() const
+	{
+		return staticBodies != nullptr && !staticBodies->IsEmpty();
+	}
+
+	// To call in OnObjectAdded and OnObjectRemoved, the polygon is then given to UpdateBodies when moved, with its body (see GetBody)
+	void TrackBody(const CPolygonPtr& polygon, uint32_t body)
+	{
+		movedPolygons.Track(*polygon, body);
+	}
+
+	void UntrackBody(const CPolygonPtr& polygon)
+	{
+		movedPolygons.Untrack(*polygon);
+	}
+
+	static uint32_t GetBody(const CPolygon& polygon)
+	{
+		return polygon.broadPhaseBody;
+	}
+
+	// Calls functor(begin, end) on [0, count), split between the cores when parallel : for the moved bodies of UpdateBodies,
+	// each polygon being in the list once, so their AABBs can be computed at the same time
+	template<typename TFunctor>
+	void ForEachRange(size_t count, TFunctor&& functor)
+	{
+		if (parallelPairs)
+			ParallelFor(count, 256, functor);
+		else
+			functor(size_t(0), count);
+	}
+
+private:
+	CParallelPairs chunksPairs;
+	CMovedPolygons movedPolygons;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,57 +3,150 @@
 #include "BroadPhases/BroadPhaseBrut.h"
 #include "BroadPhases/BoundingVolume.h"
 #include "BroadPhases/AABBTree.h"
-#include "BroadPhases/Grid.h"
+#include "BroadPhases/HierarchicalGrid.h"
+#include "BroadPhases/LooseQuadTree.h"
+#include "BroadPhases/SpatialHash.h"
 #include "BroadPhases/SweepAndPrune.h"
-#include "BroadPhases/QuadTree.h"
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Timer.h"
+#include "Conversion.h"
+#include "Renderer.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	// automatic selection, see BroadPhaseSwitcher::STrials
+	constexpr int autoSelectSamplePeriod = 60; // frames between the statistics samples
+	constexpr int autoSelectMinSamplesBetweenTrials = 5;
+	constexpr size_t autoSelectMinPolygonsCount = 64; // the broad phases are all cheap under it
+	constexpr int autoSelectTrialFramesCount = 10; // measured frames per candidate, once it is filled
+	constexpr float autoSelectTrialsBudget = 0.5f; // ms per frame the trials take on average, a step over it is paid back by skipping the next frames
+	constexpr float autoSelectMinGain = 0.2f; // fraction of the current cost the candidate has to save to replace it
+	constexpr float autoSelectMaxDurationGrowth = 1.5f; // the current broad phase is tried again when it gets this much slower
+	constexpr int statisticsGridSize = 16;
+}
 
 BroadPhaseSwitcher::BroadPhaseSwitcher(std::vector<CPolygonPtr>& polygons) : m_polygons(polygons)
 {
-	broadPhasesGetters.emplace_back([&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CAABBToAABB>(polygons); });
-	broadPhasesGetters.emplace_back([&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CGrid>(1); });
-	broadPhasesGetters.emplace_back([&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CSweepAndPrune>(); });
-	broadPhasesGetters.emplace_back([&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CCircleToCircle>(polygons); });
-	broadPhasesGetters.emplace_back([&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CQuadTree>(); });
-	broadPhasesGetters.emplace_back([&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CBroadPhaseBrut>(polygons); });
+	broadPhases.push_back({ "AABB to AABB", true, [this]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CAABBToAABB>(m_dynamicPolygons); } });
+	broadPhases.push_back({ "Grid", false, [&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CSpatialHash>(1.f); } });
+	broadPhases.push_back({ "Hierarchical grid", false, [&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CHierarchicalGrid>(0.5f); } });
+	broadPhases.push_back({ "Sweep and prune", false, [&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CSweepAndPrune>(SweepMode::SingleAxis); } });
+	broadPhases.push_back({ "Sweep and prune, both axes", false, [&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CSweepAndPrune>(SweepMode::BothAxes); } });
+	broadPhases.push_back({ "Circle to circle", true, [this]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CCircleToCircle>(m_dynamicPolygons); } });
+	broadPhases.push_back({ "Quad tree", false, [&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CLooseQuadTree>(); } });
+	broadPhases.push_back({ "AABB tree", false, [&polygons]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CAABBTree>(); } });
+	broadPhases.push_back({ "Brut", true, [this]() -> std::unique_ptr<IBroadPhase> { return std::make_unique<CBroadPhaseBrut>(m_dynamicPolygons); } });
 }
 
 void BroadPhaseSwitcher::Reset()
 {
-	m_broadPhase = broadPhasesGetters[broadPhaseID]();
+	StopTrials();
+	m_selected = false;
+	m_framesSinceSample = 0;
+	m_duration = 0.f;
+	m_sampledPositions.clear();
+	m_trialsResults.clear();
+
+	// the broad phase is destroyed with its polygons, which must not add themselves to its moved polygons anymore
+	for (const CPolygonPtr& poly : m_dynamicPolygons)
+	{
+		poly->movedPolygons = nullptr;
+	}
+	m_dynamicPolygons.clear();
+	m_staticBodies.Clear();
+	m_broadPhase = broadPhases[broadPhaseID].getter();
+	m_broadPhase->SetStaticBodies(&m_staticBodies);
+	m_broadPhase->SetParallelPairs(m_parallelPairs);
 }
 
 void BroadPhaseSwitcher::NextBroadPhase()
 {
-	broadPhaseID = (broadPhaseID + 1 + broadPhasesGetters.size()) % broadPhasesGetters.size();
-	SetBroadPhase(broadPhasesGetters[broadPhaseID]());
+	broadPhaseID = (broadPhaseID + 1 + broadPhases.size()) % broadPhases.size();
+	SetBroadPhase(broadPhases[broadPhaseID].getter());
 }
 void BroadPhaseSwitcher::PreviousBroadPhase()
 {
-	broadPhaseID = (broadPhaseID - 1 + broadPhasesGetters.size()) % broadPhasesGetters.size();
-	SetBroadPhase(broadPhasesGetters[broadPhaseID]());
+	broadPhaseID = (broadPhaseID - 1 + broadPhases.size()) % broadPhases.size();
+	SetBroadPhase(broadPhases[broadPhaseID].getter());
 }
 
+bool BroadPhaseSwitcher::SelectBroadPhase(const std::string& name)
+{
+	for (size_t i = 0; i < broadPhases.size(); i++)
+	{
+		if (broadPhases[i].name == name)
+		{
+			broadPhaseID = int(i);
+			SetBroadPhase(broadPhases[i].getter());
+			return true;
+		}
+	}
+
+	return false;
+}
 
 void BroadPhaseSwitcher::SetBroadPhase(std::unique_ptr<IBroadPhase>&& newBroadPhase)
 {
-	std::vector<CPolygonPtr> oldPolygons(m_polygons);
+	std::vector<CPolygonPtr> oldPolygons(m_dynamicPolygons);
 
 	if (m_broadPhase != nullptr)
 	{
 		for (CPolygonPtr& poly : oldPolygons)
 		{
-			m_polygons.erase(std::remove(m_polygons.begin(), m_polygons.end(), poly), m_polygons.end());
+			m_dynamicPolygons.erase(std::remove(m_dynamicPolygons.begin(), m_dynamicPolygons.end(), poly), m_dynamicPolygons.end());
 			m_broadPhase->OnObjectRemoved(poly);
 		}
 	}
 
 	m_broadPhase = std::move(newBroadPhase);
+	m_broadPhase->SetStaticBodies(&m_staticBodies);
+	m_broadPhase->SetParallelPairs(m_parallelPairs);
 
 	for (CPolygonPtr& poly : oldPolygons)
 	{
 		m_broadPhase->OnObjectAdded(poly);
-		m_polygons.push_back(poly);
+		m_dynamicPolygons.push_back(poly);
+	}
+}
+
+void BroadPhaseSwitcher::SetParallelPairs(bool parallelPairs)
+{
+	m_parallelPairs = parallelPairs;
+	if (m_broadPhase != nullptr)
+		m_broadPhase->SetParallelPairs(parallelPairs);
+}
+
+void BroadPhaseSwitcher::AddPolygon(const CPolygonPtr& polygon)
+{
+	if (polygon->IsStatic())
+	{
+		m_staticBodies.Add(polygon);
+		return;
+	}
+
+	// the copies of the trials would miss it
+	StopTrials();
+
+	m_broadPhase->OnObjectAdded(polygon);
+	m_dynamicPolygons.push_back(polygon);
+}
+
+void BroadPhaseSwitcher::RemovePolygon(const CPolygonPtr& polygon)
+{
+	if (m_staticBodies.Contains(polygon))
+	{
+		m_staticBodies.Remove(polygon);
+		return;
 	}
+
+	StopTrials();
+
+	m_dynamicPolygons.erase(std::remove(m_dynamicPolygons.begin(), m_dynamicPolygons.end(), polygon), m_dynamicPolygons.end());
+	m_broadPhase->OnObjectRemoved(polygon);
 }
 
 void BroadPhaseSwitcher::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
@@ -63,12 +156,498 @@ void BroadPhaseSwitcher::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pai
 		poly->collisionState = CollisionState::NOT_COLLIDING;
 	}
 
-	m_broadPhase->GetCollidingPairsToCheck(pairsToCheck);
+	m_staticBodies.Update();
+	if (gVars->bDebug)
+		m_staticBodies.DisplayDebug();
+
+	if (m_autoSelect)
+	{
+		CTimer timer;
+		timer.Start();
+		m_broadPhase->UpdateMovedBodies();
+		m_broadPhase->GetCollidingPairsToCheck(pairsToCheck);
+		timer.Stop();
+		m_duration += timer.GetDuration();
+
+		UpdateAutoSelect();
+		if (gVars->bDebug)
+			DisplayAutoSelectDebug();
+	}
+	else
+	{
+		m_broadPhase->UpdateMovedBodies();
+		m_broadPhase->GetCollidingPairsToCheck(pairsToCheck);
+	}
 
 	// TODO : Clean?
-	for (auto& pair : pairsToCheck)
+	const std::vector<CPolygonPtr>& worldPolygons = gVars->pWorld->GetPolygons();
+	for (const SPolygonPair& pair : pairsToCheck)
+	{
+		worldPolygons[pair.GetbodyA()]->collisionState = CollisionState::BROAD_PHASE_SUCCESS;
+		worldPolygons[pair.GetbodyB()]->collisionState = CollisionState::BROAD_PHASE_SUCCESS;
+	}
+}
+
+std::string SBroadPhaseBenchmarkResult::ToString() const
+{
+	char text[256];
+	if (skipped)
+		snprintf(text, sizeof(text), "%s : skipped, quadratic with %zu polygons", name.c_str(), polygonsCount);
+	else
+		snprintf(text, sizeof(text), "%s%s : update %.2f ms, query %.2f ms, %zu pairs", name.c_str(), parallelPairs ? " (parallel pairs)" : "", updateDuration, queryDuration, pairsCount);
+	return text;
+}
+
+std::vector<SBroadPhaseBenchmarkResult> BroadPhaseSwitcher::Benchmark(int framesCount, float deltaTime, size_t maxQuadraticPolygonsCount)
+{
+	std::vector<SBroadPhaseBenchmarkResult> results;
+	if (m_dynamicPolygons.empty() || framesCount <= 0)
+		return results;
+
+	// the polygons are moved, the timings of the trials would be wrong
+	StopTrials();
+
+	// the benchmarked broad phases track the moves of the polygons
+	for (CPolygonPtr& poly : m_dynamicPolygons)
+	{
+		m_broadPhase->OnObjectRemoved(poly);
+	}
+
+	// debug display would be in the timings
+	bool wasDebug = gVars->bDebug;
+	gVars->bDebug = false;
+
+	std::vector<Vec2> initialPositions;
+	std::vector<Vec2> initialSpeeds;
+	AABB bounds = AABB(m_dynamicPolygons[0]->Getposition(), m_dynamicPolygons[0]->Getposition());
+	for (CPolygonPtr& poly : m_dynamicPolygons)
+	{
+		initialPositions.push_back(poly->Getposition());
+		initialSpeeds.push_back(poly->speed);
+		bounds.EnlargeWithPoint(poly->Getposition());
+	}
+
+	// the static polygons don't move, their hierarchy is built once for all the broad phases
+	m_staticBodies.Update();
+
+	std::vector<SPolygonPair> pairsToCheck;
+	for (const SBroadPhaseEntry& entry : broadPhases)
+	{
+		SBroadPhaseBenchmarkResult result;
+		result.name = entry.name;
+		result.polygonsCount = m_dynamicPolygons.size();
+		result.parallelPairs = m_parallelPairs;
+
+		if (entry.isQuadratic && m_dynamicPolygons.size() > maxQuadraticPolygonsCount)
+		{
+			result.skipped = true;
+			results.push_back(result);
+			continue;
+		}
+
+		// same as SetBroadPhase, some broad phases pair the added polygon with the registered ones
+		std::unique_ptr<IBroadPhase> broadPhase = entry.getter();
+		broadPhase->SetStaticBodies(&m_staticBodies);
+		broadPhase->SetParallelPairs(m_parallelPairs);
+		std::vector<CPolygonPtr> polygons;
+		polygons.swap(m_dynamicPolygons);
+		for (CPolygonPtr& poly : polygons)
+		{
+			broadPhase->OnObjectAdded(poly);
+			m_dynamicPolygons.push_back(poly);
+		}
+
+		CTimer timer;
+		float updateDuration = 0.f;
+		float queryDuration = 0.f;
+		size_t pairsCount = 0;
+		for (int frame = 0; frame < framesCount; frame++)
+		{
+			timer.Start();
+			for (CPolygonPtr& poly : m_dynamicPolygons)
+			{
+				Vec2 position = poly->Getposition() + poly->speed * deltaTime;
+				if ((position.x < bounds.pMin.x && poly->speed.x < 0.f) || (position.x > bounds.pMax.x && poly->speed.x > 0.f))
+					poly->speed.x *= -1.f;
+				if ((position.y < bounds.pMin.y && poly->speed.y < 0.f) || (position.y > bounds.pMax.y && poly->speed.y > 0.f))
+					poly->speed.y *= -1.f;
+
+				poly->SetTransform(position, poly->Getrotation());
+			}
+			broadPhase->UpdateMovedBodies();
+			timer.Stop();
+			updateDuration += timer.GetDuration();
+
+			pairsToCheck.clear();
+			timer.Start();
+			broadPhase->GetCollidingPairsToCheck(pairsToCheck);
+			timer.Stop();
+			queryDuration += timer.GetDuration();
+			pairsCount += pairsToCheck.size();
+		}
+
+		// the broad phase is destroyed with its polygons, removing them one by one is quadratic for some of them
+		for (CPolygonPtr& poly : m_dynamicPolygons)
+		{
+			poly->movedPolygons = nullptr;
+		}
+		broadPhase = nullptr;
+
+		for (size_t i = 0; i < m_dynamicPolygons.size(); i++)
+		{
+			m_dynamicPolygons[i]->Setposition(initialPositions[i]);
+			m_dynamicPolygons[i]->speed = initialSpeeds[i];
+		}
+
+		result.updateDuration = updateDuration * 1000.f / framesCount;
+		result.queryDuration = queryDuration * 1000.f / framesCount;
+		result.pairsCount = pairsCount / framesCount;
+		results.push_back(result);
+	}
+
+	gVars->bDebug = wasDebug;
+
+	for (CPolygonPtr& poly : m_dynamicPolygons)
+	{
+		m_broadPhase->OnObjectAdded(poly);
+	}
+
+	return results;
+}
+
+void BroadPhaseSwitcher::SetAutoSelect(bool autoSelect)
+{
+	m_autoSelect = autoSelect;
+	StopTrials();
+	m_selected = false;
+	m_framesSinceSample = 0;
+	m_duration = 0.f;
+	m_trialsResults.clear();
+}
+
+bool SBroadPhaseSceneStatistics::IsCloseTo(const SBroadPhaseSceneStatistics& other) const
+{
+	size_t minCount = Max<size_t>(Min(polygonsCount, other.polygonsCount), 1);
+	size_t maxCount = Max(polygonsCount, other.polygonsCount);
+	return maxCount < minCount + minCount / 2
+		&& fabsf(sizeVariation - other.sizeVariation) < 0.5f
+		&& fabsf(movingFraction - other.movingFraction) < 0.3f
+		&& fabsf(occupiedCellsFraction - other.occupiedCellsFraction) < 0.2f;
+}
+
+std::string SBroadPhaseSceneStatistics::ToString() const
+{
+	char text[256];
+	snprintf(text, sizeof(text), "%zu polygons, size variation %.2f, moving %.0f%%, occupied cells %.0f%%", polygonsCount, sizeVariation, movingFraction * 100.f, occupiedCellsFraction * 100.f);
+	return text;
+}
+
+void BroadPhaseSwitcher::SampleStatistics()
+{
+	SBroadPhaseSceneStatistics statistics;
+	statistics.polygonsCount = m_dynamicPolygons.size();
+	if (m_dynamicPolygons.empty())
+	{
+		m_statistics = statistics;
+		m_sampledPositions.clear();
+		return;
+	}
+
+	// the order of m_dynamicPolygons only changes when polygons are removed, they are then all counted as moving
+	bool samePolygons = m_sampledPositions.size() == m_dynamicPolygons.size();
+	size_t movingCount = 0;
+	float sizesSum = 0.f;
+	float squaredSizesSum = 0.f;
+	std::vector<Vec2> centers;
+	centers.reserve(m_dynamicPolygons.size());
+	AABB centersBounds;
+	for (size_t i = 0; i < m_dynamicPolygons.size(); i++)
+	{
+		const CPolygonPtr& poly = m_dynamicPolygons[i];
+		AABB aabb = PolyToMoveableAABB(poly).GetmovedAABB();
+		float size = Max(aabb.pMax.x - aabb.pMin.x, aabb.pMax.y - aabb.pMin.y);
+		sizesSum += size;
+		squaredSizesSum += size * size;
+
+		Vec2 center = (aabb.pMin + aabb.pMax) * 0.5f;
+		centers.push_back(center);
+		if (i == 0)
+			centersBounds = AABB(center, center);
+		else
+			centersBounds.EnlargeWithPoint(center);
+
+		if (!samePolygons || (poly->Getposition() - m_sampledPositions[i]).GetSqrLength() > 1e-6f)
+			movingCount++;
+	}
+
+	float count = float(m_dynamicPolygons.size());
+	float meanSize = sizesSum / count;
+	float sizesVariance = Max(squaredSizesSum / count - meanSize * meanSize, 0.f);
+	statistics.sizeVariation = meanSize > 0.f ? sqrtf(sizesVariance) / meanSize : 0.f;
+	statistics.movingFraction = movingCount / count;
+
+	// as many cells as polygons at most, so evenly spread polygons give a fraction close to 1
+	bool occupiedCells[statisticsGridSize * statisticsGridSize] = {};
+	Vec2 extent = centersBounds.pMax - centersBounds.pMin;
+	float cellsPerUnitX = extent.x > 0.f ? (statisticsGridSize - 1) / extent.x : 0.f;
+	float cellsPerUnitY = extent.y > 0.f ? (statisticsGridSize - 1) / extent.y : 0.f;
+	size_t occupiedCellsCount = 0;
+	for (const Vec2& center : centers)
+	{
+		int x = int((center.x - centersBounds.pMin.x) * cellsPerUnitX);
+		int y = int((center.y - centersBounds.pMin.y) * cellsPerUnitY);
+		bool& occupied = occupiedCells[y * statisticsGridSize + x];
+		if (!occupied)
+		{
+			occupied = true;
+			occupiedCellsCount++;
+		}
+	}
+	statistics.occupiedCellsFraction = float(occupiedCellsCount) / float(Min<size_t>(m_dynamicPolygons.size(), statisticsGridSize * statisticsGridSize));
+
+	m_statistics = statistics;
+	m_sampledPositions.resize(m_dynamicPolygons.size());
+	for (size_t i = 0; i < m_dynamicPolygons.size(); i++)
+	{
+		m_sampledPositions[i] = m_dynamicPolygons[i]->Getposition();
+	}
+}
+
+void BroadPhaseSwitcher::UpdateAutoSelect()
+{
+	if (m_trials.IsRunning())
+		UpdateTrials();
+
+	if (++m_framesSinceSample < autoSelectSamplePeriod)
+		return;
+
+	float duration = m_duration * 1000.f / m_framesSinceSample;
+	m_framesSinceSample = 0;
+	m_duration = 0.f;
+	m_samplesSinceTrials++;
+	SampleStatistics();
+
+	if (m_trials.IsRunning() || m_dynamicPolygons.size() < autoSelectMinPolygonsCount)
+		return;
+
+	// the reference of the selected broad phase, measured once it runs alone
+	if (m_selected && m_selectedDuration == 0.f)
+	{
+		m_selectedDuration = Max(duration, 1e-3f);
+		return;
+	}
+
+	bool sceneChanged = !m_selected || !m_statistics.IsCloseTo(m_selectedStatistics);
+	bool slower = m_selected && duration > m_selectedDuration * autoSelectMaxDurationGrowth;
+	if ((sceneChanged || slower) && (!m_selected || m_samplesSinceTrials >= autoSelectMinSamplesBetweenTrials))
+		StartTrials();
+}
+
+void BroadPhaseSwitcher::StartTrials()
+{
+	for (size_t i = 0; i < broadPhases.size(); i++)
+	{
+		// the quadratic broad phases read the list of polygons of the switcher, and are the references to check the others with
+		if (!broadPhases[i].isQuadratic)
+			m_trials.candidates.push_back(int(i));
+	}
+
+	if (m_trials.candidates.empty())
+		return;
+
+	// the copies are made by UpdateTrials, a few at a time
+	m_trials.polygons.reserve(m_dynamicPolygons.size());
+	m_trials.previousPositions.resize(m_dynamicPolygons.size());
+	for (size_t i = 0; i < m_dynamicPolygons.size(); i++)
+	{
+		m_trials.previousPositions[i] = m_dynamicPolygons[i]->Getposition();
+	}
+	m_trials.results.clear();
+	m_trials.broadPhase = nullptr;
+	m_trials.statistics = m_statistics;
+	m_samplesSinceTrials = 0;
+}
+
+void BroadPhaseSwitcher::StopTrials()
+{
+	// destroyed with its polygons, as in Benchmark
+	for (const CPolygonPtr& poly : m_trials.polygons)
+	{
+		poly->movedPolygons = nullptr;
+	}
+	m_trials.broadPhase = nullptr;
+	m_trials.addedCount = 0;
+	m_trials.polygons.clear();
+	m_trials.candidates.clear();
+	m_trials.pairsToCheck.clear();
+	m_trials.previousPositions.clear();
+	m_trials.overBudgetDuration = 0.f;
+}
+
+void BroadPhaseSwitcher::UpdateTrials()
+{
+	if (m_trials.overBudgetDuration > 0.f)
+		m_trials.overBudgetDuration = Max(m_trials.overBudgetDuration - autoSelectTrialsBudget, 0.f);
+	else
+		UpdateTrialsStep();
+
+	// StopTrials is called when the trials end
+	if (!m_trials.IsRunning())
+		return;
+
+	for (size_t i = 0; i < m_dynamicPolygons.size(); i++)
 	{
-		pair.GetpolyA()->collisionState = CollisionState::BROAD_PHASE_SUCCESS;
-		pair.GetpolyB()->collisionState = CollisionState::BROAD_PHASE_SUCCESS;
+		m_trials.previousPositions[i] = m_dynamicPolygons[i]->Getposition();
 	}
-}
\ No newline at end of file
+}
+
+void BroadPhaseSwitcher::UpdateTrialsStep()
+{
+	// debug display would be in the timings
+	bool wasDebug = gVars->bDebug;
+	gVars->bDebug = false;
+
+	CTimer stepTimer;
+	stepTimer.Start();
+	auto isOverBudget = [&stepTimer]()
+	{
+		stepTimer.Stop();
+		return stepTimer.GetDuration() * 1000.f >= autoSelectTrialsBudget;
+	};
+
+	if (m_trials.polygons.size() < m_dynamicPolygons.size())
+	{
+		do
+		{
+			m_trials.polygons.push_back(m_dynamicPolygons[m_trials.polygons.size()]->CreateShapeCopy());
+		} while (m_trials.polygons.size() < m_dynamicPolygons.size() && !isOverBudget());
+	}
+	else if (m_trials.addedCount < m_trials.polygons.size())
+	{
+		if (m_trials.broadPhase == nullptr)
+		{
+			const SBroadPhaseEntry& entry = broadPhases[m_trials.candidates[m_trials.results.size()]];
+			m_trials.broadPhase = entry.getter();
+			m_trials.broadPhase->SetStaticBodies(&m_staticBodies);
+			m_trials.broadPhase->SetParallelPairs(m_parallelPairs);
+
+			SBroadPhaseBenchmarkResult result;
+			result.name = entry.name;
+			result.polygonsCount = m_trials.polygons.size();
+			result.parallelPairs = m_parallelPairs;
+			m_trials.results.push_back(result);
+			m_trials.frame = 0;
+		}
+
+		do
+		{
+			m_trials.broadPhase->OnObjectAdded(m_trials.polygons[m_trials.addedCount++]);
+		} while (m_trials.addedCount < m_trials.polygons.size() && !isOverBudget());
+	}
+	else
+	{
+		UpdateTrialFrame();
+	}
+
+	stepTimer.Stop();
+	m_trials.overBudgetDuration = Max(stepTimer.GetDuration() * 1000.f - autoSelectTrialsBudget, 0.f);
+	gVars->bDebug = wasDebug;
+}
+
+void BroadPhaseSwitcher::UpdateTrialFrame()
+{
+	// the moves of the last frame, so that the copies of the moved polygons are updated in the timings, as in the current broad phase
+	for (size_t i = 0; i < m_trials.polygons.size(); i++)
+	{
+		const CPolygonPtr& poly = m_dynamicPolygons[i];
+		Vec2 move = poly->Getposition() - m_trials.previousPositions[i];
+		if (move == Vec2::Zero())
+			continue;
+
+		const CPolygonPtr& copy = m_trials.polygons[i];
+		copy->speed = poly->speed;
+		copy->SetTransform(copy->Getposition() + move, poly->Getrotation());
+	}
+
+	SBroadPhaseBenchmarkResult& result = m_trials.results.back();
+	CTimer timer;
+	timer.Start();
+	m_trials.broadPhase->UpdateMovedBodies();
+	timer.Stop();
+	result.updateDuration += timer.GetDuration();
+
+	m_trials.pairsToCheck.clear();
+	timer.Start();
+	m_trials.broadPhase->GetCollidingPairsToCheck(m_trials.pairsToCheck);
+	timer.Stop();
+	result.queryDuration += timer.GetDuration();
+	result.pairsCount += m_trials.pairsToCheck.size();
+	m_trials.pairsToCheck.clear();
+
+	if (++m_trials.frame < autoSelectTrialFramesCount)
+		return;
+
+	result.updateDuration *= 1000.f / autoSelectTrialFramesCount;
+	result.queryDuration *= 1000.f / autoSelectTrialFramesCount;
+	result.pairsCount /= autoSelectTrialFramesCount;
+
+	for (const CPolygonPtr& poly : m_trials.polygons)
+	{
+		poly->movedPolygons = nullptr;
+	}
+	m_trials.broadPhase = nullptr;
+	m_trials.addedCount = 0;
+
+	if (m_trials.results.size() == m_trials.candidates.size())
+		SelectFromTrials();
+}
+
+void BroadPhaseSwitcher::SelectFromTrials()
+{
+	size_t best = 0;
+	size_t current = m_trials.candidates.size();
+	for (size_t i = 0; i < m_trials.candidates.size(); i++)
+	{
+		const SBroadPhaseBenchmarkResult& result = m_trials.results[i];
+		const SBroadPhaseBenchmarkResult& bestResult = m_trials.results[best];
+		if (result.updateDuration + result.queryDuration < bestResult.updateDuration + bestResult.queryDuration)
+			best = i;
+		if (m_trials.candidates[i] == broadPhaseID)
+			current = i;
+	}
+
+	// the current one is replaced when quadratic, it is not tried
+	const SBroadPhaseBenchmarkResult& bestResult = m_trials.results[best];
+	bool switchBroadPhase = current == m_trials.candidates.size();
+	if (!switchBroadPhase && best != current)
+	{
+		const SBroadPhaseBenchmarkResult& currentResult = m_trials.results[current];
+		float currentDuration = currentResult.updateDuration + currentResult.queryDuration;
+		switchBroadPhase = bestResult.updateDuration + bestResult.queryDuration < currentDuration * (1.f - autoSelectMinGain);
+	}
+
+	if (switchBroadPhase)
+	{
+		broadPhaseID = m_trials.candidates[best];
+		SetBroadPhase(broadPhases[broadPhaseID].getter());
+	}
+
+	m_trialsResults = m_trials.results;
+	m_selected = true;
+	m_selectedStatistics = m_trials.statistics;
+	m_selectedDuration = 0.f;
+	m_framesSinceSample = 0;
+	m_duration = 0.f;
+	StopTrials();
+}
+
+void BroadPhaseSwitcher::DisplayAutoSelectDebug()
+{
+	std::string state = m_trials.IsRunning() ? ", trying " + std::to_string(m_trials.results.size()) + "/" + std::to_string(m_trials.candidates.size()) : "";
+	gVars->pRenderer->DisplayText("Automatic broad phase : " + broadPhases[broadPhaseID].name + state);
+	gVars->pRenderer->DisplayText(m_statistics.ToString());
+	for (const SBroadPhaseBenchmarkResult& result : m_trialsResults)
+	{
+		gVars->pRenderer->DisplayText(result.ToString());
+	}
+}
@@ -3,28 +3,144 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <string>
 #include "BroadPhase.h"
 
+struct SBroadPhaseEntry
+{
+	std::string name;
+	bool isQuadratic; // tests every pair of polygons
+	std::function<std::unique_ptr<IBroadPhase>()> getter;
+};
+
+struct SBroadPhaseBenchmarkResult
+{
+	std::string name;
+	size_t polygonsCount = 0;
+	bool skipped = false; // quadratic broad phase with too many polygons
+	bool parallelPairs = false;
+	float updateDuration = 0.f; // ms per frame to move the polygons and update the broad phase (UpdateMovedBodies)
+	float queryDuration = 0.f; // ms per frame of GetCollidingPairsToCheck
+	size_t pairsCount = 0; // per frame, on average
+
+	std::string ToString() const;
+};
+
+// Sampled periodically by the automatic selection of the broad phase, over the dynamic polygons
+struct SBroadPhaseSceneStatistics
+{
+	size_t polygonsCount = 0;
+	float sizeVariation = 0.f; // standard deviation of the AABBs sizes over their mean
+	float movingFraction = 0.f; // polygons moved since the previous sample
+	float occupiedCellsFraction = 0.f; // cells of a coarse grid over the scene holding polygons, low when they are clustered
+
+	// Whether a broad phase chosen for one scene still fits the other
+	bool IsCloseTo(const SBroadPhaseSceneStatistics& other) const;
+	std::string ToString() const;
+};
+
+// The static polygons (infinite mass) are kept by the switcher rather than by the broad phases, so switching doesn't rebuild them
 class BroadPhaseSwitcher
 {
 	int broadPhaseID = 0;
+	CStaticBodies m_staticBodies;
 	std::unique_ptr<IBroadPhase> m_broadPhase;
 	std::vector<CPolygonPtr>& m_polygons;
+	std::vector<CPolygonPtr> m_dynamicPolygons; // the ones given to the broad phase
+	bool m_parallelPairs = false;
+
+	// Automatic selection : the non quadratic broad phases are tried in turn on a snapshot of the dynamic polygons,
+	// and the cheapest replaces the current one when enough cheaper.
+	// The trials take a time budget per frame on average : the copies are made and added to a candidate a few at a time, and the frames
+	// after a step going over the budget (a measured frame, a switch) are skipped. A measured frame replays the moves of the polygons
+	// over the last frame on their copies, so a candidate updates the same bodies by the same moves as the current broad phase,
+	// however many frames were skipped. The trials run between the steps on the main thread, where the transforms are read
+	// consistently, their updates and queries using the job system.
+	struct STrials
+	{
+		std::vector<CPolygonPtr> polygons; // copies of m_dynamicPolygons, in the same order
+		std::vector<Vec2> previousPositions; // of m_dynamicPolygons, on the previous frame
+		std::vector<int> candidates;
+		std::vector<SBroadPhaseBenchmarkResult> results; // of the tried candidates
+		std::unique_ptr<IBroadPhase> broadPhase; // of the candidate being tried
+		size_t addedCount = 0; // copies added to broadPhase, its measured frames start once they all are
+		int frame = 0;
+		SBroadPhaseSceneStatistics statistics; // when started
+		std::vector<SPolygonPair> pairsToCheck;
+		float overBudgetDuration = 0.f; // ms, paid back by skipping frames
+
+		bool IsRunning() const
+		{
+			return !candidates.empty();
+		}
+	};
+
+	bool m_autoSelect = false;
+	int m_framesSinceSample = 0;
+	int m_samplesSinceTrials = 0;
+	float m_duration = 0.f; // s, updates and queries of the current broad phase since the previous sample
+	float m_selectedDuration = 0.f; // ms per frame, over the first sample period after the selection, 0 until then
+	bool m_selected = false;
+	SBroadPhaseSceneStatistics m_statistics;
+	SBroadPhaseSceneStatistics m_selectedStatistics;
+	std::vector<Vec2> m_sampledPositions;
+	STrials m_trials;
+	std::vector<SBroadPhaseBenchmarkResult> m_trialsResults; // of the last selection
+
+	void UpdateAutoSelect();
+	void SampleStatistics();
+	void StartTrials();
+	void UpdateTrials();
+	void UpdateTrialsStep();
+	void UpdateTrialFrame();
+	void StopTrials();
+	void SelectFromTrials();
+	void DisplayAutoSelectDebug();
 
 public:
 	BroadPhaseSwitcher(std::vector<CPolygonPtr>& polygons);
-	std::vector<std::function<std::unique_ptr<IBroadPhase>()>> broadPhasesGetters;
+	std::vector<SBroadPhaseEntry> broadPhases;
 
 	void NextBroadPhase();
 	void PreviousBroadPhase();
 	void SetBroadPhase(std::unique_ptr<IBroadPhase>&& newBroadPhase);
+	// Returns false if there is no broad phase with this name
+	bool SelectBroadPhase(const std::string& name);
+
+	// Applied to every broad phase, see IBroadPhase::SetParallelPairs
+	void SetParallelPairs(bool parallelPairs);
+	bool GetParallelPairs() const
+	{
+		return m_parallelPairs;
+	}
+
+	// The broad phase is then chosen from the statistics of the scene and the timings of the alternatives, see STrials
+	void SetAutoSelect(bool autoSelect);
+	bool GetAutoSelect() const
+	{
+		return m_autoSelect;
+	}
+
+	const std::string& GetBroadPhaseName() const
+	{
+		return broadPhases[broadPhaseID].name;
+	}
 
 	IBroadPhase* operator->()
 	{
 		return m_broadPhase.get();
 	}
 
+	// To call instead of IBroadPhase::OnObjectAdded and OnObjectRemoved, before adding the polygon to the list given at construction
+	// and after removing it : whether the polygon is static is read when it is added
+	void AddPolygon(const CPolygonPtr& polygon);
+	void RemovePolygon(const CPolygonPtr& polygon);
+
 	void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck);
 
 	void Reset();
+
+	// Every broad phase is filled with the dynamic polygons, which move in straight lines for framesCount frames,
+	// bouncing on the bounds of their initial positions. The polygons are then put back where they were.
+	std::vector<SBroadPhaseBenchmarkResult> Benchmark(int framesCount, float deltaTime, size_t maxQuadraticPolygonsCount = 2000);
 };
\ No newline at end of file
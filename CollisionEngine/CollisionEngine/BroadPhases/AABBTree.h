@@ -2,352 +2,526 @@
 #define _AABB_TREE_H_
 
 #include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 #include "BroadPhase.h"
 
+#include "Conversion.h"
 #include "Polygon.h"
 #include "GlobalVariables.h"
 #include "World.h"
+#include "Renderer.h"
 
-class PolygonWithAABB
+// Dynamic bounding volume hierarchy : leaves hold fattened AABBs of the polygons, so a polygon moving a bit
+// doesn't change the tree. When it leaves its fat AABB, its leaf is removed and inserted again.
+// Nodes live in a contiguous pool and are referenced by index, freed nodes are chained in a free list.
+class CAABBTree : public IBroadPhase
 {
-	CPolygonPtr polygon;
+	static constexpr int nullNode = -1;
 
-	void OnPolygonSet()
+	struct Node
 	{
-		moveableAABB = PolyToMoveableAABB(polygon);
-	}
+		AABB fatAABB; // bounds of the children for internal nodes
+		MoveableAABB tightAABB; // leaves only : AABB of the polygon, its moved AABB filtering the pairs
 
-public:
-	MoveableAABB moveableAABB;
+		CPolygonPtr polygon; // leaves only
 
-	using Type = PolygonWithAABB;
+		union
+		{
+			int parent;
+			int next; // free list
+		};
 
-	GETTER(polygon)
-	SETTER(polygon, OnPolygonSet)
+		int child1 = nullNode;
+		int child2 = nullNode;
 
-	PolygonWithAABB() = default;
-	PolygonWithAABB(const CPolygonPtr& poly)
-	{
-		Setpolygon(poly);
-	}
+		int height = 0; // 0 for leaves, -1 for free nodes
 
-	static void Update(PolygonWithAABB& object)
-	{
-		UpdateAABBTransformFromPolygon(object.moveableAABB, *object.polygon);
-	}
+		bool IsLeaf() const
+		{
+			return child1 == nullNode;
+		}
+	};
 
-	static float ComputeCost(const PolygonWithAABB& object1)
-	{
-		return 2.f * object1.moveableAABB.GetmovedAABB().GetArea();
-	}
+	std::vector<Node> nodes;
+	int root = nullNode;
+	int freeList = nullNode;
+	size_t leavesCount = 0;
 
-	static float ComputeMergeCost(const PolygonWithAABB& object1, const PolygonWithAABB& object2)
-	{
-		AABB mergedAABB = object1.moveableAABB.GetmovedAABB().Merge(object2.moveableAABB.GetmovedAABB());
-		return 2.f * mergedAABB.GetArea();
-	}
+	std::unordered_map<const CPolygon*, int> polygonsLeaves;
 
-	inline bool operator==(const PolygonWithAABB& rhs) const
+	// Traversals scratch
+	struct NodesPair
 	{
-		return polygon == rhs.polygon;
-	}
-};
+		int first;
+		int second;
+	};
+	std::vector<NodesPair> pairsStack;
+	std::vector<NodesPair> subtreesPairs; // next level of the traversal, when split between the threads
+	std::vector<NodesPair> chunksStacks[CParallelPairs::chunksCount]; // traversal of each chunk, kept for the next queries
+	struct InsertionCandidate
+	{
+		int node;
+		float inheritedCost; // perimeter increase of the ancestors
+	};
+	std::vector<InsertionCandidate> insertionCandidates;
+	std::vector<uint8_t> movedLeavesReinserted; // of the polygons given to UpdateBodies
 
-template<typename I_BOUNDING_VOLUME>
-class BoundingVolumeHierarchyNode
-{
 public:
-	typename I_BOUNDING_VOLUME::Type object;
+	float margin = 0.1f; // added around every fat AABB
+	float predictionDuration = 0.4f; // fat AABBs are extended by the motion of the polygon during this duration, in seconds
+	float maxFatAreaRatio = 4.f; // a leaf much larger than its polygon (the polygon slowed down) is shrunk
 
-	BoundingVolumeHierarchyNode* parent = nullptr;
-
-	BoundingVolumeHierarchyNode* left = nullptr;
-	BoundingVolumeHierarchyNode* right = nullptr;
-
-	using TNodePtr = BoundingVolumeHierarchyNode<I_BOUNDING_VOLUME>*;
-
-	inline BoundingVolumeHierarchyNode*& GetDirectChildRef(BoundingVolumeHierarchyNode* child)
+	virtual void OnObjectAdded(const CPolygonPtr& polygon) override
 	{
-		return left == child ? left : right;
+		int leaf = AllocateNode();
+		nodes[leaf].polygon = polygon;
+		nodes[leaf].tightAABB = PolyToMoveableAABB(polygon);
+		nodes[leaf].fatAABB = ComputeFatAABB(nodes[leaf].tightAABB.GetmovedAABB(), polygon->speed);
+		InsertLeaf(leaf);
+
+		polygonsLeaves.emplace(polygon.get(), leaf);
+		leavesCount++;
+		TrackBody(polygon, uint32_t(leaf));
 	}
 
-	inline bool IsLeaf() const
+	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
 	{
-		return left == nullptr && right == nullptr; // right should already be null if left is null, but just checking
-	}
+		auto it = polygonsLeaves.find(polygon.get());
+		if (it == polygonsLeaves.end())
+			return;
 
-	inline bool IsRoot() const
-	{
-		return parent == nullptr;
-	}
+		UntrackBody(polygon);
 
-	static TNodePtr CreateParentNode()
-	{
-		return new BoundingVolumeHierarchyNode<I_BOUNDING_VOLUME>();
+		RemoveLeaf(it->second);
+		FreeNode(it->second);
+		polygonsLeaves.erase(it);
+		leavesCount--;
 	}
 
-	void InsertLeaf(BoundingVolumeHierarchyNode* nodeToInsert, BoundingVolumeHierarchyNode*& rootRef)
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
 	{
-		assert(nodeToInsert->parent == nullptr);
-		assert(nodeToInsert->left == nullptr);
-		assert(nodeToInsert->right == nullptr);
+		// the leaves staying in their fat AABB don't change the tree, only the others are inserted again, one at a time
+		movedLeavesReinserted.resize(polygons.size());
+		ForEachRange(polygons.size(), [this, &polygons](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Node& leafNode = nodes[GetBody(*polygons[i])];
+				UpdateAABBTransformFromPolygon(leafNode.tightAABB, *polygons[i]);
+				movedLeavesReinserted[i] = MustReinsertLeaf(leafNode, *polygons[i]) ? 1 : 0;
+			}
+		});
 
-		auto addDirectChild = [nodeToInsert, &rootRef](BoundingVolumeHierarchyNode* sibling)
+		for (size_t i = 0; i < polygons.size(); i++)
 		{
-			TNodePtr newParent = CreateParentNode();
+			if (movedLeavesReinserted[i] != 0)
+				ReinsertLeaf(int(GetBody(*polygons[i])), *polygons[i]);
+		}
+	}
 
-			newParent->parent = sibling->parent;
-			newParent->object.moveableAABB.SetbaseAABB(nodeToInsert->object.moveableAABB.GetmovedAABB().Merge(sibling->object.moveableAABB.GetmovedAABB()));
-			newParent->left = sibling;
-			newParent->right = nodeToInsert;
-			nodeToInsert->parent = newParent;
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
+	{
+		if (gVars->bDebug)
+			DisplayDebug();
 
+		if (root == nullNode)
+			return;
 
-			if (sibling->parent == nullptr)
+		pairsStack.clear();
+		pairsStack.push_back({ root, root });
+		if (parallelPairs)
+		{
+			// the first levels of the traversal are done here, until there are enough entries for each chunk to traverse a few subtrees
+			while (!pairsStack.empty() && pairsStack.size() < CParallelPairs::chunksCount * 4)
 			{
-				rootRef = newParent;
+				subtreesPairs.clear();
+				for (const NodesPair& pair : pairsStack)
+				{
+					TraversePair(pair, subtreesPairs, pairsToCheck);
+				}
+				pairsStack.swap(subtreesPairs);
 			}
-			else
+
+			AddPairs(pairsStack.size(), pairsToCheck, [this](size_t firstPair, size_t lastPair, std::vector<SPolygonPair>& chunkPairs)
 			{
-				sibling->parent->GetDirectChildRef(sibling) = newParent;
+				// empty once traversed
+				std::vector<NodesPair>& chunkStack = chunksStacks[CParallelPairs::GetChunk(firstPair, pairsStack.size())];
+				chunkStack.assign(pairsStack.begin() + firstPair, pairsStack.begin() + lastPair);
+				while (!chunkStack.empty())
+				{
+					NodesPair pair = chunkStack.back();
+					chunkStack.pop_back();
+					TraversePair(pair, chunkStack, chunkPairs);
+				}
+			});
+		}
+		else
+		{
+			while (!pairsStack.empty())
+			{
+				NodesPair pair = pairsStack.back();
+				pairsStack.pop_back();
+				TraversePair(pair, pairsStack, pairsToCheck);
 			}
-			//fixUpwardsTree(nodeToInsert->parent);
-
-			sibling->parent = newParent;
-		};
+		}
 
-		if (!IsLeaf())
+		if (HasStaticBodies())
 		{
-			float newParentCost = I_BOUNDING_VOLUME::ComputeMergeCost(object, nodeToInsert->object);
-
-			float minPushCost = newParentCost - I_BOUNDING_VOLUME::ComputeCost(object);
-
-			auto computeChildCost = [nodeToInsert](BoundingVolumeHierarchyNode* child) -> float
+			AddPairs(nodes.size(), pairsToCheck, [this](size_t firstNode, size_t lastNode, std::vector<SPolygonPair>& chunkPairs)
 			{
-				if (child == nullptr)
-					return 0.f;
+				for (size_t nodeIndex = firstNode; nodeIndex < lastNode; nodeIndex++)
+				{
+					const Node& node = nodes[nodeIndex];
+					if (node.height == 0)
+						AddStaticCollidingPairs(node.polygon, node.tightAABB.GetmovedAABB(), chunkPairs);
+				}
+			});
+		}
+	}
 
-				float cost;
+	int GetHeight() const
+	{
+		return root == nullNode ? 0 : nodes[root].height;
+	}
 
-				cost = I_BOUNDING_VOLUME::ComputeMergeCost(child->object, nodeToInsert->object);
+	// Sum of the perimeters of the internal nodes relative to the root one, what the SAH minimizes
+	float GetAreaRatio() const
+	{
+		if (root == nullNode)
+			return 0.f;
 
-				if (!child->IsLeaf())
-				{
-					cost -= I_BOUNDING_VOLUME::ComputeCost(child->object);
-				}
+		float totalPerimeter = 0.f;
+		for (const Node& node : nodes)
+		{
+			if (node.height > 0)
+				totalPerimeter += GetPerimeter(node.fatAABB);
+		}
 
-				return cost;
-			};
+		return totalPerimeter / GetPerimeter(nodes[root].fatAABB);
+	}
 
-			float leftCost = computeChildCost(left);
-			float rightCost = computeChildCost(right);
+	void DisplayDebug()
+	{
+		gVars->pRenderer->DisplayText("AABB Tree, height " + std::to_string(GetHeight()) + ", area ratio " + std::to_string(GetAreaRatio()));
 
-			if ((newParentCost < leftCost && newParentCost < rightCost) || (left == nullptr) || (right == nullptr))
-			{
-				addDirectChild(this);
-				return;
-			}
+		for (const Node& node : nodes)
+		{
+			if (node.height < 0)
+				continue;
 
-			if (leftCost < rightCost)
-			{
-				left->InsertLeaf(nodeToInsert, rootRef);
-			}
+			if (node.IsLeaf())
+				gVars->pRenderer->DrawAABB(node.fatAABB, 0.3f, 0.3f, 0.3f);
 			else
 			{
-				right->InsertLeaf(nodeToInsert, rootRef);
+				float depthColor = Max(0.1f, 1.f - 0.1f * (GetHeight() - node.height));
+				gVars->pRenderer->DrawAABB(node.fatAABB, depthColor, 0, 0);
 			}
 		}
-		else
-		{
-			addDirectChild(this);
-		}
 	}
 
-	BoundingVolumeHierarchyNode*& GetSibling() 
+private:
+	static float GetPerimeter(const AABB& aabb)
 	{
-		assert(!IsRoot());
-		return parent->left == this ? right : left;
+		return 2.f * ((aabb.pMax.x - aabb.pMin.x) + (aabb.pMax.y - aabb.pMin.y));
 	}
 
-	void RemoveLeaf(BoundingVolumeHierarchyNode*& refToParent)
+	// Simultaneous traversal of the tree against itself : a node is tested against itself by testing its children
+	// against themselves and against each other, so every pair of leaves is reached once.
+	// Entries with first == second are self tests, the others overlap tests. The entries below this one go in the stack.
+	void TraversePair(const NodesPair& pair, std::vector<NodesPair>& stack, std::vector<SPolygonPair>& pairsToCheck) const
 	{
-		assert(!IsRoot());
-
-		BoundingVolumeHierarchyNode* grandParent = parent->parent;
-		BoundingVolumeHierarchyNode* sibling = GetSibling();
+		const Node& nodeA = nodes[pair.first];
+		if (pair.first == pair.second)
+		{
+			if (!nodeA.IsLeaf())
+			{
+				stack.push_back({ nodeA.child1, nodeA.child1 });
+				stack.push_back({ nodeA.child2, nodeA.child2 });
+				stack.push_back({ nodeA.child1, nodeA.child2 });
+			}
+			return;
+		}
 
-		//// TODO : Assert sibling?
-		//if (grandParent == nullptr)
-		//{
-		//	root = sibling;
-		//	sibling->parent = nullptr;
-		//	destroy(parent);
-		//}
+		const Node& nodeB = nodes[pair.second];
+		if (!nodeA.fatAABB.CheckCollision(nodeB.fatAABB))
+			return;
 
-		//else
-		//{
-		//	grandParent->GetDirectChildRef(parent) = sibling;
-		//	sibling->parent = grandParent;
+		if (nodeA.IsLeaf() && nodeB.IsLeaf())
+		{
+			if (nodeA.tightAABB.GetmovedAABB().CheckCollision(nodeB.tightAABB.GetmovedAABB()))
+				pairsToCheck.push_back(SPolygonPair(nodeA.polygon, nodeB.polygon));
+		}
+		// the largest node is split, so both sides of a pair stay about the same size
+		else if (nodeB.IsLeaf() || (!nodeA.IsLeaf() && GetPerimeter(nodeA.fatAABB) > GetPerimeter(nodeB.fatAABB)))
+		{
+			stack.push_back({ nodeA.child1, pair.second });
+			stack.push_back({ nodeA.child2, pair.second });
+		}
+		else
+		{
+			stack.push_back({ pair.first, nodeB.child1 });
+			stack.push_back({ pair.first, nodeB.child2 });
+		}
+	}
 
-		//	destroy(parent);
+	static bool Contains(const AABB& outer, const AABB& inner)
+	{
+		return outer.pMin.x <= inner.pMin.x && outer.pMin.y <= inner.pMin.y
+			&& outer.pMax.x >= inner.pMax.x && outer.pMax.y >= inner.pMax.y;
+	}
 
-		//	fixUpwardsTree(grandParent);
-		//}
+	AABB ComputeFatAABB(const AABB& tightAABB, const Vec2& speed) const
+	{
+		AABB fatAABB = AABB(tightAABB.pMin - Vec2(margin, margin), tightAABB.pMax + Vec2(margin, margin));
 
-		refToParent = sibling;
-		if (sibling != nullptr)
-			sibling->parent = grandParent;
+		// only extended in the direction of the motion
+		Vec2 displacement = speed * predictionDuration;
+		if (displacement.x < 0.f)
+			fatAABB.pMin.x += displacement.x;
+		else
+			fatAABB.pMax.x += displacement.x;
 
-		//destroy(parent);
-		parent = nullptr;
-		left = nullptr;
-		right = nullptr;
+		if (displacement.y < 0.f)
+			fatAABB.pMin.y += displacement.y;
+		else
+			fatAABB.pMax.y += displacement.y;
 
-		//if (grandParent != nullptr)
-		//	grandParent->fixUpwardsTree();
+		return fatAABB;
 	}
 
-	void UpdateLeaf(BoundingVolumeHierarchyNode* root)
+	int AllocateNode()
 	{
-		assert(IsLeaf());
-
-		if (this == root)
+		if (freeList == nullNode)
 		{
-			I_BOUNDING_VOLUME::Update(object);
-			return;
+			nodes.emplace_back();
+			nodes.back().height = -1;
+			nodes.back().next = nullNode;
+			freeList = int(nodes.size()) - 1;
 		}
 
-		RemoveNode();
+		int index = freeList;
+		Node& node = nodes[index];
+		freeList = node.next;
 
-		I_BOUNDING_VOLUME::Update(object);
-		
-		InsertNode(root);
+		node.parent = nullNode;
+		node.child1 = nullNode;
+		node.child2 = nullNode;
+		node.height = 0;
+		return index;
 	}
 
-	BoundingVolumeHierarchyNode* GetRoot() const
+	void FreeNode(int index)
 	{
-		BoundingVolumeHierarchyNode* root = this;
-		while (root != root->parent != nullptr)
-		{
-			root = root->parent;
-		}
-		return root;
+		Node& node = nodes[index];
+		node.polygon = nullptr;
+		node.height = -1;
+		node.next = freeList;
+		freeList = index;
 	}
 
-	void UpdateLeaf()
+	// The tight AABB of the leaf being up to date
+	bool MustReinsertLeaf(const Node& leafNode, const CPolygon& poly) const
 	{
-		UpdateLeaf(GetRoot());
+		if (!Contains(leafNode.fatAABB, leafNode.tightAABB.GetmovedAABB()))
+			return true;
+
+		AABB fatAABB = ComputeFatAABB(leafNode.tightAABB.GetmovedAABB(), poly.speed);
+		return leafNode.fatAABB.GetArea() > maxFatAreaRatio * fatAABB.GetArea();
 	}
-};
 
-class CAABBTree : public IBroadPhase
-{
-	using TNode = BoundingVolumeHierarchyNode<PolygonWithAABB>;
-	using TNodePtr = std::shared_ptr<TNode>;
-	TNode* treeRoot;
-	
-	std::unordered_map<CPolygonPtr, TNodePtr> polyToNodes;
+	void ReinsertLeaf(int leaf, const CPolygon& poly)
+	{
+		RemoveLeaf(leaf);
+		nodes[leaf].fatAABB = ComputeFatAABB(nodes[leaf].tightAABB.GetmovedAABB(), poly.speed);
+		InsertLeaf(leaf);
+	}
 
-public:
-	void AddCollidingShapes(TNode* testedLeaf, TNode* treeNode, std::vector<SPolygonPair>& pairsToCheck)
+	// Branch and bound on the surface area heuristic : the cost of a sibling is the perimeter of its new parent
+	// plus the perimeter increase of all its ancestors, so a subtree can be skipped when its lower bound is worse than the best.
+	int FindBestSibling(const AABB& leafAABB)
 	{
-		if (treeNode == nullptr || testedLeaf == treeNode)
-			return;
+		const float leafPerimeter = GetPerimeter(leafAABB);
+
+		int bestSibling = root;
+		float bestCost = GetPerimeter(nodes[root].fatAABB.Merge(leafAABB));
+
+		std::vector<InsertionCandidate>& candidates = insertionCandidates;
+		candidates.clear();
+		candidates.push_back({ root, 0.f });
 
-		if (treeNode->object.moveableAABB.GetmovedAABB().CheckCollision(testedLeaf->object.moveableAABB.GetmovedAABB()))
+		while (!candidates.empty())
 		{
-			if (treeNode->IsLeaf())
-			{
-				if (testedLeaf->object.Getpolygon() == nullptr || treeNode->object.Getpolygon() == nullptr)
-				{
-					return;
-				}
+			InsertionCandidate candidate = candidates.back();
+			candidates.pop_back();
 
-				// To not add multiple times the same element
-				if (testedLeaf->object.Getpolygon().get() < treeNode->object.Getpolygon().get())
-				{
-					pairsToCheck.push_back(SPolygonPair(testedLeaf->object.Getpolygon(), treeNode->object.Getpolygon()));
-				}
+			const Node& node = nodes[candidate.node];
+			float mergedPerimeter = GetPerimeter(node.fatAABB.Merge(leafAABB));
+			float cost = mergedPerimeter + candidate.inheritedCost;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSibling = candidate.node;
 			}
-			else
+
+			if (node.IsLeaf())
+				continue;
+
+			float childrenInheritedCost = candidate.inheritedCost + mergedPerimeter - GetPerimeter(node.fatAABB);
+			if (leafPerimeter + childrenInheritedCost < bestCost)
 			{
-				AddCollidingShapes(testedLeaf, treeNode->left, pairsToCheck);
-				AddCollidingShapes(testedLeaf, treeNode->right, pairsToCheck);
+				candidates.push_back({ node.child1, childrenInheritedCost });
+				candidates.push_back({ node.child2, childrenInheritedCost });
 			}
 		}
+
+		return bestSibling;
 	}
 
-	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
+	void InsertLeaf(int leaf)
 	{
-		if (treeRoot == nullptr)
+		if (root == nullNode)
+		{
+			root = leaf;
+			nodes[root].parent = nullNode;
 			return;
+		}
+
+		const AABB leafAABB = nodes[leaf].fatAABB;
+		int sibling = FindBestSibling(leafAABB);
 
-		for (const auto& [poly, leafNode] : polyToNodes)
+		int oldParent = nodes[sibling].parent;
+		int newParent = AllocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].fatAABB = leafAABB.Merge(nodes[sibling].fatAABB);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == nullNode)
 		{
-			AddCollidingShapes(leafNode.get(), treeRoot, pairsToCheck);
+			root = newParent;
 		}
-	}
-
-	void AddLeaf(TNode& node)
-	{
-		if (treeRoot == nullptr)
+		else if (nodes[oldParent].child1 == sibling)
 		{
-			treeRoot = &node;
-			return;
+			nodes[oldParent].child1 = newParent;
+		}
+		else
+		{
+			nodes[oldParent].child2 = newParent;
 		}
 
-		treeRoot->InsertLeaf(&node, treeRoot);
+		RefitAncestors(oldParent);
 	}
 
-	void RemoveLeaf(TNode& node)
+	void RemoveLeaf(int leaf)
 	{
-		assert(node.IsLeaf());
-
-		if (&node == treeRoot || node.parent == nullptr)
+		if (leaf == root)
 		{
-			//treeRoot = nullptr;
-			assert(node.parent == nullptr);
+			root = nullNode;
 			return;
 		}
 
-		//if (node.parent != nullptr)
-		//	return;
+		int parent = nodes[leaf].parent;
+		int grandParent = nodes[parent].parent;
+		int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
 
-		TNode* grandParent = node.parent->parent;
-		if (grandParent == nullptr)
+		if (grandParent == nullNode)
 		{
-			node.RemoveLeaf(treeRoot);
+			root = sibling;
+			nodes[sibling].parent = nullNode;
 		}
 		else
 		{
-			TNode*& refToParent = grandParent->GetDirectChildRef(node.parent);
-			node.RemoveLeaf(refToParent);
+			if (nodes[grandParent].child1 == parent)
+				nodes[grandParent].child1 = sibling;
+			else
+				nodes[grandParent].child2 = sibling;
+			nodes[sibling].parent = grandParent;
 		}
 
-		assert(node.parent == nullptr);
+		FreeNode(parent);
+		nodes[leaf].parent = nullNode;
+
+		RefitAncestors(grandParent);
 	}
 
-	virtual void OnObjectAdded(const CPolygonPtr& polygon) override
+	// Walks up from index, rotating the unbalanced nodes and fixing bounds and heights
+	void RefitAncestors(int index)
 	{
-		TNodePtr nodePtr = std::make_unique<TNode>();
-		nodePtr->object.Setpolygon(polygon);
-		//treeRoot->InsertLeaf(nodePtr.get());
-		AddLeaf(*nodePtr.get());
-		TNode* nodeRawPtr = nodePtr.get();
-		polygon->onTransformUpdatedCallback = ([this, polygon, nodeRawPtr, nodePtr](const CPolygon& poly)
+		while (index != nullNode)
 		{
-			RemoveLeaf(*nodeRawPtr);
-			UpdateAABBTransformFromPolygon(nodeRawPtr->object.moveableAABB, poly);
-			AddLeaf(*nodeRawPtr);
-		});
-		polyToNodes.insert(std::make_pair(polygon, nodePtr));
+			index = Balance(index);
+
+			Node& node = nodes[index];
+			const Node& child1 = nodes[node.child1];
+			const Node& child2 = nodes[node.child2];
+			node.height = 1 + Max(child1.height, child2.height);
+			node.fatAABB = child1.fatAABB.Merge(child2.fatAABB);
+
+			index = node.parent;
+		}
 	}
-	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
+
+	// AVL rotation : when a child of a is more than one level higher than the other one, that child (c) takes the place of a,
+	// and a takes the lowest of the children of c. Returns the index of the node now at the place of a.
+	int Balance(int a)
 	{
-		//polygon->onTransformUpdatedCallback = nullptr;
-		//auto node = polyToNodes.extract(polygon);
-		//RemoveLeaf(*node.mapped());
+		Node& nodeA = nodes[a];
+		if (nodeA.IsLeaf() || nodeA.height < 2)
+			return a;
+
+		int b = nodeA.child1;
+		int c = nodeA.child2;
+		int balance = nodes[c].height - nodes[b].height;
+
+		if (balance > 1)
+			return Rotate(a, c, b);
+		if (balance < -1)
+			return Rotate(a, b, c);
+		return a;
+	}
+
+	int Rotate(int a, int high, int low)
+	{
+		Node& nodeA = nodes[a];
+		Node& nodeHigh = nodes[high];
+		int f = nodeHigh.child1;
+		int g = nodeHigh.child2;
+
+		// high takes the place of a
+		nodeHigh.child1 = a;
+		nodeHigh.parent = nodeA.parent;
+		nodeA.parent = high;
+
+		if (nodeHigh.parent == nullNode)
+			root = high;
+		else if (nodes[nodeHigh.parent].child1 == a)
+			nodes[nodeHigh.parent].child1 = high;
+		else
+			nodes[nodeHigh.parent].child2 = high;
+
+		// the highest child of high stays, the other one goes under a in place of high
+		int kept = nodes[f].height > nodes[g].height ? f : g;
+		int moved = kept == f ? g : f;
+
+		nodeHigh.child2 = kept;
+		if (nodeA.child1 == high)
+			nodeA.child1 = moved;
+		else
+			nodeA.child2 = moved;
+		nodes[moved].parent = a;
+
+		nodeA.fatAABB = nodes[low].fatAABB.Merge(nodes[moved].fatAABB);
+		nodeA.height = 1 + Max(nodes[low].height, nodes[moved].height);
+		nodeHigh.fatAABB = nodeA.fatAABB.Merge(nodes[kept].fatAABB);
+		nodeHigh.height = 1 + Max(nodeA.height, nodes[kept].height);
+
+		return high;
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
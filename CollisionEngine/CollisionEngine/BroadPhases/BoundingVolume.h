@@ -14,7 +14,7 @@ template<class SHAPE, typename CONVERTOR>
 class CBoundingVolume : public IBroadPhase
 {
 public:
-	std::unordered_map<CPolygonPtr, SHAPE> boundingVolumes;
+	std::unordered_map<const CPolygon*, SHAPE> boundingVolumes;
 	std::vector<CPolygonPtr>& polygonsRef;
 
 	CBoundingVolume(std::vector<CPolygonPtr>& polygons) : polygonsRef(polygons)
@@ -24,18 +24,22 @@ public:
 
 	virtual void OnObjectAdded(const CPolygonPtr& polygon)
 	{
-		boundingVolumes.emplace(polygon, CONVERTOR::PolyToShape(polygon));
-
-		polygon->onTransformUpdatedCallback = ([this, polygon](const CPolygon& poly)
-		{
-			CONVERTOR::UpdateShapeFromPoly(polygon, boundingVolumes[polygon]);
-		});
+		boundingVolumes.emplace(polygon.get(), CONVERTOR::PolyToShape(polygon));
+		TrackBody(polygon, 0);
 	}
 
 	virtual void OnObjectRemoved(const CPolygonPtr& polygon)
 	{
-		boundingVolumes.erase(polygon);
-		polygon->onTransformUpdatedCallback = nullptr;
+		boundingVolumes.erase(polygon.get());
+		UntrackBody(polygon);
+	}
+
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+	{
+		for (CPolygon* polygon : polygons)
+		{
+			CONVERTOR::UpdateShapeFromPoly(*polygon, boundingVolumes[polygon]);
+		}
 	}
 
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
@@ -46,16 +50,24 @@ public:
 		pairsToCheck.reserve(polygonsRef.size() * polygonsRef.size());
 		for (size_t i = 0; i < polygonsRef.size(); ++i)
 		{
-			const SHAPE& c1 = boundingVolumes[polygonsRef[i]];
+			const SHAPE& c1 = boundingVolumes[polygonsRef[i].get()];
 			for (size_t j = i + 1; j < polygonsRef.size(); ++j)
 			{
-				const SHAPE& c2 = boundingVolumes[polygonsRef[j]];
+				const SHAPE& c2 = boundingVolumes[polygonsRef[j].get()];
 				if (CONVERTOR::AreColliding(c1, c2))
 				{
 					pairsToCheck.push_back(SPolygonPair(polygonsRef[i], polygonsRef[j]));
 				}
 			}
 		}
+
+		if (HasStaticBodies())
+		{
+			for (const CPolygonPtr& polygon : polygonsRef)
+			{
+				AddStaticCollidingPairs(polygon, CONVERTOR::ShapeToAABB(boundingVolumes[polygon.get()]), pairsToCheck);
+			}
+		}
 	}
 
 	void DisplayDebug()
@@ -78,9 +90,9 @@ public:
 		return Circle(poly->Getposition(), poly->points);
 	}
 
-	static void UpdateShapeFromPoly(const CPolygonPtr& poly, Circle& circle)
+	static void UpdateShapeFromPoly(const CPolygon& poly, Circle& circle)
 	{
-		circle.point = poly->Getposition();
+		circle.point = poly.Getposition();
 	}
 
 	static bool AreColliding(const Circle& a, const Circle& b)
@@ -88,6 +100,11 @@ public:
 		return a.IsColliding(b);
 	}
 
+	static AABB ShapeToAABB(const Circle& circle)
+	{
+		return AABB(circle.point - Vec2(circle.radius, circle.radius), circle.point + Vec2(circle.radius, circle.radius));
+	}
+
 	static void DisplayDebugShape(const Circle& circle)
 	{
 		gVars->pRenderer->DrawCircle(circle.point, circle.radius, 50, 1, 0, 0);
@@ -109,9 +126,9 @@ public:
 		return PolyToMoveableAABB(poly);
 	}
 
-	static void UpdateShapeFromPoly(const CPolygonPtr& poly, MoveableAABB& aabb)
+	static void UpdateShapeFromPoly(const CPolygon& poly, MoveableAABB& aabb)
 	{
-		UpdateAABBTransformFromPolygon(aabb, *poly);
+		UpdateAABBTransformFromPolygon(aabb, poly);
 	}
 
 	static bool AreColliding(const MoveableAABB& a, const MoveableAABB& b)
@@ -119,6 +136,11 @@ public:
 		return a.GetmovedAABB().CheckCollision(b.GetmovedAABB());
 	}
 
+	static AABB ShapeToAABB(const MoveableAABB& aabb)
+	{
+		return aabb.GetmovedAABB();
+	}
+
 	static void DisplayDebugShape(const MoveableAABB& aabb)
 	{
 		gVars->pRenderer->DrawAABB(aabb.GetmovedAABB(), 1, 0, 0);
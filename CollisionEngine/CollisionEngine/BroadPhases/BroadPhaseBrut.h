@@ -11,7 +11,6 @@
 class CBroadPhaseBrut : public IBroadPhase
 {
 	std::vector<CPolygonPtr>& registeredPolygons;
-	std::vector<SPolygonPair> pairsToCheck;
 
 public:
 	CBroadPhaseBrut(std::vector<CPolygonPtr>& polygons) : registeredPolygons(polygons)
@@ -19,28 +18,22 @@ public:
 
 	}
 
-	virtual void OnObjectAdded(const CPolygonPtr& newPolygon) override
+	// All the pairs are made when queried, the indices of the polygons changing when one is removed from the world
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
 	{
+		gVars->pRenderer->DisplayText("Brut");
+		AddCollidingPairsToCheck(registeredPolygons, pairsToCheck);
+
+		if (staticBodies == nullptr)
+			return;
+
 		for (const CPolygonPtr& registeredPoly : registeredPolygons)
 		{
-			pairsToCheck.push_back(SPolygonPair(registeredPoly, newPolygon));
-		}
-	}
-
-	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
-	{
-		pairsToCheck.erase(std::remove_if(pairsToCheck.begin(), pairsToCheck.end(), [polygon](const SPolygonPair& pair)
+			for (const CPolygonPtr& staticPoly : staticBodies->GetPolygons())
 			{
-				return pair.GetpolyA() == polygon || pair.GetpolyB() == polygon;
-			}),
-			pairsToCheck.end()
-		);
-	}
-
-	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
-	{
-		gVars->pRenderer->DisplayText("Brut");
-		pairsToCheck = this->pairsToCheck;
+				pairsToCheck.push_back(SPolygonPair(registeredPoly, staticPoly));
+			}
+		}
 	}
 
 	static void AddCollidingPairsToCheck(const std::vector<CPolygonPtr>& polygonsToCheck, std::vector<SPolygonPair>& pairsToCheck)
@@ -0,0 +1,217 @@
+#ifndef _CELLS_HASH_TABLE_H_
+#define _CELLS_HASH_TABLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+struct SCellKey
+{
+	int x;
+	int y;
+	int level;
+
+	bool operator==(const SCellKey& rhs) const
+	{
+		return x == rhs.x && y == rhs.y && level == rhs.level;
+	}
+};
+
+// Cells of body indices on flat arrays, for the grid broadphases : the cells are found with an open addressing hash table
+// (linear probing) on their key, and keep their first bodies in an inline buffer, the others going in recycled overflow vectors.
+// Emptied cells stay in the table until they are too many, then are removed all at once.
+class CCellsHashTable
+{
+public:
+	static constexpr int inlineCapacity = 6;
+	static constexpr int none = -1;
+
+	struct Cell
+	{
+		SCellKey key;
+		uint32_t count = 0;
+		uint32_t bodies[inlineCapacity];
+		uint32_t overflow = UINT32_MAX; // index in overflows, bodies after the inline ones
+	};
+
+	const std::vector<Cell>& GetCells() const
+	{
+		return cells;
+	}
+
+	size_t GetOccupiedCellsCount() const
+	{
+		return cells.size() - emptyCellsCount;
+	}
+
+	uint32_t GetCellBody(const Cell& cell, uint32_t index) const
+	{
+		return index < inlineCapacity ? cell.bodies[index] : overflows[cell.overflow][index - inlineCapacity];
+	}
+
+	int FindCell(const SCellKey& key) const
+	{
+		if (slots.empty())
+			return none;
+
+		size_t mask = slots.size() - 1;
+		for (size_t slot = HashKey(key) & mask; ; slot = (slot + 1) & mask)
+		{
+			int cellIndex = slots[slot];
+			if (cellIndex == none || cells[cellIndex].key == key)
+				return cellIndex;
+		}
+	}
+
+	void AddBody(const SCellKey& key, uint32_t body)
+	{
+		Cell& cell = cells[FindOrAddCell(key)];
+		if (cell.count < inlineCapacity)
+		{
+			cell.bodies[cell.count++] = body;
+			return;
+		}
+
+		if (cell.overflow == UINT32_MAX)
+		{
+			if (freeOverflows.empty())
+			{
+				cell.overflow = uint32_t(overflows.size());
+				overflows.emplace_back();
+			}
+			else
+			{
+				cell.overflow = freeOverflows.back();
+				freeOverflows.pop_back();
+			}
+		}
+
+		overflows[cell.overflow].push_back(body);
+		cell.count++;
+	}
+
+	void RemoveBody(const SCellKey& key, uint32_t body)
+	{
+		int cellIndex = FindCell(key);
+		if (cellIndex == none)
+			return;
+
+		Cell& cell = cells[cellIndex];
+		for (uint32_t i = 0; i < cell.count; i++)
+		{
+			uint32_t& cellBody = GetCellBody(cell, i);
+			if (cellBody != body)
+				continue;
+
+			// the last body takes its place
+			cellBody = GetCellBody(cell, cell.count - 1);
+			cell.count--;
+			if (cell.count >= inlineCapacity)
+			{
+				overflows[cell.overflow].pop_back();
+			}
+			else if (cell.overflow != UINT32_MAX)
+			{
+				// capacity is kept for the next overflowing cell
+				freeOverflows.push_back(cell.overflow);
+				cell.overflow = UINT32_MAX;
+			}
+
+			if (cell.count == 0)
+				emptyCellsCount++;
+			return;
+		}
+	}
+
+	// Rebuilding the table is simpler than deleting with linear probing
+	void RemoveEmptyCells()
+	{
+		if (emptyCellsCount < 1024 || 2 * emptyCellsCount < cells.size())
+			return;
+
+		cells.erase(std::remove_if(cells.begin(), cells.end(), [](const Cell& cell)
+		{
+			return cell.count == 0;
+		}), cells.end());
+		emptyCellsCount = 0;
+
+		RebuildTable();
+	}
+
+private:
+	std::vector<Cell> cells;
+	size_t emptyCellsCount = 0;
+	std::vector<int> slots; // cell index or none, size is a power of two
+
+	std::vector<std::vector<uint32_t>> overflows;
+	std::vector<uint32_t> freeOverflows;
+
+	static uint32_t HashKey(const SCellKey& key)
+	{
+		// splitmix64 finalizer on the packed coordinates
+		uint64_t hash = (uint64_t(uint32_t(key.x)) << 32) | uint64_t(uint32_t(key.y));
+		hash ^= uint64_t(key.level) * 0x9e3779b97f4a7c15ull;
+		hash ^= hash >> 30;
+		hash *= 0xbf58476d1ce4e5b9ull;
+		hash ^= hash >> 27;
+		hash *= 0x94d049bb133111ebull;
+		hash ^= hash >> 31;
+		return uint32_t(hash);
+	}
+
+	uint32_t& GetCellBody(Cell& cell, uint32_t index)
+	{
+		return index < inlineCapacity ? cell.bodies[index] : overflows[cell.overflow][index - inlineCapacity];
+	}
+
+	void InsertInTable(int cellIndex)
+	{
+		size_t mask = slots.size() - 1;
+		size_t slot = HashKey(cells[cellIndex].key) & mask;
+		while (slots[slot] != none)
+		{
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = cellIndex;
+	}
+
+	// Table at most half full
+	void RebuildTable()
+	{
+		size_t size = 64;
+		while (size < 2 * cells.size())
+		{
+			size *= 2;
+		}
+
+		slots.assign(size, none);
+		for (size_t cellIndex = 0; cellIndex < cells.size(); cellIndex++)
+		{
+			InsertInTable(int(cellIndex));
+		}
+	}
+
+	int FindOrAddCell(const SCellKey& key)
+	{
+		int cellIndex = FindCell(key);
+		if (cellIndex != none)
+		{
+			if (cells[cellIndex].count == 0)
+				emptyCellsCount--;
+			return cellIndex;
+		}
+
+		cellIndex = int(cells.size());
+		cells.emplace_back();
+		cells.back().key = key;
+
+		if (2 * cells.size() > slots.size())
+			RebuildTable();
+		else
+			InsertInTable(cellIndex);
+
+		return cellIndex;
+	}
+};
+
+#endif
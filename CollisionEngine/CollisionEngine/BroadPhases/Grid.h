@@ -74,6 +74,9 @@ public:
     };
     std::unordered_map<CPolygonPtr, PolygonAdditionalGeometryData> polygonsAdditionalGeometryData;
 
+    std::vector<CPolygonPtr> bodies; // nullptr when free, see UpdateBodies
+    std::vector<uint32_t> freeBodies;
+
     CGrid(float gridCellSize) : gridCellSize(gridCellSize)
     {
 
@@ -89,6 +92,14 @@ public:
         {
             pairsToCheck.emplace_back(it.first);
         }
+
+        if (HasStaticBodies())
+        {
+            for (const auto& it : polygonsAdditionalGeometryData)
+            {
+                AddStaticCollidingPairs(it.first, PolyToTransformedAABB(it.first, it.second.baseAABB), pairsToCheck);
+            }
+        }
     }
 
     void clear()
@@ -114,15 +125,27 @@ public:
 
         polygonsAdditionalGeometryData.emplace(newPolygon, geometryData);
 
-        newPolygon->onTransformUpdatedCallback = ([this, newPolygon](const CPolygon& poly)
+        uint32_t body;
+        if (freeBodies.empty())
+        {
+            body = uint32_t(bodies.size());
+            bodies.emplace_back();
+        }
+        else
         {
-	        OnObjectUpdated(newPolygon);
-        });
+            body = freeBodies.back();
+            freeBodies.pop_back();
+        }
+        bodies[body] = newPolygon;
+        TrackBody(newPolygon, body);
     }
 
     virtual void OnObjectRemoved(const CPolygonPtr& removedPolygon) override
     {
-        removedPolygon->onTransformUpdatedCallback = nullptr;
+        bodies[GetBody(*removedPolygon)] = nullptr;
+        freeBodies.push_back(GetBody(*removedPolygon));
+        UntrackBody(removedPolygon);
+
         auto geometryDataIt = polygonsAdditionalGeometryData.find(removedPolygon);
         const AABBInt& aabbInt = geometryDataIt->second.lastAABBInt;
         for (int gridX = aabbInt.pMin.x; gridX <= aabbInt.pMax.x; gridX++)
@@ -136,6 +159,14 @@ public:
         polygonsAdditionalGeometryData.erase(geometryDataIt);
     }
 
+    virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+    {
+        for (CPolygon* polygon : polygons)
+        {
+            OnObjectUpdated(bodies[GetBody(*polygon)]);
+        }
+    }
+
     std::pair<TCell, bool> GetOrInsertCell(const Vec2Int& gridLocation)
     {
         return grid.emplace(gridLocation, std::vector<CPolygonPtr>());;
@@ -286,7 +317,7 @@ public:
         // check for same poly
         for (const std::pair<SPolygonPair, int>& it : pairsToCheck)
         {
-            assert(it.first.GetpolyA() != it.first.GetpolyB());
+            assert(it.first.GetbodyA() != it.first.GetbodyB());
         }
 
         while (FixDuplicates());
@@ -0,0 +1,336 @@
+#ifndef _HIERARCHICAL_GRID_H_
+#define _HIERARCHICAL_GRID_H_
+
+#include "BroadPhase.h"
+#include "CellsHashTable.h"
+
+#include "Conversion.h"
+#include "Polygon.h"
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Renderer.h"
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Hierarchical hash grid : cell sizes are baseCellSize * 2^level, and each body is in the cells of the first level
+// whose cells are as large as its AABB, so in 4 cells at most whatever its size (see CCellsHashTable, the levels sharing one table).
+// The pairs of a level are found in its cells, and each body looks for the pairs with coarser bodies in the cells of the occupied coarser levels
+// that its AABB overlaps. As in CSpatialHash, a pair is only reported by the cell holding the min corner of the intersection of the two AABBs.
+class CHierarchicalGrid : public IBroadPhase
+{
+	static constexpr int maxLevelsCount = 32;
+
+	struct CellsBounds
+	{
+		Vec2Int min;
+		Vec2Int max;
+
+		bool operator==(const CellsBounds& rhs) const
+		{
+			return min == rhs.min && max == rhs.max;
+		}
+	};
+
+	struct Body
+	{
+		CPolygonPtr polygon; // nullptr when free
+		AABB baseAABB; // in the space of the polygon
+		AABB aabb;
+		int level = 0;
+		CellsBounds cells; // at its level
+		uint32_t indexInLevel = 0;
+	};
+
+	std::vector<Body> bodies;
+	std::vector<uint32_t> freeBodies;
+	std::unordered_map<const CPolygon*, uint32_t> polygonsBodies;
+
+	CCellsHashTable cellsTable;
+
+	float cellsSizes[maxLevelsCount];
+	float inverseCellsSizes[maxLevelsCount];
+
+	std::vector<uint32_t> levelsBodies[maxLevelsCount];
+	uint32_t occupiedLevels = 0; // bit per level
+
+	struct Placement
+	{
+		int level;
+		CellsBounds cells;
+	};
+	std::vector<Placement> movedBodiesPlacements; // of the polygons given to UpdateBodies
+
+	// under this count, the bodies of a coarser level are tested directly rather than through its cells, as with the borders of the scenes
+	static constexpr size_t sparseLevelBodiesCount = 8;
+
+	int GetLevel(const AABB& aabb) const
+	{
+		float size = Max(aabb.pMax.x - aabb.pMin.x, aabb.pMax.y - aabb.pMin.y);
+		int level = 0;
+		while (level < maxLevelsCount - 1 && cellsSizes[level] < size)
+		{
+			level++;
+		}
+		return level;
+	}
+
+	// floorf is a call without SSE4.1, and this runs for every coarser level of every body
+	static int FloorToInt(float value)
+	{
+		int truncated = int(value);
+		return truncated - (value < float(truncated) ? 1 : 0);
+	}
+
+	CellsBounds GetCellsBounds(const AABB& aabb, int level) const
+	{
+		float inverseCellSize = inverseCellsSizes[level];
+		return { Vec2Int{ FloorToInt(aabb.pMin.x * inverseCellSize), FloorToInt(aabb.pMin.y * inverseCellSize) },
+			Vec2Int{ FloorToInt(aabb.pMax.x * inverseCellSize), FloorToInt(aabb.pMax.y * inverseCellSize) } };
+	}
+
+	void AddToLevel(uint32_t bodyIndex, int level)
+	{
+		std::vector<uint32_t>& levelBodies = levelsBodies[level];
+		bodies[bodyIndex].indexInLevel = uint32_t(levelBodies.size());
+		levelBodies.push_back(bodyIndex);
+		occupiedLevels |= 1u << level;
+	}
+
+	void RemoveFromLevel(uint32_t bodyIndex, int level)
+	{
+		std::vector<uint32_t>& levelBodies = levelsBodies[level];
+		uint32_t indexInLevel = bodies[bodyIndex].indexInLevel;
+		levelBodies[indexInLevel] = levelBodies.back();
+		bodies[levelBodies[indexInLevel]].indexInLevel = indexInLevel;
+		levelBodies.pop_back();
+
+		if (levelBodies.empty())
+			occupiedLevels &= ~(1u << level);
+	}
+
+	void AddBodyToCells(uint32_t bodyIndex, const Body& body)
+	{
+		for (int y = body.cells.min.y; y <= body.cells.max.y; y++)
+		{
+			for (int x = body.cells.min.x; x <= body.cells.max.x; x++)
+			{
+				cellsTable.AddBody(SCellKey{ x, y, body.level }, bodyIndex);
+			}
+		}
+	}
+
+	void RemoveBodyFromCells(uint32_t bodyIndex, const Body& body)
+	{
+		for (int y = body.cells.min.y; y <= body.cells.max.y; y++)
+		{
+			for (int x = body.cells.min.x; x <= body.cells.max.x; x++)
+			{
+				cellsTable.RemoveBody(SCellKey{ x, y, body.level }, bodyIndex);
+			}
+		}
+	}
+
+	void MoveBody(uint32_t bodyIndex, const Placement& placement)
+	{
+		Body& body = bodies[bodyIndex];
+
+		// at most 4 cells each
+		RemoveBodyFromCells(bodyIndex, body);
+		if (placement.level != body.level)
+		{
+			RemoveFromLevel(bodyIndex, body.level);
+			AddToLevel(bodyIndex, placement.level);
+		}
+
+		body.level = placement.level;
+		body.cells = placement.cells;
+		AddBodyToCells(bodyIndex, body);
+	}
+
+	void AddCoarserCollidingPairs(const Body& body, std::vector<SPolygonPair>& pairsToCheck) const
+	{
+		for (int level = body.level + 1; level < maxLevelsCount && (occupiedLevels >> level) != 0; level++)
+		{
+			if ((occupiedLevels & (1u << level)) == 0)
+				continue;
+
+			if (levelsBodies[level].size() <= sparseLevelBodiesCount)
+			{
+				for (uint32_t coarserBodyIndex : levelsBodies[level])
+				{
+					const Body& coarserBody = bodies[coarserBodyIndex];
+					if (body.aabb.CheckCollision(coarserBody.aabb))
+						pairsToCheck.push_back(SPolygonPair(body.polygon, coarserBody.polygon));
+				}
+				continue;
+			}
+
+			CellsBounds cells = GetCellsBounds(body.aabb, level);
+			for (int y = cells.min.y; y <= cells.max.y; y++)
+			{
+				for (int x = cells.min.x; x <= cells.max.x; x++)
+				{
+					int cellIndex = cellsTable.FindCell(SCellKey{ x, y, level });
+					if (cellIndex == CCellsHashTable::none)
+						continue;
+
+					const CCellsHashTable::Cell& cell = cellsTable.GetCells()[cellIndex];
+					for (uint32_t i = 0; i < cell.count; i++)
+					{
+						const Body& coarserBody = bodies[cellsTable.GetCellBody(cell, i)];
+						if (x != Max(cells.min.x, coarserBody.cells.min.x) || y != Max(cells.min.y, coarserBody.cells.min.y))
+							continue;
+
+						if (body.aabb.CheckCollision(coarserBody.aabb))
+							pairsToCheck.push_back(SPolygonPair(body.polygon, coarserBody.polygon));
+					}
+				}
+			}
+		}
+	}
+
+	void AddCellCollidingPairs(const CCellsHashTable::Cell& cell, std::vector<SPolygonPair>& pairsToCheck) const
+	{
+		for (uint32_t i = 0; i < cell.count; i++)
+		{
+			const Body& bodyA = bodies[cellsTable.GetCellBody(cell, i)];
+			for (uint32_t j = i + 1; j < cell.count; j++)
+			{
+				const Body& bodyB = bodies[cellsTable.GetCellBody(cell, j)];
+				if (cell.key.x != Max(bodyA.cells.min.x, bodyB.cells.min.x) || cell.key.y != Max(bodyA.cells.min.y, bodyB.cells.min.y))
+					continue;
+
+				if (bodyA.aabb.CheckCollision(bodyB.aabb))
+					pairsToCheck.push_back(SPolygonPair(bodyA.polygon, bodyB.polygon));
+			}
+
+			// once per body, from its min cell
+			if (cell.key.x == bodyA.cells.min.x && cell.key.y == bodyA.cells.min.y)
+			{
+				AddCoarserCollidingPairs(bodyA, pairsToCheck);
+				AddStaticCollidingPairs(bodyA.polygon, bodyA.aabb, pairsToCheck);
+			}
+		}
+	}
+
+public:
+	CHierarchicalGrid(float baseCellSize = 0.5f)
+	{
+		for (int level = 0; level < maxLevelsCount; level++)
+		{
+			cellsSizes[level] = ldexpf(baseCellSize, level);
+			inverseCellsSizes[level] = 1.f / cellsSizes[level];
+		}
+	}
+
+	virtual void OnObjectAdded(const CPolygonPtr& polygon) override
+	{
+		uint32_t bodyIndex;
+		if (freeBodies.empty())
+		{
+			bodyIndex = uint32_t(bodies.size());
+			bodies.emplace_back();
+		}
+		else
+		{
+			bodyIndex = freeBodies.back();
+			freeBodies.pop_back();
+		}
+
+		Body& body = bodies[bodyIndex];
+		body.polygon = polygon;
+		body.baseAABB = PolyToBaseAABB(polygon);
+		body.aabb = PolyToMovedAABB(body.baseAABB, *polygon);
+		body.level = GetLevel(body.aabb);
+		body.cells = GetCellsBounds(body.aabb, body.level);
+		AddBodyToCells(bodyIndex, body);
+		AddToLevel(bodyIndex, body.level);
+
+		polygonsBodies[polygon.get()] = bodyIndex;
+		TrackBody(polygon, bodyIndex);
+	}
+
+	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
+	{
+		auto it = polygonsBodies.find(polygon.get());
+		if (it == polygonsBodies.end())
+			return;
+
+		uint32_t bodyIndex = it->second;
+		Body& body = bodies[bodyIndex];
+		RemoveBodyFromCells(bodyIndex, body);
+		RemoveFromLevel(bodyIndex, body.level);
+		body.polygon = nullptr;
+		freeBodies.push_back(bodyIndex);
+		polygonsBodies.erase(it);
+		UntrackBody(polygon);
+	}
+
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+	{
+		// the AABBs and their cells are independent, the table and the levels are then changed one body at a time
+		movedBodiesPlacements.resize(polygons.size());
+		ForEachRange(polygons.size(), [this, &polygons](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Body& body = bodies[GetBody(*polygons[i])];
+				body.aabb = PolyToMovedAABB(body.baseAABB, *polygons[i]);
+
+				Placement& placement = movedBodiesPlacements[i];
+				placement.level = GetLevel(body.aabb);
+				placement.cells = GetCellsBounds(body.aabb, placement.level);
+			}
+		});
+
+		for (size_t i = 0; i < polygons.size(); i++)
+		{
+			uint32_t bodyIndex = GetBody(*polygons[i]);
+			const Placement& placement = movedBodiesPlacements[i];
+			const Body& body = bodies[bodyIndex];
+			if (placement.level != body.level || !(placement.cells == body.cells))
+				MoveBody(bodyIndex, placement);
+		}
+	}
+
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
+	{
+		if (gVars->bDebug)
+			DisplayDebug();
+
+		cellsTable.RemoveEmptyCells();
+
+		// the cells are independent, split in ranges when parallel
+		const std::vector<CCellsHashTable::Cell>& cells = cellsTable.GetCells();
+		AddPairs(cells.size(), pairsToCheck, [this, &cells](size_t firstCell, size_t lastCell, std::vector<SPolygonPair>& chunkPairs)
+		{
+			for (size_t cellIndex = firstCell; cellIndex < lastCell; cellIndex++)
+			{
+				AddCellCollidingPairs(cells[cellIndex], chunkPairs);
+			}
+		});
+	}
+
+	void DisplayDebug()
+	{
+		for (int level = 0; level < maxLevelsCount; level++)
+		{
+			if (!levelsBodies[level].empty())
+				gVars->pRenderer->DisplayText("Level " + std::to_string(level) + ", cell size " + std::to_string(cellsSizes[level]) + " : " + std::to_string(levelsBodies[level].size()) + " bodies");
+		}
+
+		for (const CCellsHashTable::Cell& cell : cellsTable.GetCells())
+		{
+			if (cell.count == 0)
+				continue;
+
+			float cellSize = cellsSizes[cell.key.level];
+			Vec2 cellMin = Vec2(cell.key.x * cellSize, cell.key.y * cellSize);
+			gVars->pRenderer->DrawAABB(AABB(cellMin, cellMin + Vec2(cellSize, cellSize)), 1, 0, 0);
+		}
+	}
+};
+
+#endif
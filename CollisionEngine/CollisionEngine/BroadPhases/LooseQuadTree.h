@@ -0,0 +1,491 @@
+#ifndef _LOOSE_QUAD_TREE_H_
+#define _LOOSE_QUAD_TREE_H_
+
+#include "BroadPhase.h"
+
+#include "Conversion.h"
+#include "Polygon.h"
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Renderer.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Loose quad tree : the bounds of a node are its cell enlarged by half a cell on each side,
+// so a body fits in the node of the cell holding its center, at the deepest depth whose cells are as large as its AABB.
+// Its node is found in O(depth) from integer cell coordinates, without testing any bounds, and bodies never get stuck above a split.
+// The root is fitted around the bodies, and maxDepth stops at the cell size of the smallest body ; both are computed again
+// when a body leaves the root, such a body being kept in the root meanwhile.
+// Nodes are in a pool, they only exist while their subtree holds bodies, and keep their bodies in an intrusive list.
+class CLooseQuadTree : public IBroadPhase
+{
+	static constexpr int none = -1;
+	static constexpr int maxDepthLimit = 16;
+	static constexpr float looseMargin = 0.501f; // in cells, a bit more than half for the rounding errors
+
+	struct Node
+	{
+		int depth = 0;
+		Vec2Int cell; // at its depth, the loose bounds being this cell enlarged by looseMargin cells
+		int parent = none; // or next free node
+		int children[4] = { none, none, none, none };
+		int childrenCount = 0;
+		int firstBody = none;
+	};
+
+	struct Body
+	{
+		CPolygonPtr polygon; // nullptr when free
+		AABB baseAABB; // in the space of the polygon
+		AABB aabb;
+		int node = none;
+		int previous = none; // in the node
+		int next = none;
+	};
+
+	std::vector<Node> nodes;
+	int firstFreeNode = none;
+	int root = none;
+
+	std::vector<Body> bodies;
+	std::vector<int> freeBodies;
+	std::unordered_map<const CPolygon*, int> polygonsBodies;
+
+	Vec2 rootMin;
+	float rootSize = 0.f;
+	int maxDepth = 0;
+	float cellsSizes[maxDepthLimit + 1];
+	float inverseCellsSizes[maxDepthLimit + 1];
+	size_t outsideBodiesCount = 0; // centers out of the root
+
+	std::vector<int> nodesToVisit;
+	std::vector<int> bodiesInTreeOrder;
+	std::vector<int> chunksStacks[CParallelPairs::chunksCount]; // traversal scratch of each chunk, kept for the next queries
+
+	struct MovedBody
+	{
+		AABB aabb;
+		bool changesNode;
+	};
+	std::vector<MovedBody> movedBodies; // of the polygons given to UpdateBodies
+
+	int AllocateNode(int parent, int depth, const Vec2Int& cell)
+	{
+		int nodeIndex;
+		if (firstFreeNode != none)
+		{
+			nodeIndex = firstFreeNode;
+			firstFreeNode = nodes[nodeIndex].parent;
+		}
+		else
+		{
+			nodeIndex = int(nodes.size());
+			nodes.emplace_back();
+		}
+
+		Node& node = nodes[nodeIndex];
+		node = Node();
+		node.parent = parent;
+		node.depth = depth;
+		node.cell = cell;
+		return nodeIndex;
+	}
+
+	void FreeNode(int nodeIndex)
+	{
+		nodes[nodeIndex].parent = firstFreeNode;
+		nodes[nodeIndex].depth = none;
+		firstFreeNode = nodeIndex;
+	}
+
+	bool IsInRoot(const Vec2& point) const
+	{
+		return point.x >= rootMin.x && point.y >= rootMin.y && point.x < rootMin.x + rootSize && point.y < rootMin.y + rootSize;
+	}
+
+	// deepest depth whose cells hold the AABB, and the cell of its center
+	void GetTargetCell(const AABB& aabb, int& depth, Vec2Int& cell) const
+	{
+		Vec2 center = (aabb.pMin + aabb.pMax) * 0.5f;
+		if (!IsInRoot(center))
+		{
+			depth = 0;
+			cell = Vec2Int{ 0, 0 };
+			return;
+		}
+
+		float size = Max(aabb.pMax.x - aabb.pMin.x, aabb.pMax.y - aabb.pMin.y);
+		depth = 0;
+		while (depth < maxDepth && cellsSizes[depth + 1] >= size)
+		{
+			depth++;
+		}
+
+		float cellSize = cellsSizes[depth];
+		int cellsCount = 1 << depth;
+		cell.x = Min(int((center.x - rootMin.x) / cellSize), cellsCount - 1);
+		cell.y = Min(int((center.y - rootMin.y) / cellSize), cellsCount - 1);
+	}
+
+	int FindOrAddNode(int depth, const Vec2Int& cell)
+	{
+		int nodeIndex = root;
+		for (int childDepth = 1; childDepth <= depth; childDepth++)
+		{
+			int shift = depth - childDepth;
+			Vec2Int childCell = { cell.x >> shift, cell.y >> shift };
+			int quadrant = (childCell.x & 1) | ((childCell.y & 1) << 1);
+
+			int childIndex = nodes[nodeIndex].children[quadrant];
+			if (childIndex == none)
+			{
+				childIndex = AllocateNode(nodeIndex, childDepth, childCell);
+				nodes[nodeIndex].children[quadrant] = childIndex;
+				nodes[nodeIndex].childrenCount++;
+			}
+			nodeIndex = childIndex;
+		}
+		return nodeIndex;
+	}
+
+	void LinkBody(int bodyIndex, int nodeIndex)
+	{
+		Body& body = bodies[bodyIndex];
+		Node& node = nodes[nodeIndex];
+		body.node = nodeIndex;
+		body.previous = none;
+		body.next = node.firstBody;
+		if (body.next != none)
+			bodies[body.next].previous = bodyIndex;
+		node.firstBody = bodyIndex;
+	}
+
+	void UnlinkBody(int bodyIndex)
+	{
+		Body& body = bodies[bodyIndex];
+		if (body.previous != none)
+			bodies[body.previous].next = body.next;
+		else
+			nodes[body.node].firstBody = body.next;
+
+		if (body.next != none)
+			bodies[body.next].previous = body.previous;
+
+		// empty nodes are freed up to the root
+		int nodeIndex = body.node;
+		while (nodeIndex != root && nodes[nodeIndex].firstBody == none && nodes[nodeIndex].childrenCount == 0)
+		{
+			Node& parent = nodes[nodes[nodeIndex].parent];
+			for (int& child : parent.children)
+			{
+				if (child == nodeIndex)
+					child = none;
+			}
+			parent.childrenCount--;
+
+			int parentIndex = nodes[nodeIndex].parent;
+			FreeNode(nodeIndex);
+			nodeIndex = parentIndex;
+		}
+
+		body.node = none;
+	}
+
+	void InsertBody(int bodyIndex)
+	{
+		int depth;
+		Vec2Int cell;
+		GetTargetCell(bodies[bodyIndex].aabb, depth, cell);
+		LinkBody(bodyIndex, FindOrAddNode(depth, cell));
+
+		if (!IsInRoot((bodies[bodyIndex].aabb.pMin + bodies[bodyIndex].aabb.pMax) * 0.5f))
+			outsideBodiesCount++;
+	}
+
+	void RemoveBody(int bodyIndex)
+	{
+		if (!IsInRoot((bodies[bodyIndex].aabb.pMin + bodies[bodyIndex].aabb.pMax) * 0.5f))
+			outsideBodiesCount--;
+
+		UnlinkBody(bodyIndex);
+	}
+
+	// Whether the body has to change of node, its AABB being the one of its node
+	bool MustMoveBody(const Body& body, const AABB& newAABB) const
+	{
+		int depth;
+		Vec2Int cell;
+		GetTargetCell(newAABB, depth, cell);
+		const Node& node = nodes[body.node];
+		bool wasInRoot = IsInRoot((body.aabb.pMin + body.aabb.pMax) * 0.5f);
+		bool isInRoot = IsInRoot((newAABB.pMin + newAABB.pMax) * 0.5f);
+		return node.depth != depth || !(node.cell == cell) || wasInRoot != isInRoot;
+	}
+
+	// The root is a square around the bodies with a margin, the deepest cells are as large as the smallest body
+	void Rebuild()
+	{
+		AABB bounds;
+		float minSize = FLT_MAX;
+		bool isEmpty = true;
+		for (const Body& body : bodies)
+		{
+			if (!body.polygon)
+				continue;
+
+			bounds = isEmpty ? body.aabb : bounds.Merge(body.aabb);
+			minSize = Min(minSize, Max(body.aabb.pMax.x - body.aabb.pMin.x, body.aabb.pMax.y - body.aabb.pMin.y));
+			isEmpty = false;
+		}
+
+		if (isEmpty)
+		{
+			bounds = AABB(Vec2(-1.f, -1.f), Vec2(1.f, 1.f));
+			minSize = 1.f;
+		}
+
+		Vec2 center = (bounds.pMin + bounds.pMax) * 0.5f;
+		rootSize = Max(Max(bounds.pMax.x - bounds.pMin.x, bounds.pMax.y - bounds.pMin.y) * 2.f, 1.f);
+		rootMin = center - Vec2(rootSize, rootSize) * 0.5f;
+
+		for (int depth = 0; depth <= maxDepthLimit; depth++)
+		{
+			cellsSizes[depth] = rootSize / float(1 << depth);
+			inverseCellsSizes[depth] = 1.f / cellsSizes[depth];
+		}
+
+		maxDepth = 0;
+		while (maxDepth < maxDepthLimit && cellsSizes[maxDepth + 1] >= minSize)
+		{
+			maxDepth++;
+		}
+
+		nodes.clear();
+		firstFreeNode = none;
+		root = AllocateNode(none, 0, Vec2Int{ 0, 0 });
+
+		outsideBodiesCount = 0;
+		for (int bodyIndex = 0; bodyIndex < int(bodies.size()); bodyIndex++)
+		{
+			if (bodies[bodyIndex].polygon)
+				InsertBody(bodyIndex);
+		}
+	}
+
+	// stack : traversal scratch, one per chunk
+	void AddCollidingPairs(int bodyIndexA, std::vector<int>& stack, std::vector<SPolygonPair>& pairsToCheck) const
+	{
+		const Body& bodyA = bodies[bodyIndexA];
+		const Node& nodeA = nodes[bodyA.node];
+		int depthA = nodeA.depth;
+
+		// Each pair is reported by the body of the shallower node, or by the first body at the same depth.
+		// The bodies as deep as this one that it can overlap are under the 3x3 cells around its own at its depth,
+		// so the traversal starts from the first ancestor holding these cells.
+		int cellsCount = 1 << depthA;
+		Vec2Int neighboursMin = { Max(nodeA.cell.x - 1, 0), Max(nodeA.cell.y - 1, 0) };
+		Vec2Int neighboursMax = { Min(nodeA.cell.x + 1, cellsCount - 1), Min(nodeA.cell.y + 1, cellsCount - 1) };
+		int start = bodyA.node;
+		while (start != root)
+		{
+			int shift = depthA - nodes[start].depth;
+			if ((neighboursMin.x >> shift) == (neighboursMax.x >> shift) && (neighboursMin.y >> shift) == (neighboursMax.y >> shift))
+				break;
+			start = nodes[start].parent;
+		}
+
+		stack.clear();
+		stack.push_back(start);
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			if (node.depth >= depthA)
+			{
+				for (int bodyIndexB = node.firstBody; bodyIndexB != none; bodyIndexB = bodies[bodyIndexB].next)
+				{
+					if (node.depth == depthA && bodyIndexB <= bodyIndexA)
+						continue;
+
+					const Body& bodyB = bodies[bodyIndexB];
+					if (bodyA.aabb.CheckCollision(bodyB.aabb))
+						pairsToCheck.push_back(SPolygonPair(bodyA.polygon, bodyB.polygon));
+				}
+			}
+
+			if (node.childrenCount == 0)
+				continue;
+
+			// the children are culled in cell units without loading them : above its depth, by the ancestors of the cells around bodyA,
+			// and from its depth, by their loose bounds
+			int childDepth = node.depth + 1;
+			int shift = Max(depthA - childDepth, 0);
+			Vec2Int ancestorsMin = { neighboursMin.x >> shift, neighboursMin.y >> shift };
+			Vec2Int ancestorsMax = { neighboursMax.x >> shift, neighboursMax.y >> shift };
+
+			float inverseCellSize = inverseCellsSizes[childDepth];
+			float minX = (bodyA.aabb.pMin.x - rootMin.x) * inverseCellSize - looseMargin;
+			float minY = (bodyA.aabb.pMin.y - rootMin.y) * inverseCellSize - looseMargin;
+			float maxX = (bodyA.aabb.pMax.x - rootMin.x) * inverseCellSize + looseMargin;
+			float maxY = (bodyA.aabb.pMax.y - rootMin.y) * inverseCellSize + looseMargin;
+
+			for (int quadrant = 0; quadrant < 4; quadrant++)
+			{
+				int child = node.children[quadrant];
+				if (child == none)
+					continue;
+
+				Vec2Int childCell = { node.cell.x * 2 + (quadrant & 1), node.cell.y * 2 + (quadrant >> 1) };
+				if (childDepth <= depthA && (childCell.x < ancestorsMin.x || childCell.x > ancestorsMax.x || childCell.y < ancestorsMin.y || childCell.y > ancestorsMax.y))
+					continue;
+
+				if (childDepth >= depthA && (maxX <= childCell.x || minX >= childCell.x + 1.f || maxY <= childCell.y || minY >= childCell.y + 1.f))
+					continue;
+
+				stack.push_back(child);
+			}
+		}
+	}
+
+public:
+	CLooseQuadTree()
+	{
+		Rebuild();
+	}
+
+	int GetMaxDepth() const
+	{
+		return maxDepth;
+	}
+
+	virtual void OnObjectAdded(const CPolygonPtr& polygon) override
+	{
+		int bodyIndex;
+		if (freeBodies.empty())
+		{
+			bodyIndex = int(bodies.size());
+			bodies.emplace_back();
+		}
+		else
+		{
+			bodyIndex = freeBodies.back();
+			freeBodies.pop_back();
+		}
+
+		Body& body = bodies[bodyIndex];
+		body.polygon = polygon;
+		body.baseAABB = PolyToBaseAABB(polygon);
+		body.aabb = PolyToMovedAABB(body.baseAABB, *polygon);
+		InsertBody(bodyIndex);
+
+		polygonsBodies[polygon.get()] = bodyIndex;
+		TrackBody(polygon, uint32_t(bodyIndex));
+	}
+
+	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
+	{
+		auto it = polygonsBodies.find(polygon.get());
+		if (it == polygonsBodies.end())
+			return;
+
+		int bodyIndex = it->second;
+		RemoveBody(bodyIndex);
+		bodies[bodyIndex].polygon = nullptr;
+		freeBodies.push_back(bodyIndex);
+		polygonsBodies.erase(it);
+		UntrackBody(polygon);
+	}
+
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+	{
+		// the bodies staying in their node only have their AABB updated, the others then change of node one at a time
+		movedBodies.resize(polygons.size());
+		ForEachRange(polygons.size(), [this, &polygons](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Body& body = bodies[GetBody(*polygons[i])];
+				MovedBody& movedBody = movedBodies[i];
+				movedBody.aabb = PolyToMovedAABB(body.baseAABB, *polygons[i]);
+				movedBody.changesNode = MustMoveBody(body, movedBody.aabb);
+				if (!movedBody.changesNode)
+					body.aabb = movedBody.aabb;
+			}
+		});
+
+		for (size_t i = 0; i < polygons.size(); i++)
+		{
+			if (!movedBodies[i].changesNode)
+				continue;
+
+			int bodyIndex = int(GetBody(*polygons[i]));
+			RemoveBody(bodyIndex);
+			bodies[bodyIndex].aabb = movedBodies[i].aabb;
+			InsertBody(bodyIndex);
+		}
+	}
+
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
+	{
+		// the bodies out of the root are still found, the rebuild only keeps the tree efficient
+		if (outsideBodiesCount > 0)
+			Rebuild();
+
+		if (gVars->bDebug)
+			DisplayDebug();
+
+		// in the order of the tree, so that the nodes around consecutive bodies stay in cache
+		bodiesInTreeOrder.clear();
+		nodesToVisit.clear();
+		nodesToVisit.push_back(root);
+		while (!nodesToVisit.empty())
+		{
+			const Node& node = nodes[nodesToVisit.back()];
+			nodesToVisit.pop_back();
+
+			for (int bodyIndex = node.firstBody; bodyIndex != none; bodyIndex = bodies[bodyIndex].next)
+			{
+				bodiesInTreeOrder.push_back(bodyIndex);
+			}
+
+			for (int child : node.children)
+			{
+				if (child != none)
+					nodesToVisit.push_back(child);
+			}
+		}
+
+		AddPairs(bodiesInTreeOrder.size(), pairsToCheck, [this](size_t firstBody, size_t lastBody, std::vector<SPolygonPair>& chunkPairs)
+		{
+			std::vector<int>& stack = chunksStacks[CParallelPairs::GetChunk(firstBody, bodiesInTreeOrder.size())];
+			for (size_t i = firstBody; i < lastBody; i++)
+			{
+				int bodyIndex = bodiesInTreeOrder[i];
+				AddCollidingPairs(bodyIndex, stack, chunkPairs);
+				AddStaticCollidingPairs(bodies[bodyIndex].polygon, bodies[bodyIndex].aabb, chunkPairs);
+			}
+		});
+	}
+
+	void DisplayDebug()
+	{
+		gVars->pRenderer->DisplayText("Loose quad tree, max depth " + std::to_string(maxDepth) + ", " + std::to_string(outsideBodiesCount) + " bodies out of the root");
+
+		for (const Node& node : nodes)
+		{
+			if (node.depth == none)
+				continue;
+
+			float cellSize = cellsSizes[node.depth];
+			Vec2 cellMin = rootMin + Vec2(node.cell.x * cellSize, node.cell.y * cellSize);
+			float color = Max(0.1f, 1.f - node.depth * 0.1f);
+			gVars->pRenderer->DrawAABB(AABB(cellMin, cellMin + Vec2(cellSize, cellSize)), color, 0, 0);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _MOVED_POLYGONS_H_
+#define _MOVED_POLYGONS_H_
+
+#include "Polygon.h"
+#include <cstdint>
+#include <vector>
+
+// Polygons moved since their broad phase was last updated : a polygon adds itself once whatever the amount of changes of its transform
+// (the constraints move the colliding ones at every iteration), so the broad phase updates each of its bodies once per query, in one batch.
+class CMovedPolygons
+{
+	std::vector<CPolygon*> polygons;
+
+public:
+	// The polygon then adds itself when moved, with the index of its body in the broad phase
+	void Track(CPolygon& polygon, uint32_t body)
+	{
+		polygon.movedPolygons = this;
+		polygon.broadPhaseBody = body;
+		polygon.indexInMovedPolygons = -1;
+	}
+
+	void Untrack(CPolygon& polygon)
+	{
+		if (polygon.movedPolygons != this)
+			return;
+
+		int index = polygon.indexInMovedPolygons;
+		if (index >= 0)
+		{
+			polygons[index] = polygons.back();
+			polygons[index]->indexInMovedPolygons = index;
+			polygons.pop_back();
+		}
+
+		polygon.movedPolygons = nullptr;
+		polygon.indexInMovedPolygons = -1;
+	}
+
+	// See CPolygon::OnTransformUpdated
+	void Add(CPolygon& polygon)
+	{
+		if (polygon.indexInMovedPolygons >= 0)
+			return;
+
+		polygon.indexInMovedPolygons = int(polygons.size());
+		polygons.push_back(&polygon);
+	}
+
+	const std::vector<CPolygon*>& GetPolygons() const
+	{
+		return polygons;
+	}
+
+	bool IsEmpty() const
+	{
+		return polygons.empty();
+	}
+
+	// Once the moved polygons are updated
+	void Clear()
+	{
+		for (CPolygon* polygon : polygons)
+		{
+			polygon->indexInMovedPolygons = -1;
+		}
+		polygons.clear();
+	}
+};
+
+#endif
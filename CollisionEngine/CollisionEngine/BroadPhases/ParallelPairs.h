@@ -0,0 +1,55 @@
+#ifndef _PARALLEL_PAIRS_H_
+#define _PARALLEL_PAIRS_H_
+
+#include "Parallel.h"
+#include "Polygon.h"
+#include <vector>
+
+// Pairs found on every core : the items are split in a fixed amount of chunks, each chunk writing in its own buffer,
+// and the buffers are concatenated in the order of the chunks without locks, so the pairs and their order don't depend on the amount of threads.
+class CParallelPairs
+{
+public:
+	static constexpr size_t chunksCount = 64;
+
+	// Calls functor(begin, end, chunkPairs) on the chunks of [0, itemsCount) and appends their pairs to pairsToCheck
+	template<typename TFunctor>
+	void AddPairs(size_t itemsCount, std::vector<SPolygonPair>& pairsToCheck, TFunctor&& functor)
+	{
+		size_t chunkSize = GetChunkSize(itemsCount);
+		ParallelFor(chunksCount, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t chunk = begin; chunk < end; chunk++)
+			{
+				size_t first = Min(chunk * chunkSize, itemsCount);
+				size_t last = Min(first + chunkSize, itemsCount);
+				if (first < last)
+					functor(first, last, buffers[chunk]);
+			}
+		});
+
+		// the buffers keep their capacity for the next query, as pairsToCheck does
+		for (std::vector<SPolygonPair>& buffer : buffers)
+		{
+			pairsToCheck.insert(pairsToCheck.end(), buffer.begin(), buffer.end());
+			buffer.clear();
+		}
+	}
+
+	// Chunk of the functor called on [begin, end), for the broad phases keeping scratch buffers per chunk
+	static size_t GetChunk(size_t begin, size_t itemsCount)
+	{
+		size_t chunkSize = GetChunkSize(itemsCount);
+		return chunkSize > 0 ? begin / chunkSize : 0;
+	}
+
+private:
+	std::vector<SPolygonPair> buffers[chunksCount];
+
+	static size_t GetChunkSize(size_t itemsCount)
+	{
+		return (itemsCount + chunksCount - 1) / chunksCount;
+	}
+};
+
+#endif
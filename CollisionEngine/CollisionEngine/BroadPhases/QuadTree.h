@@ -186,15 +186,8 @@ public:
 	virtual void OnObjectAdded(const CPolygonPtr& newPolygon) override
 	{
 		std::unique_ptr<PolygonWithQuadTreeData> polyWithData = std::make_unique<PolygonWithQuadTreeData>();
-		PolygonWithQuadTreeData* polyDataPtr = polyWithData.get();
 		polyWithData->poly = newPolygon;
-		polyWithData->poly->onTransformUpdatedCallback = [this, polyDataPtr](const CPolygon& poly)
-		{
-			RemoveObjectFromTree(*polyDataPtr);
-			UpdateAABBTransformFromPolygon(polyDataPtr->moveableAABB, poly);
-			AddObjectToTree(*polyDataPtr);
-
-		};
+		TrackBody(newPolygon, uint32_t(polys.size()));
 		polyWithData->moveableAABB = PolyToMoveableAABB(newPolygon);
 		AddObjectToTree(*polyWithData);
 
@@ -207,7 +200,18 @@ public:
 	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
 	{
 		//RemoveObjectFromTree(polygon);
-		polygon->onTransformUpdatedCallback = nullptr;
+		UntrackBody(polygon);
+	}
+
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+	{
+		for (CPolygon* polygon : polygons)
+		{
+			PolygonWithQuadTreeData& polyData = *polys[GetBody(*polygon)];
+			RemoveObjectFromTree(polyData);
+			UpdateAABBTransformFromPolygon(polyData.moveableAABB, *polygon);
+			AddObjectToTree(polyData);
+		}
 	}
 
 	void AddCollidingPairsChildren(const QuadTreeNode& node, const QuadTreeNode& subNode, std::vector<SPolygonPair>& pairsToCheck)
@@ -258,6 +262,14 @@ public:
 	{
 		AddCollidingPairs(treeRoot, pairsToCheck);
 
+		if (HasStaticBodies())
+		{
+			for (const std::unique_ptr<PolygonWithQuadTreeData>& poly : polys)
+			{
+				AddStaticCollidingPairs(poly->poly, poly->moveableAABB.GetmovedAABB(), pairsToCheck);
+			}
+		}
+
 		if (gVars->bDebug)
 		{
 			gVars->pRenderer->DisplayText("QuadTree");
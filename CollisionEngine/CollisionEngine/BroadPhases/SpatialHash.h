@@ -0,0 +1,246 @@
+#ifndef _SPATIAL_HASH_H_
+#define _SPATIAL_HASH_H_
+
+#include "BroadPhase.h"
+#include "CellsHashTable.h"
+
+#include "Conversion.h"
+#include "Polygon.h"
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Renderer.h"
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid on flat arrays : the cells hold the indices of the bodies overlapping them (see CCellsHashTable).
+// The pairs are found per cell when queried, a pair being reported only by the cell holding the min corner
+// of the intersection of the two AABBs, so no pair set is needed.
+class CSpatialHash : public IBroadPhase
+{
+	struct CellsBounds
+	{
+		Vec2Int min;
+		Vec2Int max;
+
+		bool Contains(int x, int y) const
+		{
+			return x >= min.x && x <= max.x && y >= min.y && y <= max.y;
+		}
+
+		bool operator==(const CellsBounds& rhs) const
+		{
+			return min == rhs.min && max == rhs.max;
+		}
+	};
+
+	struct Body
+	{
+		CPolygonPtr polygon; // nullptr when free
+		AABB baseAABB; // in the space of the polygon
+		AABB aabb;
+		CellsBounds cells;
+	};
+
+	std::vector<Body> bodies;
+	std::vector<uint32_t> freeBodies;
+	std::unordered_map<const CPolygon*, uint32_t> polygonsBodies;
+
+	CCellsHashTable cellsTable;
+
+	std::vector<CellsBounds> movedBodiesCells; // of the polygons given to UpdateBodies
+
+	int ToCellCoord(float value) const
+	{
+		return int(floorf(value / cellSize));
+	}
+
+	CellsBounds GetCellsBounds(const AABB& aabb) const
+	{
+		return { Vec2Int{ ToCellCoord(aabb.pMin.x), ToCellCoord(aabb.pMin.y) }, Vec2Int{ ToCellCoord(aabb.pMax.x), ToCellCoord(aabb.pMax.y) } };
+	}
+
+	void AddBodyToCells(uint32_t body, const CellsBounds& bounds)
+	{
+		for (int y = bounds.min.y; y <= bounds.max.y; y++)
+		{
+			for (int x = bounds.min.x; x <= bounds.max.x; x++)
+			{
+				cellsTable.AddBody(SCellKey{ x, y, 0 }, body);
+			}
+		}
+	}
+
+	void RemoveBodyFromCells(uint32_t body, const CellsBounds& bounds)
+	{
+		for (int y = bounds.min.y; y <= bounds.max.y; y++)
+		{
+			for (int x = bounds.min.x; x <= bounds.max.x; x++)
+			{
+				cellsTable.RemoveBody(SCellKey{ x, y, 0 }, body);
+			}
+		}
+	}
+
+	void MoveBodyCells(uint32_t bodyIndex, const CellsBounds& newCells)
+	{
+		Body& body = bodies[bodyIndex];
+
+		// only the cells of one of the bounds change
+		const CellsBounds oldCells = body.cells;
+		for (int y = oldCells.min.y; y <= oldCells.max.y; y++)
+		{
+			for (int x = oldCells.min.x; x <= oldCells.max.x; x++)
+			{
+				if (!newCells.Contains(x, y))
+					cellsTable.RemoveBody(SCellKey{ x, y, 0 }, bodyIndex);
+			}
+		}
+
+		for (int y = newCells.min.y; y <= newCells.max.y; y++)
+		{
+			for (int x = newCells.min.x; x <= newCells.max.x; x++)
+			{
+				if (!oldCells.Contains(x, y))
+					cellsTable.AddBody(SCellKey{ x, y, 0 }, bodyIndex);
+			}
+		}
+
+		body.cells = newCells;
+	}
+
+	void AddCellCollidingPairs(const CCellsHashTable::Cell& cell, std::vector<SPolygonPair>& pairsToCheck) const
+	{
+		for (uint32_t i = 0; i < cell.count; i++)
+		{
+			const Body& bodyA = bodies[cellsTable.GetCellBody(cell, i)];
+			for (uint32_t j = i + 1; j < cell.count; j++)
+			{
+				const Body& bodyB = bodies[cellsTable.GetCellBody(cell, j)];
+
+				// the min corner of the intersection is in one cell only
+				if (cell.key.x != Max(bodyA.cells.min.x, bodyB.cells.min.x) || cell.key.y != Max(bodyA.cells.min.y, bodyB.cells.min.y))
+					continue;
+
+				if (bodyA.aabb.CheckCollision(bodyB.aabb))
+					pairsToCheck.push_back(SPolygonPair(bodyA.polygon, bodyB.polygon));
+			}
+		}
+	}
+
+public:
+	float cellSize = 1.f;
+
+	CSpatialHash(float newCellSize = 1.f) : cellSize(newCellSize)
+	{
+	}
+
+	virtual void OnObjectAdded(const CPolygonPtr& polygon) override
+	{
+		uint32_t bodyIndex;
+		if (freeBodies.empty())
+		{
+			bodyIndex = uint32_t(bodies.size());
+			bodies.emplace_back();
+		}
+		else
+		{
+			bodyIndex = freeBodies.back();
+			freeBodies.pop_back();
+		}
+
+		Body& body = bodies[bodyIndex];
+		body.polygon = polygon;
+		body.baseAABB = PolyToBaseAABB(polygon);
+		body.aabb = PolyToMovedAABB(body.baseAABB, *polygon);
+		body.cells = GetCellsBounds(body.aabb);
+		AddBodyToCells(bodyIndex, body.cells);
+
+		polygonsBodies[polygon.get()] = bodyIndex;
+		TrackBody(polygon, bodyIndex);
+	}
+
+	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
+	{
+		auto it = polygonsBodies.find(polygon.get());
+		if (it == polygonsBodies.end())
+			return;
+
+		uint32_t bodyIndex = it->second;
+		RemoveBodyFromCells(bodyIndex, bodies[bodyIndex].cells);
+		bodies[bodyIndex].polygon = nullptr;
+		freeBodies.push_back(bodyIndex);
+		polygonsBodies.erase(it);
+		UntrackBody(polygon);
+	}
+
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+	{
+		// the AABBs and their cells are independent, the table is then changed one body at a time
+		movedBodiesCells.resize(polygons.size());
+		ForEachRange(polygons.size(), [this, &polygons](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Body& body = bodies[GetBody(*polygons[i])];
+				body.aabb = PolyToMovedAABB(body.baseAABB, *polygons[i]);
+				movedBodiesCells[i] = GetCellsBounds(body.aabb);
+			}
+		});
+
+		for (size_t i = 0; i < polygons.size(); i++)
+		{
+			uint32_t bodyIndex = GetBody(*polygons[i]);
+			if (!(movedBodiesCells[i] == bodies[bodyIndex].cells))
+				MoveBodyCells(bodyIndex, movedBodiesCells[i]);
+		}
+	}
+
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
+	{
+		if (gVars->bDebug)
+			DisplayDebug();
+
+		cellsTable.RemoveEmptyCells();
+
+		// the cells are independent, split in ranges when parallel
+		const std::vector<CCellsHashTable::Cell>& cells = cellsTable.GetCells();
+		AddPairs(cells.size(), pairsToCheck, [this, &cells](size_t firstCell, size_t lastCell, std::vector<SPolygonPair>& chunkPairs)
+		{
+			for (size_t cellIndex = firstCell; cellIndex < lastCell; cellIndex++)
+			{
+				AddCellCollidingPairs(cells[cellIndex], chunkPairs);
+			}
+		});
+
+		if (HasStaticBodies())
+		{
+			AddPairs(bodies.size(), pairsToCheck, [this](size_t firstBody, size_t lastBody, std::vector<SPolygonPair>& chunkPairs)
+			{
+				for (size_t bodyIndex = firstBody; bodyIndex < lastBody; bodyIndex++)
+				{
+					const Body& body = bodies[bodyIndex];
+					if (body.polygon != nullptr)
+						AddStaticCollidingPairs(body.polygon, body.aabb, chunkPairs);
+				}
+			});
+		}
+	}
+
+	void DisplayDebug()
+	{
+		gVars->pRenderer->DisplayText("Spatial hash, " + std::to_string(cellsTable.GetOccupiedCellsCount()) + " cells");
+
+		for (const CCellsHashTable::Cell& cell : cellsTable.GetCells())
+		{
+			if (cell.count == 0)
+				continue;
+
+			Vec2 cellMin = Vec2(cell.key.x * cellSize, cell.key.y * cellSize);
+			gVars->pRenderer->DrawAABB(AABB(cellMin, cellMin + Vec2(cellSize, cellSize)), 1, 0, 0);
+		}
+	}
+};
+
+#endif
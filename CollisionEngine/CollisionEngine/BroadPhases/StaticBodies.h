@@ -0,0 +1,229 @@
+#ifndef _STATIC_BODIES_H_
+#define _STATIC_BODIES_H_
+
+#include "Conversion.h"
+#include "MovedPolygons.h"
+#include "Polygon.h"
+#include "GlobalVariables.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Bodies with an infinite mass, kept out of the broad phases : they are in a bounding volume hierarchy built at once
+// rather than by insertions, the bodies being split at the median of their centers on the longest axis, down to a few per leaf.
+// The broad phases only look for the static bodies colliding with each of theirs, so the static pairs are never reported.
+// Adding, removing or moving a static body rebuilds the hierarchy at the next Update.
+class CStaticBodies
+{
+	static constexpr int maxLeafBodiesCount = 4;
+	static constexpr int maxDepth = 64; // median splits, so about log2 of the bodies count
+
+	struct Node
+	{
+		AABB aabb;
+		int first; // first body for leaves, second child for internal nodes (the first child is the next node)
+		int count; // bodies count, 0 for internal nodes
+	};
+
+	struct Body
+	{
+		CPolygonPtr polygon;
+		AABB aabb;
+	};
+
+	std::vector<CPolygonPtr> polygons;
+	std::unordered_map<const CPolygon*, size_t> polygonsIndices;
+	CMovedPolygons movedPolygons;
+	bool dirty = false;
+
+	std::vector<Body> bodies; // in the leaves order
+	std::vector<Node> nodes; // depth first
+
+	static float GetCenter(const AABB& aabb, int axis)
+	{
+		return axis == 0 ? aabb.pMin.x + aabb.pMax.x : aabb.pMin.y + aabb.pMax.y;
+	}
+
+	int BuildNode(int begin, int end)
+	{
+		int nodeIndex = int(nodes.size());
+		nodes.emplace_back();
+
+		AABB aabb = bodies[begin].aabb;
+		Vec2 firstCenter = (aabb.pMin + aabb.pMax) * 0.5f;
+		AABB centers = AABB(firstCenter, firstCenter);
+		for (int i = begin + 1; i < end; i++)
+		{
+			aabb = aabb.Merge(bodies[i].aabb);
+			centers.EnlargeWithPoint((bodies[i].aabb.pMin + bodies[i].aabb.pMax) * 0.5f);
+		}
+		nodes[nodeIndex].aabb = aabb;
+
+		if (end - begin <= maxLeafBodiesCount)
+		{
+			nodes[nodeIndex].first = begin;
+			nodes[nodeIndex].count = end - begin;
+			return nodeIndex;
+		}
+
+		int axis = centers.pMax.x - centers.pMin.x >= centers.pMax.y - centers.pMin.y ? 0 : 1;
+		int middle = (begin + end) / 2;
+		std::nth_element(bodies.begin() + begin, bodies.begin() + middle, bodies.begin() + end, [axis](const Body& a, const Body& b)
+		{
+			return GetCenter(a.aabb, axis) < GetCenter(b.aabb, axis);
+		});
+
+		BuildNode(begin, middle);
+		int secondChild = BuildNode(middle, end);
+		nodes[nodeIndex].first = secondChild;
+		nodes[nodeIndex].count = 0;
+		return nodeIndex;
+	}
+
+	void Build()
+	{
+		bodies.clear();
+		nodes.clear();
+		for (const CPolygonPtr& polygon : polygons)
+		{
+			bodies.push_back({ polygon, PolyToMoveableAABB(polygon).GetmovedAABB() });
+		}
+
+		if (!bodies.empty())
+			BuildNode(0, int(bodies.size()));
+	}
+
+public:
+	~CStaticBodies()
+	{
+		Clear();
+	}
+
+	void Add(const CPolygonPtr& polygon)
+	{
+		polygonsIndices[polygon.get()] = polygons.size();
+		polygons.push_back(polygon);
+		dirty = true;
+		movedPolygons.Track(*polygon, 0);
+	}
+
+	void Remove(const CPolygonPtr& polygon)
+	{
+		auto it = polygonsIndices.find(polygon.get());
+		if (it == polygonsIndices.end())
+			return;
+
+		size_t index = it->second;
+		polygons[index] = polygons.back();
+		polygonsIndices[polygons[index].get()] = index;
+		polygons.pop_back();
+		polygonsIndices.erase(it);
+		dirty = true;
+		movedPolygons.Untrack(*polygon);
+	}
+
+	void Clear()
+	{
+		for (const CPolygonPtr& polygon : polygons)
+		{
+			movedPolygons.Untrack(*polygon);
+		}
+
+		polygons.clear();
+		polygonsIndices.clear();
+		dirty = true;
+	}
+
+	bool Contains(const CPolygonPtr& polygon) const
+	{
+		return polygonsIndices.find(polygon.get()) != polygonsIndices.end();
+	}
+
+	bool IsEmpty() const
+	{
+		return polygons.empty();
+	}
+
+	const std::vector<CPolygonPtr>& GetPolygons() const
+	{
+		return polygons;
+	}
+
+	// Before the queries of the frame
+	void Update()
+	{
+		if (!movedPolygons.IsEmpty())
+		{
+			dirty = true;
+			movedPolygons.Clear();
+		}
+
+		if (!dirty)
+			return;
+
+		Build();
+		dirty = false;
+	}
+
+	// Pairs of the polygon of a broad phase with the static bodies its AABB overlaps
+	void AddCollidingPairs(const CPolygonPtr& polygon, const AABB& aabb, std::vector<SPolygonPair>& pairsToCheck) const
+	{
+		if (nodes.empty() || !nodes[0].aabb.CheckCollision(aabb))
+			return;
+
+		// the children are tested before going down, and the first overlapping one is visited without the stack
+		int stack[maxDepth];
+		int stackSize = 0;
+		int nodeIndex = 0;
+		while (true)
+		{
+			const Node& node = nodes[nodeIndex];
+			if (node.count == 0)
+			{
+				bool firstOverlaps = nodes[nodeIndex + 1].aabb.CheckCollision(aabb);
+				bool secondOverlaps = nodes[node.first].aabb.CheckCollision(aabb);
+				if (firstOverlaps)
+				{
+					if (secondOverlaps)
+						stack[stackSize++] = node.first;
+					nodeIndex++;
+					continue;
+				}
+
+				if (secondOverlaps)
+				{
+					nodeIndex = node.first;
+					continue;
+				}
+			}
+			else
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					if (bodies[i].aabb.CheckCollision(aabb))
+						pairsToCheck.push_back(SPolygonPair(polygon, bodies[i].polygon));
+				}
+			}
+
+			if (stackSize == 0)
+				return;
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	void DisplayDebug()
+	{
+		if (polygons.empty())
+			return;
+
+		gVars->pRenderer->DisplayText("Static bodies : " + std::to_string(polygons.size()) + ", " + std::to_string(nodes.size()) + " nodes");
+		for (const Node& node : nodes)
+		{
+			if (node.count > 0)
+				gVars->pRenderer->DrawAABB(node.aabb, 0, 0, 1);
+		}
+	}
+};
+
+#endif
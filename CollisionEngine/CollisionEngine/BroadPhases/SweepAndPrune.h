@@ -3,87 +3,448 @@
 
 #include "BroadPhase.h"
 
+#include "Conversion.h"
 #include "Polygon.h"
 #include "GlobalVariables.h"
 #include "World.h"
+#include "Renderer.h"
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
 
+enum class SweepMode
+{
+	// Endpoints sorted on both axes, the overlapping pairs are updated by the swaps of the insertion sorts
+	BothAxes,
+	// Endpoints sorted on the axis along which the AABBs are the most spread out, swept every frame
+	SingleAxis,
+};
+
+// Persistent sweep and prune : the min and max endpoints of the AABBs stay sorted between frames,
+// the insertion sort only has a few swaps to do when the polygons move a bit.
+// With both axes, a swap of a min and a max starts or ends an overlap on its axis, the pair overlapping or not
+// on the other axis according to the order of its endpoints there. So the overlapping pairs are kept up to date
+// with the swaps, a scene where nothing moves doesn't sort nor sweep.
 class CSweepAndPrune : public IBroadPhase
 {
-	class PolygonData
+	static constexpr int axesCount = 2;
+
+	struct Proxy
 	{
-		CPolygonPtr polygon;
-		MoveableAABB moveableAABB;
+		CPolygonPtr polygon; // nullptr when removed
+		AABB baseAABB; // in the space of the polygon
+		AABB aabb;
+
+		// positions of the endpoints in the sorted arrays
+		uint32_t minEndpoints[axesCount];
+		uint32_t maxEndpoints[axesCount];
+	};
+
+	struct Endpoint
+	{
+		float value;
+		uint32_t data; // proxy index << 1 | isMax
+
+		int GetProxy() const
+		{
+			return int(data >> 1);
+		}
 
-	public:
-		bool IsOverlappingOnXAxis(const PolygonData& polyData) const
+		bool IsMax() const
 		{
-			return moveableAABB.GetmovedAABB().pMin.x < polyData.moveableAABB.GetmovedAABB().pMax.x
-				&& moveableAABB.GetmovedAABB().pMax.x > polyData.moveableAABB.GetmovedAABB().pMin.x;
+			return (data & 1) != 0;
 		}
 
-		bool IsOverlappingOnYAxis(const PolygonData& polyData) const
+		// at the same value a min is first, so the min of a proxy is always before its max
+		bool IsBefore(const Endpoint& rhs) const
 		{
-			return moveableAABB.GetmovedAABB().pMin.y < polyData.moveableAABB.GetmovedAABB().pMax.y
-				&& moveableAABB.GetmovedAABB().pMax.y > polyData.moveableAABB.GetmovedAABB().pMin.y;
+			return value < rhs.value || (value == rhs.value && !IsMax() && rhs.IsMax());
 		}
+	};
+
+	struct ProxyPair
+	{
+		int proxyA;
+		int proxyB;
+	};
+
+	std::vector<Proxy> proxies;
+	std::vector<int> freeProxies;
+	std::vector<int> removedProxies; // freed once their endpoints and pairs are removed
+	std::unordered_map<const CPolygon*, int> polygonsProxies;
+
+	std::vector<Endpoint> endpoints[axesCount];
+	bool endpointsDirty = false;
+	size_t addedEndpointsCount = 0; // since the last sort, per axis
 
-	public:
-		PolygonData(const CPolygonPtr& poly) : polygon(poly), moveableAABB(PolyToMoveableAABB(poly))
+	// Overlapping pairs, with their index in the vector (both axes mode)
+	std::vector<ProxyPair> pairs;
+	std::unordered_map<uint64_t, size_t> pairsIndices;
+
+	SweepMode sortedMode = SweepMode::BothAxes; // mode of the endpoints arrays, rebuilt when mode changes
+	bool endpointsSorted = false;
+	int sweepAxis = 0; // single axis mode
+	int framesSinceAxisSelection = 0;
+
+	// Sweep scratch : proxies between their min and their max, with their index in the active list
+	std::vector<int> activeProxies;
+	std::vector<size_t> activeIndices;
+
+	static float GetAxisValue(const Vec2& v, int axis)
+	{
+		return axis == 0 ? v.x : v.y;
+	}
+
+	static uint64_t GetPairKey(int proxyA, int proxyB)
+	{
+		if (proxyA > proxyB)
+			std::swap(proxyA, proxyB);
+		return (uint64_t(proxyA) << 32) | uint64_t(proxyB);
+	}
+
+	void AddPair(int proxyA, int proxyB)
+	{
+		auto result = pairsIndices.emplace(GetPairKey(proxyA, proxyB), pairs.size());
+		if (result.second)
+			pairs.push_back({ proxyA, proxyB });
+	}
+
+	void RemovePair(int proxyA, int proxyB)
+	{
+		auto it = pairsIndices.find(GetPairKey(proxyA, proxyB));
+		if (it == pairsIndices.end())
+			return;
+
+		size_t index = it->second;
+		pairsIndices.erase(it);
+
+		if (index + 1 < pairs.size())
+		{
+			pairs[index] = pairs.back();
+			pairsIndices[GetPairKey(pairs[index].proxyA, pairs[index].proxyB)] = index;
+		}
+		pairs.pop_back();
+	}
+
+	// Overlap given by the order of the endpoints, the same as the AABBs (touching ones included) once the axis is sorted
+	bool IsOverlappingInOrder(int proxyA, int proxyB, int axis) const
+	{
+		const Proxy& a = proxies[proxyA];
+		const Proxy& b = proxies[proxyB];
+		return a.minEndpoints[axis] < b.maxEndpoints[axis] && b.minEndpoints[axis] < a.maxEndpoints[axis];
+	}
+
+	void SetEndpointPosition(const Endpoint& endpoint, int axis, uint32_t position)
+	{
+		Proxy& proxy = proxies[endpoint.GetProxy()];
+		if (endpoint.IsMax())
+			proxy.maxEndpoints[axis] = position;
+		else
+			proxy.minEndpoints[axis] = position;
+	}
+
+	void UpdateEndpointsPositions(int axis)
+	{
+		for (size_t i = 0; i < endpoints[axis].size(); i++)
 		{
-			MoveableAABB& aabb = moveableAABB;
-			poly->onTransformUpdatedCallback = [&aabb, this](const CPolygon& poly)
+			SetEndpointPosition(endpoints[axis][i], axis, uint32_t(i));
+		}
+	}
+
+	// Endpoints and pairs of the removed proxies are removed in one pass
+	void FlushRemovedProxies()
+	{
+		if (removedProxies.empty())
+			return;
+
+		for (int axis = 0; axis < axesCount; axis++)
+		{
+			endpoints[axis].erase(std::remove_if(endpoints[axis].begin(), endpoints[axis].end(), [this](const Endpoint& endpoint)
 			{
-				UpdateAABBTransformFromPolygon(aabb, poly);
-				UpdateAxisProjections();
-			};
-			UpdateAxisProjections();
+				return proxies[endpoint.GetProxy()].polygon == nullptr;
+			}), endpoints[axis].end());
+			UpdateEndpointsPositions(axis);
+		}
+
+		pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [this](const ProxyPair& pair)
+		{
+			return proxies[pair.proxyA].polygon == nullptr || proxies[pair.proxyB].polygon == nullptr;
+		}), pairs.end());
+
+		pairsIndices.clear();
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			pairsIndices.emplace(GetPairKey(pairs[i].proxyA, pairs[i].proxyB), i);
+		}
+
+		freeProxies.insert(freeProxies.end(), removedProxies.begin(), removedProxies.end());
+		removedProxies.clear();
+	}
+
+	void UpdateEndpointsValues(int axis)
+	{
+		for (Endpoint& endpoint : endpoints[axis])
+		{
+			const AABB& aabb = proxies[endpoint.GetProxy()].aabb;
+			endpoint.value = GetAxisValue(endpoint.IsMax() ? aabb.pMax : aabb.pMin, axis);
+		}
+	}
+
+	// Full sort and sweep, when the endpoints order doesn't help anymore (many added polygons)
+	void RebuildPairs()
+	{
+		for (int axis = 0; axis < axesCount; axis++)
+		{
+			SortAxisFully(axis);
+		}
+
+		pairs.clear();
+		pairsIndices.clear();
+
+		Sweep(0, [this](int proxyA, int proxyB)
+		{
+			if (IsOverlappingInOrder(proxyA, proxyB, 1))
+				AddPair(proxyA, proxyB);
+		});
+	}
+
+	// Calls onCandidate for every pair of proxies overlapping on the sorted axis
+	template<typename TOnCandidate>
+	void Sweep(int axis, TOnCandidate&& onCandidate)
+	{
+		activeProxies.clear();
+		activeIndices.resize(proxies.size());
+
+		for (const Endpoint& endpoint : endpoints[axis])
+		{
+			int proxyIndex = endpoint.GetProxy();
+			if (!endpoint.IsMax())
+			{
+				lastCandidatesCount += activeProxies.size();
+				for (int activeProxy : activeProxies)
+				{
+					onCandidate(activeProxy, proxyIndex);
+				}
+				activeIndices[proxyIndex] = activeProxies.size();
+				activeProxies.push_back(proxyIndex);
+			}
+			else
+			{
+				size_t index = activeIndices[proxyIndex];
+				activeProxies[index] = activeProxies.back();
+				activeIndices[activeProxies[index]] = index;
+				activeProxies.pop_back();
+			}
+		}
+	}
+
+	void SortAxisFully(int axis)
+	{
+		std::sort(endpoints[axis].begin(), endpoints[axis].end(), [](const Endpoint& lhs, const Endpoint& rhs)
+		{
+			return lhs.IsBefore(rhs);
+		});
+		UpdateEndpointsPositions(axis);
+	}
+
+	// Insertion sort, every endpoint going down swaps with the ones it passes (and updates the pairs if asked)
+	void SortAxis(int axis, bool updatePairs)
+	{
+		std::vector<Endpoint>& axisEndpoints = endpoints[axis];
+		const int otherAxis = 1 - axis;
+
+		for (size_t i = 1; i < axisEndpoints.size(); i++)
+		{
+			Endpoint moved = axisEndpoints[i];
+			size_t j = i;
+			while (j > 0 && moved.IsBefore(axisEndpoints[j - 1]))
+			{
+				const Endpoint& passed = axisEndpoints[j - 1];
+				if (updatePairs && !moved.IsMax() && passed.IsMax())
+				{
+					lastCandidatesCount++;
+					// a min going below a max : the intervals start to overlap on this axis
+					if (IsOverlappingInOrder(moved.GetProxy(), passed.GetProxy(), otherAxis))
+						AddPair(moved.GetProxy(), passed.GetProxy());
+				}
+				else if (updatePairs && moved.IsMax() && !passed.IsMax())
+				{
+					// a max going below a min : they don't overlap anymore
+					if (IsOverlappingInOrder(moved.GetProxy(), passed.GetProxy(), otherAxis))
+						RemovePair(moved.GetProxy(), passed.GetProxy());
+				}
+
+				axisEndpoints[j] = passed;
+				SetEndpointPosition(passed, axis, uint32_t(j));
+				j--;
+			}
+			axisEndpoints[j] = moved;
+			SetEndpointPosition(moved, axis, uint32_t(j));
 		}
+	}
 
-		PolygonData(PolygonData&& rhs) noexcept = default;
+	void UpdateBothAxes()
+	{
+		if (!endpointsDirty && endpointsSorted && sortedMode == SweepMode::BothAxes)
+			return;
 
-		PolygonData& operator=(PolygonData&& rhs) = default;
+		for (int axis = 0; axis < axesCount; axis++)
+		{
+			UpdateEndpointsValues(axis);
+		}
 
-		void UpdateAxisProjections()
+		// the added endpoints would go down through most of the arrays
+		if (addedEndpointsCount * 8 > endpoints[0].size() || !endpointsSorted || sortedMode != SweepMode::BothAxes)
 		{
-			// in case we have to project on an axis that is not (0,1) or (1,0),
-			// we can precompute projections here
+			RebuildPairs();
 		}
+		else
+		{
+			for (int axis = 0; axis < axesCount; axis++)
+			{
+				SortAxis(axis, true);
+			}
+		}
+	}
 
-		bool IsOverlapppingOnAxis(const PolygonData& polyData) const
+	// Axis with the largest variance of the AABBs centers : the one on which the fewest AABBs overlap
+	int SelectSweepAxis() const
+	{
+		double sums[axesCount] = {};
+		double squaredSums[axesCount] = {};
+		size_t count = 0;
+		for (const Proxy& proxy : proxies)
 		{
-			// Compares on different axis
-			return IsOverlappingOnXAxis(polyData) && IsOverlappingOnYAxis(polyData); // currently comparing aabb
+			if (proxy.polygon == nullptr)
+				continue;
+
+			Vec2 center = (proxy.aabb.pMin + proxy.aabb.pMax) * 0.5f;
+			for (int axis = 0; axis < axesCount; axis++)
+			{
+				double value = GetAxisValue(center, axis);
+				sums[axis] += value;
+				squaredSums[axis] += value * value;
+			}
+			count++;
 		}
 
-		float GetAxisSortValueMin() const
+		if (count == 0)
+			return sweepAxis;
+
+		int bestAxis = 0;
+		double bestVariance = -1.0;
+		for (int axis = 0; axis < axesCount; axis++)
 		{
-			return moveableAABB.GetmovedAABB().pMin.x;
+			double mean = sums[axis] / count;
+			double variance = squaredSums[axis] / count - mean * mean;
+			if (variance > bestVariance)
+			{
+				bestVariance = variance;
+				bestAxis = axis;
+			}
 		}
+		return bestAxis;
+	}
 
+	void UpdateSingleAxis()
+	{
+		bool resort = !endpointsSorted || sortedMode != SweepMode::SingleAxis;
 
-		float GetAxisSortValueMax() const
+		if (++framesSinceAxisSelection >= axisSelectionPeriod || resort)
 		{
-			return moveableAABB.GetmovedAABB().pMax.x;
+			framesSinceAxisSelection = 0;
+			int newAxis = fixedSweepAxis >= 0 ? fixedSweepAxis : SelectSweepAxis();
+			resort |= newAxis != sweepAxis;
+			sweepAxis = newAxis;
 		}
 
-		GETTER(polygon)
-	};
-	std::vector<std::unique_ptr<PolygonData>> polygons;
+		if (!endpointsDirty && !resort)
+			return;
+
+		UpdateEndpointsValues(sweepAxis);
+
+		// the other axis isn't sorted anymore, the pairs will be rebuilt when going back to both axes
+		if (resort || addedEndpointsCount * 8 > endpoints[sweepAxis].size())
+			SortAxisFully(sweepAxis);
+		else
+			SortAxis(sweepAxis, false);
+	}
 
 public:
-	virtual void OnObjectAdded(const CPolygonPtr& polygon) 
+	SweepMode mode = SweepMode::SingleAxis;
+	int axisSelectionPeriod = 30; // frames between two choices of the sweep axis
+	int fixedSweepAxis = -1; // 0 : x, 1 : y, -1 : chosen from the variance of the AABBs centers
+	size_t lastCandidatesCount = 0; // pairs compared on the second axis during the last query, not counted by the parallel sweep
+
+	CSweepAndPrune(SweepMode newMode = SweepMode::SingleAxis) : mode(newMode)
 	{
-		polygons.emplace_back(std::make_unique<PolygonData>(polygon));
 	}
 
-	virtual void OnObjectRemoved(const CPolygonPtr& polygon) 
+	int GetSweepAxis() const
 	{
-		std::remove_if(polygons.begin(), polygons.end(), [polygon](const std::unique_ptr<PolygonData>& polyData)
+		return sweepAxis;
+	}
+
+	virtual void OnObjectAdded(const CPolygonPtr& polygon) override
+	{
+		int proxyIndex;
+		if (freeProxies.empty())
+		{
+			proxyIndex = int(proxies.size());
+			proxies.emplace_back();
+		}
+		else
 		{
-			return polyData == nullptr || polygon == polyData->Getpolygon();
+			proxyIndex = freeProxies.back();
+			freeProxies.pop_back();
+		}
+
+		polygonsProxies[polygon.get()] = proxyIndex;
+
+		Proxy& proxy = proxies[proxyIndex];
+		proxy.polygon = polygon;
+		proxy.baseAABB = PolyToBaseAABB(polygon);
+		proxy.aabb = PolyToMovedAABB(proxy.baseAABB, *polygon);
+
+		// Endpoints are added at the end, as if the AABB was after all the others : it overlaps nothing,
+		// the sort then finds its overlaps when they go down to their place.
+		for (int axis = 0; axis < axesCount; axis++)
+		{
+			proxy.minEndpoints[axis] = uint32_t(endpoints[axis].size());
+			endpoints[axis].push_back({ std::numeric_limits<float>::max(), uint32_t(proxyIndex) << 1 });
+			proxy.maxEndpoints[axis] = uint32_t(endpoints[axis].size());
+			endpoints[axis].push_back({ std::numeric_limits<float>::max(), (uint32_t(proxyIndex) << 1) | 1 });
+		}
+		addedEndpointsCount += 2;
+		endpointsDirty = true;
+		TrackBody(polygon, uint32_t(proxyIndex));
+	}
+
+	virtual void OnObjectRemoved(const CPolygonPtr& polygon) override
+	{
+		auto it = polygonsProxies.find(polygon.get());
+		if (it == polygonsProxies.end())
+			return;
+
+		proxies[it->second].polygon = nullptr;
+		removedProxies.push_back(it->second);
+		polygonsProxies.erase(it);
+		UntrackBody(polygon);
+	}
+
+	virtual void UpdateBodies(const std::vector<CPolygon*>& polygons) override
+	{
+		// the endpoints are sorted in the query
+		ForEachRange(polygons.size(), [this, &polygons](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Proxy& proxy = proxies[GetBody(*polygons[i])];
+				proxy.aabb = PolyToMovedAABB(proxy.baseAABB, *polygons[i]);
+			}
 		});
-		polygon->onTransformUpdatedCallback = nullptr;
+		endpointsDirty = true;
 	}
 
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
@@ -91,51 +452,116 @@ public:
 		if (gVars->bDebug)
 			DisplayDebug();
 
-		std::sort(polygons.begin(), polygons.end(), [](const std::unique_ptr<PolygonData>& p1, const std::unique_ptr<PolygonData>& p2) -> bool
-		{
-			return p1->GetAxisSortValueMin() < p2->GetAxisSortValueMin();
-		});
+		FlushRemovedProxies();
+		lastCandidatesCount = 0;
 
-		static std::vector<PolygonData*> activeIntervals;
-		activeIntervals.reserve(polygons.size());
-		activeIntervals.clear();
+		if (mode == SweepMode::BothAxes)
+		{
+			// nothing moved : the pairs are still right
+			UpdateBothAxes();
 
-		for (const std::unique_ptr<PolygonData>& poly1 : polygons)
+			pairsToCheck.reserve(pairsToCheck.size() + pairs.size());
+			for (const ProxyPair& pair : pairs)
+			{
+				pairsToCheck.push_back(SPolygonPair(proxies[pair.proxyA].polygon, proxies[pair.proxyB].polygon));
+			}
+		}
+		else
 		{
-			auto it = activeIntervals.begin();
-			while (it != activeIntervals.end())
+			UpdateSingleAxis();
+
+			const int otherAxis = 1 - sweepAxis;
+			auto addPairIfOverlapping = [this, otherAxis](int proxyA, int proxyB, std::vector<SPolygonPair>& chunkPairs)
 			{
-				PolygonData* poly2 = *it;
-				if (poly1->GetAxisSortValueMin() > poly2->GetAxisSortValueMax())
+				const Proxy& a = proxies[proxyA];
+				const Proxy& b = proxies[proxyB];
+				if (GetAxisValue(a.aabb.pMin, otherAxis) <= GetAxisValue(b.aabb.pMax, otherAxis)
+					&& GetAxisValue(b.aabb.pMin, otherAxis) <= GetAxisValue(a.aabb.pMax, otherAxis))
 				{
-					it = activeIntervals.erase(it);
+					chunkPairs.push_back(SPolygonPair(a.polygon, b.polygon));
 				}
-				else
+			};
+
+			if (parallelPairs)
+			{
+				// Without the active list, the segments of the sorted endpoints are independent :
+				// each min is paired with the mins between it and its max, the same pairs as the sweep
+				const std::vector<Endpoint>& axisEndpoints = endpoints[sweepAxis];
+				AddPairs(axisEndpoints.size(), pairsToCheck, [this, &axisEndpoints, &addPairIfOverlapping](size_t firstEndpoint, size_t lastEndpoint, std::vector<SPolygonPair>& chunkPairs)
 				{
-					if (poly1->IsOverlappingOnYAxis(*poly2))
-						pairsToCheck.push_back(SPolygonPair(poly1->Getpolygon(), poly2->Getpolygon()));
-					it++;
-				}
+					for (size_t i = firstEndpoint; i < lastEndpoint; i++)
+					{
+						if (axisEndpoints[i].IsMax())
+							continue;
+
+						int proxyA = axisEndpoints[i].GetProxy();
+						for (size_t j = i + 1; j < proxies[proxyA].maxEndpoints[sweepAxis]; j++)
+						{
+							if (!axisEndpoints[j].IsMax())
+								addPairIfOverlapping(proxyA, axisEndpoints[j].GetProxy(), chunkPairs);
+						}
+					}
+				});
+			}
+			else
+			{
+				Sweep(sweepAxis, [&addPairIfOverlapping, &pairsToCheck](int proxyA, int proxyB)
+				{
+					addPairIfOverlapping(proxyA, proxyB, pairsToCheck);
+				});
 			}
-			activeIntervals.push_back(poly1.get());
+		}
+
+		sortedMode = mode;
+		endpointsSorted = true;
+		addedEndpointsCount = 0;
+		endpointsDirty = false;
+
+		if (HasStaticBodies())
+		{
+			AddPairs(proxies.size(), pairsToCheck, [this](size_t firstProxy, size_t lastProxy, std::vector<SPolygonPair>& chunkPairs)
+			{
+				for (size_t proxyIndex = firstProxy; proxyIndex < lastProxy; proxyIndex++)
+				{
+					const Proxy& proxy = proxies[proxyIndex];
+					if (proxy.polygon != nullptr)
+						AddStaticCollidingPairs(proxy.polygon, proxy.aabb, chunkPairs);
+				}
+			});
 		}
 	}
 
 	void DisplayDebug()
 	{
-		gVars->pRenderer->DisplayText("Sweep And Prune");
+		if (mode == SweepMode::BothAxes)
+			gVars->pRenderer->DisplayText("Sweep And Prune on both axes, candidates " + std::to_string(lastCandidatesCount));
+		else
+			gVars->pRenderer->DisplayText(std::string("Sweep And Prune on ") + (sweepAxis == 0 ? "x" : "y") + ", candidates " + std::to_string(lastCandidatesCount));
 
-		gVars->pRenderer->DrawLine(Vec2(-50, 0), Vec2(50, 0), 1,1,0);
+		if (mode == SweepMode::SingleAxis && sweepAxis == 1)
+			gVars->pRenderer->DrawLine(Vec2(0, -50), Vec2(0, 50), 1, 1, 0);
+		else
+			gVars->pRenderer->DrawLine(Vec2(-50, 0), Vec2(50, 0), 1,1,0);
 
-		for (const std::unique_ptr<PolygonData>& poly1 : polygons)
+		for (const Proxy& proxy : proxies)
 		{
-			float minVal = poly1->GetAxisSortValueMin();
-			float maxVal = poly1->GetAxisSortValueMax();
+			if (proxy.polygon == nullptr)
+				continue;
+
+			if (mode == SweepMode::SingleAxis && sweepAxis == 1)
+			{
+				gVars->pRenderer->DrawLine(Vec2(proxy.polygon->Getposition().x, proxy.aabb.pMin.y), Vec2(0, proxy.aabb.pMin.y), 1, 0, 0);
+				gVars->pRenderer->DrawLine(Vec2(proxy.polygon->Getposition().x, proxy.aabb.pMax.y), Vec2(0, proxy.aabb.pMax.y), 1, 0, 0);
+				continue;
+			}
+
+			float minVal = proxy.aabb.pMin.x;
+			float maxVal = proxy.aabb.pMax.x;
 
-			gVars->pRenderer->DrawLine(Vec2(minVal, poly1->Getpolygon()->Getposition().y), Vec2(minVal, 0), 1, 0, 0);
-			gVars->pRenderer->DrawLine(Vec2(maxVal, poly1->Getpolygon()->Getposition().y), Vec2(maxVal, 0), 1, 0, 0);
+			gVars->pRenderer->DrawLine(Vec2(minVal, proxy.polygon->Getposition().y), Vec2(minVal, 0), 1, 0, 0);
+			gVars->pRenderer->DrawLine(Vec2(maxVal, proxy.polygon->Getposition().y), Vec2(maxVal, 0), 1, 0, 0);
 		}
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
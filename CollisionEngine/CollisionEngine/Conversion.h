@@ -50,6 +50,15 @@ inline void UpdateAABBTransformFromPolygon(MoveableAABB& aabb, const CPolygon& p
 		aabb.SetMovedAABB(PointsToBaseAABB(poly.GetWorldPoints()));
 }
 
+// AABB of the moved polygon, baseAABB being its PolyToBaseAABB (the broad phases keeping only the moved AABBs store it)
+inline AABB PolyToMovedAABB(const AABB& baseAABB, const CPolygon& poly)
+{
+	MoveableAABB moveableAABB;
+	moveableAABB.SetbaseAABB(baseAABB);
+	UpdateAABBTransformFromPolygon(moveableAABB, poly);
+	return moveableAABB.GetmovedAABB();
+}
+
 inline MoveableAABB PolyToMoveableAABB(const CPolygonPtr& poly)
 {
 	MoveableAABB moveableAABB;
@@ -9,8 +9,11 @@
 #include "World.h"
 //#include "Fluids/SPHMullerSystem.h"
 //#include "Fluids/EulerSystem.h"
+#include "Fluids/OOP/AdaptiveEulerFluidSystem.hpp"
 #include "Fluids/OOP/EulerFluidSystem.hpp"
+#include "Fluids/OOP/HybridFluidSystem.hpp"
 #include "Fluids/OOP/SPHMullerFluidSystem.hpp"
+#include "Fluids/OOP/TiledEulerFluidSystem.hpp"
 
 class CFluidSpawner: public CBehavior
 {
@@ -25,6 +28,13 @@ private:
 
 	int id = 0;
 
+	// F9 : fields probed around the mouse
+	bool displayProbe = false;
+	int probeRadius = 3; // in cells
+	float probeVelocityScale = 0.1f; // s, length of the velocity lines per m/s
+	std::vector<Vec2> probePoints;
+	FluidProbeResults probeResults;
+
 	virtual void Start() override
 	{
 		InitSystem(fluidSystem.get());
@@ -37,6 +47,23 @@ private:
 			eulerSys->Reset(Vec2{ 0,0 }, Vec2Int{ 200,200 }, Vec2{ cellSize, cellSize });
 		}
 
+		if (TiledEulerFluidSystem* tiledSys = dynamic_cast<TiledEulerFluidSystem*>(system))
+		{
+			// tiles are only allocated around the fluid, so the domain can be much bigger
+			tiledSys->Reset(Vec2{ 0,0 }, Vec2Int{ 4096,4096 }, Vec2{ cellSize, cellSize });
+		}
+
+		if (AdaptiveEulerFluidSystem* adaptiveSys = dynamic_cast<AdaptiveEulerFluidSystem*>(system))
+		{
+			// 100x100 coarse cells, same resolution as EulerFluidSystem where refined
+			adaptiveSys->Reset(Vec2{ 0,0 }, Vec2Int{ 100,100 }, Vec2{ cellSize, cellSize });
+		}
+
+		if (HybridFluidSystem* hybridSys = dynamic_cast<HybridFluidSystem*>(system))
+		{
+			hybridSys->Reset(Vec2{ 0,0 }, Vec2Int{ 200,200 }, Vec2{ cellSize, cellSize });
+		}
+
 		if (SPHMullerFluidSystem* eulerSys = dynamic_cast<SPHMullerFluidSystem*>(system))
 		{
 			// TODO: Init
@@ -72,10 +99,82 @@ private:
 			fluidSystem->RemoveFluidAt(mousePos, mouseRadius);
 		}
 
+		if (EulerFluidSystem* eulerSys = dynamic_cast<EulerFluidSystem*>(fluidSystem.get()))
+		{
+			gVars->pRenderer->DisplayText("F6: next pressure solver");
+			if (gVars->pRenderWindow->JustPressedKey(Key::F6))
+			{
+				int nextSolver = (int(eulerSys->pressureSolver) + 1) % int(PressureSolverType::Count);
+				eulerSys->pressureSolver = PressureSolverType(nextSolver);
+			}
+
+			gVars->pRenderer->DisplayText(std::string("F7: pressure warm start ") + (eulerSys->warmStartPressure ? "on" : "off"));
+			if (gVars->pRenderWindow->JustPressedKey(Key::F7))
+			{
+				eulerSys->warmStartPressure = !eulerSys->warmStartPressure;
+			}
+
+			gVars->pRenderer->DisplayText(std::string("F8: advection ") + GetAdvectionSchemeName(eulerSys->advectionScheme));
+			if (gVars->pRenderWindow->JustPressedKey(Key::F8))
+			{
+				int nextScheme = (int(eulerSys->advectionScheme) + 1) % int(AdvectionScheme::Count);
+				eulerSys->advectionScheme = AdvectionScheme(nextScheme);
+			}
+
+			eulerSys->UpdateObstacles(gVars->pWorld->GetPolygons());
+		}
+
+		if (HybridFluidSystem* hybridSys = dynamic_cast<HybridFluidSystem*>(fluidSystem.get()))
+		{
+			gVars->pRenderer->DisplayText(std::string("F7: transfer ") + GetHybridTransferName(hybridSys->transferType));
+			if (gVars->pRenderWindow->JustPressedKey(Key::F7))
+			{
+				int nextTransfer = (int(hybridSys->transferType) + 1) % int(HybridTransferType::Count);
+				hybridSys->transferType = HybridTransferType(nextTransfer);
+			}
+		}
+
+		gVars->pRenderer->DisplayText(std::string("F9: probe ") + (displayProbe ? "on" : "off"));
+		if (gVars->pRenderWindow->JustPressedKey(Key::F9))
+		{
+			displayProbe = !displayProbe;
+		}
+
 		m_clicking = clicking;
 
 		fluidSystem->Update(frameTime);
 		//CFluidSystem::Get().Update(frameTime);
+
+		if (displayProbe)
+		{
+			DisplayProbe(mousePos);
+		}
+	}
+
+	// Velocities on a grid of points around the mouse, density and pressure under it
+	void DisplayProbe(Vec2 mousePos)
+	{
+		probePoints.clear();
+		for (int y = -probeRadius; y <= probeRadius; y++)
+		{
+			for (int x = -probeRadius; x <= probeRadius; x++)
+			{
+				probePoints.push_back(mousePos + Vec2(float(x), float(y)) * cellSize);
+			}
+		}
+
+		fluidSystem->Probe(probePoints, probeResults);
+
+		for (size_t i = 0; i < probePoints.size(); i++)
+		{
+			Vec2 velocity = Vec2(probeResults.velocitiesX[i], probeResults.velocitiesY[i]);
+			gVars->pRenderer->DrawLine(probePoints[i], probePoints[i] + velocity * probeVelocityScale, 0.f, 1.f, 1.f);
+		}
+
+		// the mouse is the center of the grid
+		const size_t center = probePoints.size() / 2;
+		gVars->pRenderer->DisplayTextWorld("density " + std::to_string(probeResults.densities[center])
+			+ ", pressure " + std::to_string(probeResults.pressures[center]), mousePos);
 	}
 
 	bool m_clicking = false;
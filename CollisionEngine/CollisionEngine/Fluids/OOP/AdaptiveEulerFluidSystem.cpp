@@ -0,0 +1,811 @@
+#include "AdaptiveEulerFluidSystem.hpp"
+
+#include "Fluids/OOP/GridSampling.hpp"
+#include "GlobalVariables.h"
+#include "Parallel.h"
+#include "Renderer.h"
+#include "Timer.h"
+
+#include <string>
+
+namespace
+{
+	constexpr size_t leavesPerJob = 1024;
+
+	using LeafFaces = AdaptiveEulerFluidSystem::LeafFaces;
+
+	// Sets the faces of a leaf side : slot 0 or 1 for one of the two faces of a coarse leaf side, -1 for a face covering the whole side
+	inline void SetSideFace(int (&side)[2], int slot, int face)
+	{
+		if (slot < 0)
+		{
+			side[0] = side[1] = face;
+		}
+		else
+		{
+			side[slot] = face;
+		}
+	}
+}
+
+template<typename TFunctor>
+void AdaptiveEulerFluidSystem::ForEachLeafFace(int leaf, TFunctor&& functor) const
+{
+	const LeafFaces& faces = topology.leafFaces[leaf];
+	auto visitSide = [&](const int (&side)[2])
+	{
+		if (side[0] >= 0)
+			functor(side[0]);
+		if (side[1] >= 0 && side[1] != side[0])
+			functor(side[1]);
+	};
+
+	visitSide(faces.left);
+	visitSide(faces.right);
+	visitSide(faces.down);
+	visitSide(faces.up);
+}
+
+void AdaptiveEulerFluidSystem::Reset(Vec newWorldPosition, VecInt newCoarseCellsCount, Vec newFineCellSize)
+{
+	worldPosition = newWorldPosition;
+	coarseCellsCount = newCoarseCellsCount;
+	fineCellsCount = VecInt{ 2 * newCoarseCellsCount.x, 2 * newCoarseCellsCount.y };
+	fineCellSize = newFineCellSize;
+
+	// every cell starts coarse, the first UpdateRefinement refines the interfaces
+	BuildTopology(std::vector<uint8_t>(coarseCellsCount.Product(), 0), topology);
+
+	const size_t leavesCount = topology.leafSizes.size();
+	materials.assign(leavesCount, 0);
+	fractions.assign(leavesCount, 1.f);
+	pressures.assign(leavesCount, 0.f);
+	faceVelocities.assign(topology.faceAxes.size(), 0.f);
+
+	// the coarse grid correction is one V-cycle on the Galerkin operator, whose coefficients are already in the edge weights
+	coarseSolver.Resize(coarseCellsCount, Vec::One());
+	coarseSolver.SetEdgeWeights(topology.coarseRightWeights, topology.coarseUpWeights);
+	coarseSolver.tolerance = 0.f;
+	coarseSolver.maxIterations = 1;
+	coarseRhs.assign(coarseCellsCount.Product(), 0.f);
+	coarseSolution.assign(coarseCellsCount.Product(), 0.f);
+
+	m_mesh.pointSize = newFineCellSize.x * 50;
+}
+
+void AdaptiveEulerFluidSystem::BuildTopology(const std::vector<uint8_t>& refinedCells, Topology& outTopology) const
+{
+	Topology& out = outTopology;
+	out.refinedCells = refinedCells;
+	out.coarseFirstLeaves.resize(coarseCellsCount.Product());
+
+	out.leafOrigins.clear();
+	out.leafSizes.clear();
+	for (int y = 0; y < coarseCellsCount.y; y++)
+	{
+		for (int x = 0; x < coarseCellsCount.x; x++)
+		{
+			int coarseIndex = x + y * coarseCellsCount.x;
+			out.coarseFirstLeaves[coarseIndex] = int(out.leafSizes.size());
+
+			if (refinedCells[coarseIndex])
+			{
+				for (int subY = 0; subY < 2; subY++)
+				{
+					for (int subX = 0; subX < 2; subX++)
+					{
+						out.leafOrigins.push_back(VecInt{ 2 * x + subX, 2 * y + subY });
+						out.leafSizes.push_back(1);
+					}
+				}
+			}
+			else
+			{
+				out.leafOrigins.push_back(VecInt{ 2 * x, 2 * y });
+				out.leafSizes.push_back(2);
+			}
+		}
+	}
+
+	out.leafFaces.assign(out.leafSizes.size(), LeafFaces{ { -1, -1 }, { -1, -1 }, { -1, -1 }, { -1, -1 } });
+
+	out.faceNegativeLeaves.clear();
+	out.facePositiveLeaves.clear();
+	out.faceAxes.clear();
+	out.faceLengths.clear();
+	out.faceCoefficients.clear();
+	out.faceCenters.clear();
+
+	out.coarseRightWeights.assign(Max(0, coarseCellsCount.x - 1) * coarseCellsCount.y, 0.f);
+	out.coarseUpWeights.assign(coarseCellsCount.x * Max(0, coarseCellsCount.y - 1), 0.f);
+
+	auto addFace = [&](int negativeLeaf, int positiveLeaf, uint8_t axis, float length, float distance, Vec center) -> int
+	{
+		int face = int(out.faceAxes.size());
+		out.faceNegativeLeaves.push_back(negativeLeaf);
+		out.facePositiveLeaves.push_back(positiveLeaf);
+		out.faceAxes.push_back(axis);
+		out.faceLengths.push_back(length);
+		out.faceCoefficients.push_back(length / distance);
+		out.faceCenters.push_back(worldPosition + center);
+		return face;
+	};
+
+	// Faces between left and right leaves, walking the vertical lines of the fine grid
+	for (int x = 1; x < fineCellsCount.x; x++)
+	{
+		for (int y = 0; y < fineCellsCount.y; y++)
+		{
+			int left = out.GetLeafOfFineCell(x - 1, y, coarseCellsCount.x);
+			int right = out.GetLeafOfFineCell(x, y, coarseCellsCount.x);
+			if (left == right)
+				continue; // inside a coarse leaf
+
+			uint8_t leftSize = out.leafSizes[left];
+			uint8_t rightSize = out.leafSizes[right];
+			bool bothCoarse = leftSize == 2 && rightSize == 2;
+			if (bothCoarse && (y & 1))
+				continue; // a single face covers both fine rows
+
+			float leftCenter = out.leafOrigins[left].x + 0.5f * leftSize;
+			float rightCenter = out.leafOrigins[right].x + 0.5f * rightSize;
+			float length = (bothCoarse ? 2.f : 1.f) * fineCellSize.y;
+			Vec center = Vec(float(x), bothCoarse ? float(y + 1) : y + 0.5f) * fineCellSize;
+
+			int face = addFace(left, right, 0, length, (rightCenter - leftCenter) * fineCellSize.x, center);
+			SetSideFace(out.leafFaces[left].right, (leftSize == 2 && !bothCoarse) ? y - out.leafOrigins[left].y : -1, face);
+			SetSideFace(out.leafFaces[right].left, (rightSize == 2 && !bothCoarse) ? y - out.leafOrigins[right].y : -1, face);
+
+			if ((x & 1) == 0)
+			{
+				out.coarseRightWeights[(x / 2 - 1) + (y / 2) * (coarseCellsCount.x - 1)] += out.faceCoefficients[face];
+			}
+		}
+	}
+
+	// Faces between down and up leaves, walking the horizontal lines of the fine grid
+	for (int y = 1; y < fineCellsCount.y; y++)
+	{
+		for (int x = 0; x < fineCellsCount.x; x++)
+		{
+			int down = out.GetLeafOfFineCell(x, y - 1, coarseCellsCount.x);
+			int up = out.GetLeafOfFineCell(x, y, coarseCellsCount.x);
+			if (down == up)
+				continue;
+
+			uint8_t downSize = out.leafSizes[down];
+			uint8_t upSize = out.leafSizes[up];
+			bool bothCoarse = downSize == 2 && upSize == 2;
+			if (bothCoarse && (x & 1))
+				continue;
+
+			float downCenter = out.leafOrigins[down].y + 0.5f * downSize;
+			float upCenter = out.leafOrigins[up].y + 0.5f * upSize;
+			float length = (bothCoarse ? 2.f : 1.f) * fineCellSize.x;
+			Vec center = Vec(bothCoarse ? float(x + 1) : x + 0.5f, float(y)) * fineCellSize;
+
+			int face = addFace(down, up, 1, length, (upCenter - downCenter) * fineCellSize.y, center);
+			SetSideFace(out.leafFaces[down].up, (downSize == 2 && !bothCoarse) ? x - out.leafOrigins[down].x : -1, face);
+			SetSideFace(out.leafFaces[up].down, (upSize == 2 && !bothCoarse) ? x - out.leafOrigins[up].x : -1, face);
+
+			if ((y & 1) == 0)
+			{
+				out.coarseUpWeights[(x / 2) + (y / 2 - 1) * coarseCellsCount.x] += out.faceCoefficients[face];
+			}
+		}
+	}
+}
+
+void AdaptiveEulerFluidSystem::ApplyNextTopology()
+{
+	const Topology& next = nextTopology;
+	const size_t leavesCount = next.leafSizes.size();
+	const size_t facesCount = next.faceAxes.size();
+
+	nextMaterials.resize(leavesCount);
+	nextFractions.resize(leavesCount);
+	nextPressures.resize(leavesCount);
+	nextFaceVelocities.resize(facesCount);
+
+	ParallelFor(leavesCount, leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t leaf = begin; leaf < end; leaf++)
+		{
+			const VecInt origin = next.leafOrigins[leaf];
+			int oldLeaf = GetLeafOfFineCell(origin.x, origin.y);
+
+			if (next.leafSizes[leaf] == 1 || topology.leafSizes[oldLeaf] == 2)
+			{
+				// same leaf, or a fine leaf inside a coarse one
+				nextMaterials[leaf] = materials[oldLeaf];
+				nextFractions[leaf] = fractions[oldLeaf];
+				nextPressures[leaf] = pressures[oldLeaf];
+				continue;
+			}
+
+			// merged leaf : average of the 4 old fine leaves, keeping the fluid with the biggest fraction
+			float pressure = 0.f;
+			uint8_t bestMaterial = 0;
+			float bestFraction = 0.f;
+			for (int sub = 0; sub < 4; sub++)
+			{
+				pressure += 0.25f * pressures[oldLeaf + sub];
+
+				uint8_t material = materials[oldLeaf + sub];
+				if (material == 0)
+					continue;
+
+				float fraction = 0.f;
+				for (int other = 0; other < 4; other++)
+				{
+					if (materials[oldLeaf + other] == material)
+					{
+						fraction += 0.25f * fractions[oldLeaf + other];
+					}
+				}
+
+				if (fraction > bestFraction)
+				{
+					bestFraction = fraction;
+					bestMaterial = material;
+				}
+			}
+
+			nextPressures[leaf] = pressure;
+			if (bestMaterial != 0 && bestFraction > minFluidFraction)
+			{
+				nextMaterials[leaf] = bestMaterial;
+				nextFractions[leaf] = bestFraction;
+			}
+			else
+			{
+				nextMaterials[leaf] = 0;
+				nextFractions[leaf] = 1.f;
+			}
+		}
+	});
+
+	// new faces velocities are interpolated from the current faces
+	ParallelFor(facesCount, leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			nextFaceVelocities[face] = next.faceAxes[face] == 0 ? SampleHorizontalVelocity(next.faceCenters[face]) : SampleVerticalVelocity(next.faceCenters[face]);
+		}
+	});
+
+	std::swap(topology, nextTopology);
+	materials.swap(nextMaterials);
+	fractions.swap(nextFractions);
+	pressures.swap(nextPressures);
+	faceVelocities.swap(nextFaceVelocities);
+
+	coarseSolver.SetEdgeWeights(topology.coarseRightWeights, topology.coarseUpWeights);
+}
+
+void AdaptiveEulerFluidSystem::UpdateRefinement()
+{
+	const int coarseCount = coarseCellsCount.Product();
+	interfaceCells.resize(coarseCount);
+	wantedRefinement.resize(coarseCount);
+
+	auto getShownMaterial = [this](int leaf)
+	{
+		return fractions[leaf] >= 0.5f ? materials[leaf] : uint8_t(0);
+	};
+
+	// a coarse cell holds an interface when one of its leaves is partially filled or touches a leaf showing another fluid
+	ParallelFor(coarseCount, 64, [&](size_t begin, size_t end)
+	{
+		for (size_t coarseIndex = begin; coarseIndex < end; coarseIndex++)
+		{
+			int firstLeaf = topology.coarseFirstLeaves[coarseIndex];
+			int lastLeaf = firstLeaf + (topology.refinedCells[coarseIndex] ? 4 : 1);
+
+			bool isInterface = false;
+			for (int leaf = firstLeaf; leaf < lastLeaf && !isInterface; leaf++)
+			{
+				isInterface = materials[leaf] != 0 && fractions[leaf] < 0.99f;
+
+				uint8_t shownMaterial = getShownMaterial(leaf);
+				ForEachLeafFace(leaf, [&](int face)
+				{
+					int other = topology.faceNegativeLeaves[face] == leaf ? topology.facePositiveLeaves[face] : topology.faceNegativeLeaves[face];
+					isInterface |= getShownMaterial(other) != shownMaterial;
+				});
+			}
+			interfaceCells[coarseIndex] = isInterface ? 1 : 0;
+		}
+	});
+
+	ParallelFor(coarseCellsCount.y, 1, [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			for (int x = 0; x < coarseCellsCount.x; x++)
+			{
+				uint8_t refined = 0;
+				for (int neighborY = Max(0, y - refinementMargin); neighborY <= Min(coarseCellsCount.y - 1, y + refinementMargin) && !refined; neighborY++)
+				{
+					for (int neighborX = Max(0, x - refinementMargin); neighborX <= Min(coarseCellsCount.x - 1, x + refinementMargin) && !refined; neighborX++)
+					{
+						refined = interfaceCells[neighborX + neighborY * coarseCellsCount.x];
+					}
+				}
+				wantedRefinement[x + y * coarseCellsCount.x] = refined;
+			}
+		}
+	});
+
+	if (wantedRefinement != topology.refinedCells)
+	{
+		BuildTopology(wantedRefinement, nextTopology);
+		ApplyNextTopology();
+	}
+}
+
+void AdaptiveEulerFluidSystem::AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius)
+{
+	Vec relativePos = fluidWorldPosition - worldPosition;
+
+	VecInt indices = (relativePos / fineCellSize).Floor();
+	Vec2Int offset = (radius / fineCellSize).Floor();
+	uint8_t material = fluids.GetMaterial(fluid);
+
+	// painted on the fine cells, a coarse leaf gets the fluid as soon as one of its fine cells does
+	for (int y = Max(0, indices.y - offset.y); y < Min(fineCellsCount.y, indices.y + offset.y); y++)
+	{
+		for (int x = Max(0, indices.x - offset.x); x < Min(fineCellsCount.x, indices.x + offset.x); x++)
+		{
+			int leaf = GetLeafOfFineCell(x, y);
+			materials[leaf] = material;
+			fractions[leaf] = 1.f;
+		}
+	}
+}
+
+void AdaptiveEulerFluidSystem::RemoveFluidAt(Vec2 fluidWorldPosition, float radius)
+{
+	AddFluidAt(defaultFluid, fluidWorldPosition, Vec::Zero(), radius);
+}
+
+void AdaptiveEulerFluidSystem::ApplyForces(float deltaTime)
+{
+	// same forces as EulerFluidSystem
+	const Vec acceleration = Vec{ 3, -9.8 } *0.01;
+	ParallelFor(faceVelocities.size(), leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			faceVelocities[face] = topology.faceAxes[face] == 0 ? acceleration.x : acceleration.y;
+		}
+	});
+}
+
+void AdaptiveEulerFluidSystem::ApplyOperator(const std::vector<float>& values, std::vector<float>& out) const
+{
+	out.resize(values.size());
+	ParallelFor(values.size(), leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (int leaf = int(begin); leaf < int(end); leaf++)
+		{
+			float sum = 0.f;
+			ForEachLeafFace(leaf, [&](int face)
+			{
+				int other = topology.faceNegativeLeaves[face] == leaf ? topology.facePositiveLeaves[face] : topology.faceNegativeLeaves[face];
+				sum += topology.faceCoefficients[face] * (values[leaf] - values[other]);
+			});
+			out[leaf] = sum;
+		}
+	});
+}
+
+void AdaptiveEulerFluidSystem::Precondition(const std::vector<float>& residual, std::vector<float>& out)
+{
+	// Symmetric two-level preconditioner : Jacobi, correction on the coarse cells (piecewise constant over their leaves), Jacobi
+	const size_t size = residual.size();
+	out.resize(size);
+	smootherResiduals.resize(size);
+
+	auto jacobi = [&](const std::vector<float>& currentResidual, bool accumulate)
+	{
+		ParallelFor(size, leavesPerJob, [&](size_t begin, size_t end)
+		{
+			for (size_t leaf = begin; leaf < end; leaf++)
+			{
+				float correction = diagonals[leaf] > 0.f ? jacobiWeight * currentResidual[leaf] / diagonals[leaf] : 0.f;
+				out[leaf] = accumulate ? out[leaf] + correction : correction;
+			}
+		});
+	};
+
+	auto updateSmootherResiduals = [&]()
+	{
+		ApplyOperator(out, smootherResiduals);
+		for (size_t leaf = 0; leaf < size; leaf++)
+		{
+			smootherResiduals[leaf] = residual[leaf] - smootherResiduals[leaf];
+		}
+	};
+
+	jacobi(residual, false);
+
+	updateSmootherResiduals();
+	std::fill(coarseRhs.begin(), coarseRhs.end(), 0.f);
+	for (size_t leaf = 0; leaf < size; leaf++)
+	{
+		const VecInt origin = topology.leafOrigins[leaf];
+		coarseRhs[(origin.x / 2) + (origin.y / 2) * coarseCellsCount.x] += smootherResiduals[leaf];
+	}
+
+	std::fill(coarseSolution.begin(), coarseSolution.end(), 0.f);
+	coarseSolver.Solve(PressureSolverType::Multigrid, coarseRhs, coarseSolution);
+
+	ParallelFor(size, leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t leaf = begin; leaf < end; leaf++)
+		{
+			const VecInt origin = topology.leafOrigins[leaf];
+			out[leaf] += coarseSolution[(origin.x / 2) + (origin.y / 2) * coarseCellsCount.x];
+		}
+	});
+
+	updateSmootherResiduals();
+	jacobi(smootherResiduals, true);
+}
+
+void AdaptiveEulerFluidSystem::Projection(float deltaTime)
+{
+	CTimer timer;
+	timer.Start();
+
+	const size_t size = topology.leafSizes.size();
+	diagonals.resize(size);
+	rhs.resize(size);
+	residuals.resize(size);
+	directions.resize(size);
+
+	// A * pressure = -(flux out of each leaf), A being symmetric since each face adds the same coefficient to both of its leaves
+	ParallelFor(size, leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (int leaf = int(begin); leaf < int(end); leaf++)
+		{
+			float diagonal = 0.f;
+			float outFlux = 0.f;
+			ForEachLeafFace(leaf, [&](int face)
+			{
+				diagonal += topology.faceCoefficients[face];
+				float flux = faceVelocities[face] * topology.faceLengths[face];
+				outFlux += topology.faceNegativeLeaves[face] == leaf ? flux : -flux;
+			});
+			diagonals[leaf] = diagonal;
+			rhs[leaf] = -outFlux;
+		}
+	});
+
+	// walls everywhere : pressure is defined up to a constant, the right hand side must sum to 0
+	auto removeMean = [size](std::vector<float>& values)
+	{
+		double sum = 0.0;
+		for (float value : values)
+			sum += value;
+		float mean = float(sum / Max(size_t(1), size));
+		for (float& value : values)
+			value -= mean;
+	};
+	removeMean(rhs);
+
+	// Preconditioned conjugate gradient, same steps as PoissonSolver::SolveMultigridPCG
+	PressureSolveStats stats;
+	double rhsNorm = sqrt(PoissonSolver::Dot(rhs, rhs));
+	if (rhsNorm == 0.0)
+	{
+		std::fill(pressures.begin(), pressures.end(), 0.f);
+		stats.converged = true;
+	}
+	else
+	{
+		ApplyOperator(pressures, products);
+		for (size_t i = 0; i < size; i++)
+		{
+			residuals[i] = rhs[i] - products[i];
+		}
+
+		stats.initialResidual = stats.finalResidual = float(sqrt(PoissonSolver::Dot(residuals, residuals)) / rhsNorm);
+		if (stats.initialResidual > 1.f)
+		{
+			// the guess is worse than zero
+			std::fill(pressures.begin(), pressures.end(), 0.f);
+			residuals = rhs;
+			stats.initialResidual = stats.finalResidual = 1.f;
+		}
+		stats.converged = stats.finalResidual <= tolerance;
+
+		double residualDotPreconditioned = 0.0;
+		while (!stats.converged && stats.iterations < maxIterations)
+		{
+			Precondition(residuals, preconditioned);
+			removeMean(preconditioned);
+
+			double newResidualDotPreconditioned = PoissonSolver::Dot(residuals, preconditioned);
+			if (stats.iterations == 0)
+			{
+				directions = preconditioned;
+			}
+			else
+			{
+				float beta = float(newResidualDotPreconditioned / residualDotPreconditioned);
+				for (size_t i = 0; i < size; i++)
+				{
+					directions[i] = preconditioned[i] + beta * directions[i];
+				}
+			}
+			residualDotPreconditioned = newResidualDotPreconditioned;
+
+			ApplyOperator(directions, products);
+			double directionDotProduct = PoissonSolver::Dot(directions, products);
+			if (directionDotProduct <= 0.0)
+			{
+				break;
+			}
+
+			float alpha = float(residualDotPreconditioned / directionDotProduct);
+			for (size_t i = 0; i < size; i++)
+			{
+				pressures[i] += alpha * directions[i];
+				residuals[i] -= alpha * products[i];
+			}
+
+			stats.iterations++;
+			stats.finalResidual = float(sqrt(PoissonSolver::Dot(residuals, residuals)) / rhsNorm);
+			stats.converged = stats.finalResidual <= tolerance;
+		}
+	}
+
+	// velocity -= gradient(pressure) across each face
+	ParallelFor(faceVelocities.size(), leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			float difference = pressures[topology.facePositiveLeaves[face]] - pressures[topology.faceNegativeLeaves[face]];
+			faceVelocities[face] -= difference * topology.faceCoefficients[face] / topology.faceLengths[face];
+		}
+	});
+
+	timer.Stop();
+	stats.duration = timer.GetDuration() * 1000.f;
+	lastSolveStats = stats;
+	lastDeltaTime = deltaTime;
+}
+
+AdaptiveEulerFluidSystem::Vec AdaptiveEulerFluidSystem::Backtrace(Vec worldPos, float deltaTime) const
+{
+	// midpoint (RK2) integration, backward in time
+	Vec midPos = worldPos - SampleVelocity(worldPos) * (deltaTime * 0.5f);
+	return worldPos - SampleVelocity(midPos) * deltaTime;
+}
+
+void AdaptiveEulerFluidSystem::Advection(float deltaTime)
+{
+	// Same semi-Lagrangian advection as EulerFluidSystem, on the leaves centers and the faces centers
+	const size_t leavesCount = topology.leafSizes.size();
+	nextMaterials.resize(leavesCount);
+	nextFractions.resize(leavesCount);
+	nextFaceVelocities.resize(faceVelocities.size());
+
+	ParallelFor(leavesCount, leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t leaf = begin; leaf < end; leaf++)
+		{
+			Vec center = Vec2(topology.leafOrigins[leaf]) + Vec::One() * (0.5f * topology.leafSizes[leaf]);
+			Vec sourcePos = Backtrace(worldPosition + center * fineCellSize, deltaTime);
+			BilinearStencil stencil((sourcePos - worldPosition) / fineCellSize - Vec(0.5f, 0.5f), fineCellsCount);
+
+			// interpolated material fraction of each corner fluid, the leaf keeps the fluid with the biggest one
+			const int corners[4] = { GetLeafOfFineCell(stencil.x0, stencil.y0), GetLeafOfFineCell(stencil.x1, stencil.y0),
+									GetLeafOfFineCell(stencil.x0, stencil.y1), GetLeafOfFineCell(stencil.x1, stencil.y1) };
+			const float weights[4] = { (1.f - stencil.tx) * (1.f - stencil.ty), stencil.tx * (1.f - stencil.ty),
+									(1.f - stencil.tx) * stencil.ty, stencil.tx * stencil.ty };
+
+			uint8_t bestMaterial = 0;
+			float bestFraction = 0.f;
+			for (int corner = 0; corner < 4; corner++)
+			{
+				uint8_t material = materials[corners[corner]];
+				if (material == 0)
+					continue;
+
+				float fraction = 0.f;
+				for (int other = 0; other < 4; other++)
+				{
+					if (materials[corners[other]] == material)
+					{
+						fraction += weights[other] * fractions[corners[other]];
+					}
+				}
+
+				if (fraction > bestFraction)
+				{
+					bestFraction = fraction;
+					bestMaterial = material;
+				}
+			}
+
+			if (bestMaterial != 0 && bestFraction > minFluidFraction)
+			{
+				nextMaterials[leaf] = bestMaterial;
+				nextFractions[leaf] = Min(bestFraction, 1.f);
+			}
+			else
+			{
+				nextMaterials[leaf] = 0;
+				nextFractions[leaf] = 1.f;
+			}
+		}
+	});
+
+	ParallelFor(faceVelocities.size(), leavesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			Vec sourcePos = Backtrace(topology.faceCenters[face], deltaTime);
+			nextFaceVelocities[face] = topology.faceAxes[face] == 0 ? SampleHorizontalVelocity(sourcePos) : SampleVerticalVelocity(sourcePos);
+		}
+	});
+
+	materials.swap(nextMaterials);
+	fractions.swap(nextFractions);
+	faceVelocities.swap(nextFaceVelocities);
+}
+
+void AdaptiveEulerFluidSystem::Update(float deltaTime)
+{
+	UpdateRefinement();
+
+	ApplyForces(deltaTime);
+
+	Projection(deltaTime);
+
+	gVars->pRenderer->DisplayText("Adaptive Euler : " + std::to_string(GetLeavesCount()) + " cells instead of " + std::to_string(fineCellsCount.Product())
+		+ ", PCG iterations : " + std::to_string(lastSolveStats.iterations)
+		+ ", residual : " + std::to_string(lastSolveStats.initialResidual) + " -> " + std::to_string(lastSolveStats.finalResidual)
+		+ (lastSolveStats.converged ? "" : " (not converged)")
+		+ ", " + std::to_string(lastSolveStats.duration) + " ms");
+
+	Advection(deltaTime);
+
+	Draw();
+}
+
+float AdaptiveEulerFluidSystem::GetHorizontalVelocity(int x, int y) const
+{
+	if (x <= 0 || x >= fineCellsCount.x)
+		return 0.f;
+
+	int leaf = GetLeafOfFineCell(x, y);
+	const VecInt origin = topology.leafOrigins[leaf];
+	const LeafFaces& faces = topology.leafFaces[leaf];
+	if (topology.leafSizes[leaf] == 1)
+	{
+		return faceVelocities[faces.left[0]];
+	}
+
+	int slot = y - origin.y;
+	float left = faces.left[slot] >= 0 ? faceVelocities[faces.left[slot]] : 0.f;
+	if (x == origin.x)
+	{
+		return left;
+	}
+
+	// middle of a coarse leaf, between its left and right faces
+	float right = faces.right[slot] >= 0 ? faceVelocities[faces.right[slot]] : 0.f;
+	return 0.5f * (left + right);
+}
+
+float AdaptiveEulerFluidSystem::GetVerticalVelocity(int x, int y) const
+{
+	if (y <= 0 || y >= fineCellsCount.y)
+		return 0.f;
+
+	int leaf = GetLeafOfFineCell(x, y);
+	const VecInt origin = topology.leafOrigins[leaf];
+	const LeafFaces& faces = topology.leafFaces[leaf];
+	if (topology.leafSizes[leaf] == 1)
+	{
+		return faceVelocities[faces.down[0]];
+	}
+
+	int slot = x - origin.x;
+	float down = faces.down[slot] >= 0 ? faceVelocities[faces.down[slot]] : 0.f;
+	if (y == origin.y)
+	{
+		return down;
+	}
+
+	float up = faces.up[slot] >= 0 ? faceVelocities[faces.up[slot]] : 0.f;
+	return 0.5f * (down + up);
+}
+
+float AdaptiveEulerFluidSystem::SampleDensity(Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / fineCellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, fineCellsCount, [this](int x, int y)
+	{
+		int leaf = GetLeafOfFineCell(x, y);
+		return fluids[materials[leaf]]->volumicMass * fractions[leaf] + fluids[0]->volumicMass * (1.f - fractions[leaf]);
+	});
+}
+
+float AdaptiveEulerFluidSystem::SamplePressure(Vec worldPos) const
+{
+	float density = 1.f;
+	Vec coords = (worldPos - worldPosition) / fineCellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, fineCellsCount, [this](int x, int y)
+	{
+		return pressures[GetLeafOfFineCell(x, y)];
+	}) * density / lastDeltaTime;
+}
+
+float AdaptiveEulerFluidSystem::SampleHorizontalVelocity(Vec worldPos) const
+{
+	// horizontal velocities are at the middle of the fine cells left edges
+	Vec coords = (worldPos - worldPosition) / fineCellSize - Vec(0.f, 0.5f);
+	return SampleBilinear(coords, VecInt{ fineCellsCount.x + 1, fineCellsCount.y }, [this](int x, int y)
+	{
+		return GetHorizontalVelocity(x, y);
+	});
+}
+
+float AdaptiveEulerFluidSystem::SampleVerticalVelocity(Vec worldPos) const
+{
+	// vertical velocities are at the middle of the fine cells bottom edges
+	Vec coords = (worldPos - worldPosition) / fineCellSize - Vec(0.5f, 0.f);
+	return SampleBilinear(coords, VecInt{ fineCellsCount.x, fineCellsCount.y + 1 }, [this](int x, int y)
+	{
+		return GetVerticalVelocity(x, y);
+	});
+}
+
+AdaptiveEulerFluidSystem::Vec AdaptiveEulerFluidSystem::SampleVelocity(Vec worldPos) const
+{
+	return Vec(SampleHorizontalVelocity(worldPos), SampleVerticalVelocity(worldPos));
+}
+
+void AdaptiveEulerFluidSystem::Probe(const std::vector<Vec2>& points, FluidProbeResults& results)
+{
+	results.Resize(points.size());
+
+	ParallelFor(points.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Vec velocity = SampleVelocity(points[i]);
+			results.densities[i] = SampleDensity(points[i]);
+			results.pressures[i] = SamplePressure(points[i]);
+			results.velocitiesX[i] = velocity.x;
+			results.velocitiesY[i] = velocity.y;
+		}
+	});
+}
+
+void AdaptiveEulerFluidSystem::Draw()
+{
+	// drawn at the fine resolution, coarse leaves cover 2x2 points
+	m_mesh.Fill(fineCellsCount.Product(), [&](size_t iVertex, float& x, float& y, float& r, float& g, float& b)
+	{
+		int cellX = int(iVertex % fineCellsCount.x);
+		int cellY = int(iVertex / fineCellsCount.x);
+
+		Vec2 pos = worldPosition + Vec2(float(cellX), float(cellY)) * fineCellSize;
+		x = pos.x;
+		y = pos.y;
+
+		int leaf = GetLeafOfFineCell(cellX, cellY);
+		const Fluid& fluid = *fluids[fractions[leaf] >= 0.5f ? materials[leaf] : 0];
+		r = fluid.color.x;
+		g = fluid.color.y;
+		b = fluid.color.z;
+	});
+
+	m_mesh.Draw();
+}
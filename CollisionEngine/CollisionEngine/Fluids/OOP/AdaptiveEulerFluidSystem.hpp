@@ -0,0 +1,179 @@
+#ifndef _OOP_ADAPTIVE_EULER_FLUID_SYSTEM_HPP_
+#define _OOP_ADAPTIVE_EULER_FLUID_SYSTEM_HPP_
+
+#include "Maths.h"
+#include "Fluids/OOP/FluidSystem.hpp"
+#include "Fluids/OOP/Fluid.hpp"
+#include "Fluids/OOP/FluidsTable.hpp"
+#include "Fluids/OOP/PoissonSolver.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FluidMesh.h"
+
+// Two-level adaptive version of EulerFluidSystem : the domain is a grid of coarse cells, each one being either a leaf or split in 2x2 fine cells.
+// Coarse cells are refined around fluid interfaces and merged back in uniform regions.
+// Leaves are linked by faces holding the normal velocity. A coarse leaf facing a refined cell has two faces on that side (T-junction),
+// and the pressure solve is a finite volume discretization over those faces, so that the flux through each face is the same for both leaves.
+class AdaptiveEulerFluidSystem : public IFluidSystem
+{
+	using Vec = Vec2;
+	using VecInt = Vec2Int;
+
+public:
+	// Faces on each side of a leaf, bottom / left one first. Both entries are the same face when there is a single face, -1 on walls.
+	struct LeafFaces
+	{
+		int left[2];
+		int right[2];
+		int down[2];
+		int up[2];
+	};
+
+	struct Topology
+	{
+		std::vector<uint8_t> refinedCells; // per coarse cell
+		std::vector<int> coarseFirstLeaves; // per coarse cell, the 4 leaves of a refined cell are consecutive
+
+		// Leaves, coords in fine cells
+		std::vector<VecInt> leafOrigins; // bottom left fine cell
+		std::vector<uint8_t> leafSizes; // 1 : fine, 2 : coarse
+		std::vector<LeafFaces> leafFaces;
+
+		// Faces, velocity goes from the negative to the positive leaf
+		std::vector<int> faceNegativeLeaves;
+		std::vector<int> facePositiveLeaves;
+		std::vector<uint8_t> faceAxes; // 0 : between left and right leaves, 1 : between down and up leaves
+		std::vector<float> faceLengths;
+		std::vector<float> faceCoefficients; // length / distance between the leaves centers
+		std::vector<Vec> faceCenters; // world pos
+
+		// Galerkin coarse grid operator (sum of the faces coefficients between coarse cells), see PoissonSolver::SetEdgeWeights
+		std::vector<float> coarseRightWeights;
+		std::vector<float> coarseUpWeights;
+
+		int GetLeafOfFineCell(int x, int y, int coarseCountX) const
+		{
+			int coarseIndex = (x / 2) + (y / 2) * coarseCountX;
+			int firstLeaf = coarseFirstLeaves[coarseIndex];
+			return refinedCells[coarseIndex] ? firstLeaf + (x & 1) + 2 * (y & 1) : firstLeaf;
+		}
+	};
+
+	Vec worldPosition; // world pos of bottom left corner
+	VecInt coarseCellsCount;
+	VecInt fineCellsCount; // 2 * coarseCellsCount
+	Vec fineCellSize = Vec::One(); // coarse cells are twice bigger
+
+	std::shared_ptr<Fluid> defaultFluid = std::make_shared<Fluid>(GetAir());
+
+	// Fluids indexed by the materials array, material 0 is defaultFluid
+	FluidsTable fluids = FluidsTable(defaultFluid);
+
+	int refinementMargin = 1; // coarse cells refined around each coarse cell holding an interface
+	float minFluidFraction = 0.01f; // below, advected leaves are reset to defaultFluid
+
+	// Conjugate gradient preconditioned by Jacobi smoothing around a multigrid coarse grid correction, warm started from last frame pressure
+	float tolerance = 1e-4f; // on the relative residual |b - Ax| / |b|
+	int maxIterations = 100;
+	float jacobiWeight = 0.6f;
+	PressureSolveStats lastSolveStats;
+
+	Topology topology;
+
+	// Leaves fields
+	std::vector<uint8_t> materials; // index in fluids
+	std::vector<float> fractions; // part of the leaf filled by its material, the rest being defaultFluid
+	std::vector<float> pressures; // pressure * deltaTime / density
+
+	// Faces field
+	std::vector<float> faceVelocities;
+
+	void Reset(Vec newWorldPosition, VecInt newCoarseCellsCount, Vec newFineCellSize);
+
+	virtual void AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius) override;
+	virtual void RemoveFluidAt(Vec2 fluidWorldPosition, float radius) override;
+
+	virtual void Update(float deltaTime) override;
+
+	// Refines the coarse cells around interfaces, merges the others
+	void UpdateRefinement();
+	void ApplyForces(float deltaTime);
+	void Projection(float deltaTime);
+	void Advection(float deltaTime);
+
+	virtual void Probe(const std::vector<Vec2>& points, FluidProbeResults& results) override;
+
+	// Bilinear interpolation of the leaves fields, coarse leaves being seen as 2x2 fine cells
+	float SampleDensity(Vec worldPos) const;
+	float SamplePressure(Vec worldPos) const;
+
+	// Bilinear interpolation of the faces velocities on the fine grid edges, velocity being linear inside coarse leaves
+	Vec SampleVelocity(Vec worldPos) const;
+	float SampleHorizontalVelocity(Vec worldPos) const;
+	float SampleVerticalVelocity(Vec worldPos) const;
+
+	// Velocity on the left edge of fine cell (x, y), x in [0, fineCellsCount.x], 0 on walls
+	float GetHorizontalVelocity(int x, int y) const;
+	// Velocity on the bottom edge of fine cell (x, y), y in [0, fineCellsCount.y], 0 on walls
+	float GetVerticalVelocity(int x, int y) const;
+
+	int GetLeafOfFineCell(int x, int y) const
+	{
+		return topology.GetLeafOfFineCell(x, y, coarseCellsCount.x);
+	}
+
+	size_t GetLeavesCount() const
+	{
+		return topology.leafSizes.size();
+	}
+
+	void Draw();
+
+private:
+	Topology nextTopology;
+
+	// Advection and refinement destination buffers
+	std::vector<uint8_t> nextMaterials;
+	std::vector<float> nextFractions;
+	std::vector<float> nextPressures;
+	std::vector<float> nextFaceVelocities;
+
+	std::vector<uint8_t> wantedRefinement;
+	std::vector<uint8_t> interfaceCells;
+
+	// Pressure solve buffers, per leaf
+	std::vector<float> diagonals;
+	std::vector<float> rhs;
+	std::vector<float> residuals;
+	std::vector<float> preconditioned;
+	std::vector<float> directions;
+	std::vector<float> products;
+	std::vector<float> smootherResiduals;
+
+	PoissonSolver coarseSolver;
+	std::vector<float> coarseRhs;
+	std::vector<float> coarseSolution;
+
+	float lastDeltaTime = 1.f / 60.f;
+
+	CFluidMesh	m_mesh;
+
+	void BuildTopology(const std::vector<uint8_t>& refinedCells, Topology& outTopology) const;
+	// Switches to nextTopology, fields being resampled from the current one
+	void ApplyNextTopology();
+
+	// World position the fluid at worldPos was at deltaTime ago
+	Vec Backtrace(Vec worldPos, float deltaTime) const;
+
+	// Calls functor(faceIndex) once per face of leaf
+	template<typename TFunctor>
+	void ForEachLeafFace(int leaf, TFunctor&& functor) const;
+
+	// out = A * values, A being sum over the faces of coefficient * (values[leaf] - values[neighbor])
+	void ApplyOperator(const std::vector<float>& values, std::vector<float>& out) const;
+	// out = M^-1 * residual : Jacobi, coarse grid correction, Jacobi
+	void Precondition(const std::vector<float>& residual, std::vector<float>& out);
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "AdvectionBenchmark.hpp"
+
+#include "Timer.h"
+
+#include <cstdio>
+
+namespace
+{
+	constexpr float domainSize = 40.f;
+	constexpr float deltaTime = 1.f / 60.f;
+
+	bool IsInSlottedDisc(Vec2 pos)
+	{
+		const Vec2 center = Vec2(0.5f, 0.75f) * domainSize;
+		const float radius = 0.15f * domainSize;
+		const float slotHalfWidth = 0.025f * domainSize;
+		const float slotTop = center.y + 0.1f * domainSize;
+
+		if ((pos - center).GetSqrLength() > radius * radius)
+			return false;
+
+		return fabsf(pos.x - center.x) > slotHalfWidth || pos.y > slotTop;
+	}
+
+	float GetFluidFraction(const EulerFluidSystem& system, size_t cell)
+	{
+		return system.materials[cell] != 0 ? system.fractions[cell] : 0.f;
+	}
+}
+
+std::string AdvectionBenchmarkResult::ToString() const
+{
+	char text[256];
+	snprintf(text, sizeof(text), "%s %dx%d : %.2f ms per step, shape error %.1f%%, mass change %+.1f%%",
+		GetAdvectionSchemeName(scheme), gridSize, gridSize, stepDuration, shapeError * 100.f, massChange * 100.f);
+	return text;
+}
+
+std::vector<AdvectionBenchmarkResult> RunAdvectionBenchmark(const std::vector<int>& gridSizes, int stepsPerRevolution)
+{
+	std::vector<AdvectionBenchmarkResult> results;
+
+	std::shared_ptr<Fluid> water = std::make_shared<Fluid>(GetWater());
+	const Vec2 rotationCenter = Vec2(0.5f, 0.5f) * domainSize;
+	const float angularVelocity = 2.f * float(M_PI) / (stepsPerRevolution * deltaTime);
+
+	for (int gridSize : gridSizes)
+	{
+		for (int scheme = 0; scheme < int(AdvectionScheme::Count); scheme++)
+		{
+			EulerFluidSystem system;
+			const float cellSize = domainSize / gridSize;
+			system.Reset(Vec2::Zero(), Vec2Int{ gridSize, gridSize }, Vec2(cellSize, cellSize));
+			system.advectionScheme = AdvectionScheme(scheme);
+			uint8_t material = system.fluids.GetMaterial(water);
+
+			for (int y = 0; y < gridSize; y++)
+			{
+				for (int x = 0; x < gridSize; x++)
+				{
+					if (IsInSlottedDisc((Vec2(float(x), float(y)) + Vec2(0.5f, 0.5f)) * cellSize))
+					{
+						system.materials[x + y * gridSize] = material;
+					}
+				}
+			}
+
+			std::vector<float> initialFractions(system.materials.size());
+			double initialAmount = 0.0;
+			for (size_t cell = 0; cell < initialFractions.size(); cell++)
+			{
+				initialFractions[cell] = GetFluidFraction(system, cell);
+				initialAmount += initialFractions[cell];
+			}
+
+			float duration = 0.f;
+			for (int step = 0; step < stepsPerRevolution; step++)
+			{
+				// solid rotation, divergence free on the edges
+				for (int y = 0; y < system.rightEdgesCount.y; y++)
+				{
+					for (int x = 0; x < system.rightEdgesCount.x; x++)
+					{
+						float edgeY = (y + 0.5f) * cellSize;
+						system.horizontalVelocities[x + y * system.rightEdgesCount.x] = -angularVelocity * (edgeY - rotationCenter.y);
+					}
+				}
+				for (int y = 0; y < system.upEdgesCount.y; y++)
+				{
+					for (int x = 0; x < system.upEdgesCount.x; x++)
+					{
+						float edgeX = (x + 0.5f) * cellSize;
+						system.verticalVelocities[x + y * system.upEdgesCount.x] = angularVelocity * (edgeX - rotationCenter.x);
+					}
+				}
+
+				CTimer timer;
+				timer.Start();
+				system.Advection(deltaTime);
+				timer.Stop();
+				duration += timer.GetDuration();
+			}
+
+			double error = 0.0;
+			double amount = 0.0;
+			for (size_t cell = 0; cell < initialFractions.size(); cell++)
+			{
+				float fraction = GetFluidFraction(system, cell);
+				error += fabsf(fraction - initialFractions[cell]);
+				amount += fraction;
+			}
+
+			AdvectionBenchmarkResult result;
+			result.scheme = AdvectionScheme(scheme);
+			result.gridSize = gridSize;
+			result.stepDuration = duration * 1000.f / stepsPerRevolution;
+			result.shapeError = float(error / initialAmount);
+			result.massChange = float((amount - initialAmount) / initialAmount);
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
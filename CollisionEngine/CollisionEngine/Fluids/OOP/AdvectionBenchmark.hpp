@@ -0,0 +1,23 @@
+#ifndef _OOP_ADVECTION_BENCHMARK_HPP_
+#define _OOP_ADVECTION_BENCHMARK_HPP_
+
+#include "Fluids/OOP/EulerFluidSystem.hpp"
+#include <string>
+#include <vector>
+
+struct AdvectionBenchmarkResult
+{
+	AdvectionScheme scheme = AdvectionScheme::SemiLagrangian;
+	int gridSize = 0;
+	float stepDuration = 0.f; // ms per EulerFluidSystem::Advection, using every thread of the job system
+	float shapeError = 0.f; // sum of |fraction - initial fraction| after one revolution, relative to the initial amount of fluid
+	float massChange = 0.f; // relative
+
+	std::string ToString() const;
+};
+
+// Zalesak test : a slotted disc of fluid does one revolution of a solid rotation, the velocities being reset every step.
+// The domain is the same for every grid size, so the error of each scheme can be weighed against its cost.
+std::vector<AdvectionBenchmarkResult> RunAdvectionBenchmark(const std::vector<int>& gridSizes, int stepsPerRevolution = 200);
+
+#endif
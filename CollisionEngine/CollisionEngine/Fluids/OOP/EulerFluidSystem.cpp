@@ -1,151 +1,933 @@
 #include "EulerFluidSystem.hpp"
 
-void EulerFluidSystem::ResetPressure()
+#include "Fluids/OOP/GridSampling.hpp"
+#include "GlobalVariables.h"
+#include "Parallel.h"
+#include "Polygon.h"
+#include "Renderer.h"
+
+#include <string>
+
+namespace
+{
+	// Plane of stored samples inside of a bilinear interpolation grid : stored sample (x, y) is grid sample (x, y) + first,
+	// grid samples missing from the plane are 0 (walls), and grid sample (x, y) is at worldPosition + ((x, y) + offset) * cellSize
+	struct SamplesPlane
+	{
+		Vec2Int storedCount;
+		Vec2Int first;
+		Vec2Int gridCount;
+		Vec2 offset;
+
+		float Get(const std::vector<float>& values, int x, int y) const
+		{
+			x -= first.x;
+			y -= first.y;
+			if (x < 0 || x >= storedCount.x || y < 0 || y >= storedCount.y)
+				return 0.f;
+			return values[x + y * storedCount.x];
+		}
+	};
+
+	// Calls functor(x, y) for the cells of bounds whose center is inside of the convex polygon
+	template<typename TFunctor>
+	void ForEachCellInside(const std::vector<Vec2>& points, Vec2 worldPosition, Vec2 cellSize, const EulerFluidSystem::CellsBounds& bounds, TFunctor&& functor)
+	{
+		for (int y = bounds.min.y; y < bounds.max.y; y++)
+		{
+			// span of the polygon on the row of cells centers
+			const float rowY = worldPosition.y + (y + 0.5f) * cellSize.y;
+			float spanMin = FLT_MAX;
+			float spanMax = -FLT_MAX;
+			for (size_t i = 0; i < points.size(); i++)
+			{
+				const Vec2& a = points[i];
+				const Vec2& b = points[(i + 1) % points.size()];
+				if ((a.y <= rowY) != (b.y <= rowY))
+				{
+					float x = a.x + (rowY - a.y) / (b.y - a.y) * (b.x - a.x);
+					spanMin = Min(spanMin, x);
+					spanMax = Max(spanMax, x);
+				}
+			}
+
+			if (spanMin > spanMax)
+				continue;
+
+			int first = Max(bounds.min.x, int(ceilf((spanMin - worldPosition.x) / cellSize.x - 0.5f)));
+			int last = Min(bounds.max.x - 1, int(floorf((spanMax - worldPosition.x) / cellSize.x - 0.5f)));
+			for (int x = first; x <= last; x++)
+			{
+				functor(x, y);
+			}
+		}
+	}
+}
+
+const char* GetAdvectionSchemeName(AdvectionScheme scheme)
 {
-	for (Cell& cell : cells)
+	switch (scheme)
 	{
-		cell.pressure = 0.f;
+	case AdvectionScheme::SemiLagrangian:
+		return "Semi-Lagrangian";
+	case AdvectionScheme::MacCormack:
+		return "MacCormack";
+	case AdvectionScheme::BFECC:
+		return "BFECC";
+	default:
+		return "Unknown";
 	}
 }
 
+void EulerFluidSystem::ResetPressure()
+{
+	pressures.assign(pressures.size(), 0.f);
+	pressureSolution.assign(pressureSolution.size(), 0.f);
+}
+
 void EulerFluidSystem::ApplyForces(float deltaTime)
 {
 	const Vec acceleration = Vec{3, -9.8} *0.01;
-	for (Vertex& edge : rightEdges)
+	horizontalVelocities.assign(horizontalVelocities.size(), acceleration.x);
+	verticalVelocities.assign(verticalVelocities.size(), acceleration.y);
+}
+
+void EulerFluidSystem::Projection(float deltaTime)
+{
+	ApplySolidBoundaries();
+
+	if (pressureSolver == PressureSolverType::GaussSeidel || pressureSolver == PressureSolverType::RedBlackGaussSeidel)
 	{
-		edge.velocity = acceleration;
+		CTimer timer;
+		timer.Start();
+
+		// same stats as the other solvers, to compare them
+		ComputeDivergences(divergences);
+		double initialNorm = 0.0;
+		for (float divergence : divergences)
+		{
+			initialNorm += Sqr(double(divergence));
+		}
+
+		if (pressureSolver == PressureSolverType::GaussSeidel)
+		{
+			ProjectionGaussSeidel(deltaTime);
+		}
+		else
+		{
+			ProjectionRedBlackGaussSeidel(deltaTime);
+		}
+
+		ComputeDivergences(divergences);
+		double finalNorm = 0.0;
+		for (float divergence : divergences)
+		{
+			finalNorm += Sqr(double(divergence));
+		}
+
+		timer.Stop();
+		lastSolveStats = PressureSolveStats();
+		lastSolveStats.iterations = gaussSeidelIterations;
+		lastSolveStats.initialResidual = initialNorm > 0.0 ? 1.f : 0.f;
+		lastSolveStats.finalResidual = initialNorm > 0.0 ? float(sqrt(finalNorm / initialNorm)) : 0.f;
+		lastSolveStats.converged = lastSolveStats.finalResidual <= poissonSolver.tolerance;
+		lastSolveStats.duration = timer.GetDuration() * 1000.f;
+		return;
 	}
-	for (Vertex& edge : upEdges)
+
+	// A * pressureSolution = -divergence, then velocity -= gradient(pressureSolution) makes the velocity divergence free
+	ComputeDivergences(divergences);
+	for (float& divergence : divergences)
+	{
+		divergence = -divergence;
+	}
+
+	// Warm start : pressure is coherent between frames, so last frame solution is a much better guess than zero
+	if (!warmStartPressure)
+	{
+		pressureSolution.assign(pressureSolution.size(), 0.f);
+	}
+
+	// A cold solve is run from time to time, so that the iterations saved by the warm start are measured
+	if (!warmStartPressure)
+	{
+		coldSolveIterations = -1;
+	}
+	else if (coldSolveIterations < 0 || coldSolveSolver != pressureSolver || ++framesSinceColdSolve >= coldSolvePeriod)
+	{
+		coldSolution.assign(pressureSolution.size(), 0.f);
+		coldSolveIterations = poissonSolver.Solve(pressureSolver, divergences, coldSolution).iterations;
+		coldSolveSolver = pressureSolver;
+		framesSinceColdSolve = 0;
+	}
+
+	lastSolveStats = poissonSolver.Solve(pressureSolver, divergences, pressureSolution);
+
+	ApplyPressureGradient();
+
+	float density = 1.f;
+	for (size_t i = 0; i < pressures.size(); i++)
 	{
-		edge.velocity = acceleration;
+		pressures[i] = pressureSolution[i] * density / deltaTime;
 	}
 }
 
-void EulerFluidSystem::Projection(float deltaTime)
+void EulerFluidSystem::ComputeDivergences(std::vector<float>& outDivergences) const
+{
+	outDivergences.resize(pressures.size());
+
+	for (int y = 0; y < cellsCount.y; y++)
+	{
+		for (int x = 0; x < cellsCount.x; x++)
+		{
+			// solid cells are left out of the solve
+			outDivergences[x + y * cellsCount.x] = IsSolid(x, y) ? 0.f : (GetHorizontalVelocity(x + 1, y) - GetHorizontalVelocity(x, y)) / cellSize.x
+				+ (GetVerticalVelocity(x, y + 1) - GetVerticalVelocity(x, y)) / cellSize.y;
+		}
+	}
+}
+
+void EulerFluidSystem::ApplyPressureGradient()
+{
+	for (int y = 0; y < rightEdgesCount.y; y++)
+	{
+		for (int x = 0; x < rightEdgesCount.x; x++)
+		{
+			int cellIndex = x + y * cellsCount.x;
+			int edgeIndex = x + y * rightEdgesCount.x;
+			horizontalVelocities[edgeIndex] -= rightEdgeWeights[edgeIndex] * (pressureSolution[cellIndex + 1] - pressureSolution[cellIndex]) / cellSize.x;
+		}
+	}
+
+	for (int y = 0; y < upEdgesCount.y; y++)
+	{
+		for (int x = 0; x < upEdgesCount.x; x++)
+		{
+			int cellIndex = x + y * cellsCount.x;
+			int edgeIndex = x + y * upEdgesCount.x;
+			verticalVelocities[edgeIndex] -= upEdgeWeights[edgeIndex] * (pressureSolution[cellIndex + cellsCount.x] - pressureSolution[cellIndex]) / cellSize.y;
+		}
+	}
+}
+
+void EulerFluidSystem::BeginPaddedRelaxation()
+{
+	const int paddedRow = cellsCount.x + 1;
+
+	if (paddedCoefficientsDirty)
+	{
+		paddedHorizontalWeights.assign(paddedHorizontalVelocities.size(), 0.f);
+		paddedVerticalWeights.assign(paddedVerticalVelocities.size(), 0.f);
+		inverseOpenEdgesCounts.resize(cellsCount.Product());
+		paddedCoefficientsDirty = false;
+		UpdatePaddedCoefficients(CellsBounds{ VecInt::Zero(), cellsCount });
+	}
+
+	// the halo is never written, it stays 0
+	for (int y = 0; y < rightEdgesCount.y; y++)
+	{
+		std::copy_n(&horizontalVelocities[y * rightEdgesCount.x], rightEdgesCount.x, &paddedHorizontalVelocities[1 + y * paddedRow]);
+	}
+	std::copy(verticalVelocities.begin(), verticalVelocities.end(), paddedVerticalVelocities.begin() + cellsCount.x);
+}
+
+void EulerFluidSystem::UpdatePaddedCoefficients(const CellsBounds& bounds)
+{
+	const int paddedRow = cellsCount.x + 1;
+
+	for (int y = bounds.min.y; y < bounds.max.y; y++)
+	{
+		for (int x = Max(bounds.min.x - 1, 0); x < Min(bounds.max.x, rightEdgesCount.x); x++)
+		{
+			paddedHorizontalWeights[(x + 1) + y * paddedRow] = rightEdgeWeights[x + y * rightEdgesCount.x];
+		}
+	}
+
+	for (int y = Max(bounds.min.y - 1, 0); y < Min(bounds.max.y, upEdgesCount.y); y++)
+	{
+		for (int x = bounds.min.x; x < bounds.max.x; x++)
+		{
+			paddedVerticalWeights[x + (y + 1) * cellsCount.x] = upEdgeWeights[x + y * upEdgesCount.x];
+		}
+	}
+
+	// the cells around share the edges of the ones in bounds
+	for (int y = Max(bounds.min.y - 1, 0); y < Min(bounds.max.y + 1, cellsCount.y); y++)
+	{
+		for (int x = Max(bounds.min.x - 1, 0); x < Min(bounds.max.x + 1, cellsCount.x); x++)
+		{
+			float openEdges = paddedHorizontalWeights[x + y * paddedRow] + paddedHorizontalWeights[(x + 1) + y * paddedRow]
+				+ paddedVerticalWeights[x + y * cellsCount.x] + paddedVerticalWeights[x + (y + 1) * cellsCount.x];
+			inverseOpenEdgesCounts[x + y * cellsCount.x] = openEdges > 0.f ? 1.f / openEdges : 0.f;
+		}
+	}
+}
+
+void EulerFluidSystem::EndPaddedRelaxation()
+{
+	const int paddedRow = cellsCount.x + 1;
+	for (int y = 0; y < rightEdgesCount.y; y++)
+	{
+		std::copy_n(&paddedHorizontalVelocities[1 + y * paddedRow], rightEdgesCount.x, &horizontalVelocities[y * rightEdgesCount.x]);
+	}
+	std::copy_n(paddedVerticalVelocities.begin() + cellsCount.x, verticalVelocities.size(), verticalVelocities.begin());
+}
+
+template<bool withSolids>
+void EulerFluidSystem::RelaxRow(int y, int firstX, int step, float pressureScale)
+{
+	float* leftEdges = &paddedHorizontalVelocities[y * (cellsCount.x + 1)]; // leftEdges[x + 1] is the right edge of cell x
+	float* downEdges = &paddedVerticalVelocities[y * cellsCount.x];
+	float* upEdges = downEdges + cellsCount.x;
+	const float* leftWeights = &paddedHorizontalWeights[y * (cellsCount.x + 1)];
+	const float* downWeights = &paddedVerticalWeights[y * cellsCount.x];
+	const float* upWeights = downWeights + cellsCount.x;
+	const float* inverseCounts = &inverseOpenEdgesCounts[y * cellsCount.x];
+	float* rowPressures = &pressures[y * cellsCount.x];
+
+	// closed edges (borders, solids) keep their velocity but still count in the divergence, solid cells have a 0 relaxation
+	for (int x = firstX; x < cellsCount.x; x += step)
+	{
+		float relaxation = gaussSeidelOverRelaxation * inverseCounts[x];
+		float divergenceX = (leftEdges[x + 1] - leftEdges[x]) * relaxation;
+		float divergenceY = (upEdges[x] - downEdges[x]) * relaxation;
+
+		if (withSolids)
+		{
+			leftEdges[x + 1] -= leftWeights[x + 1] * divergenceX;
+			leftEdges[x] += leftWeights[x] * divergenceX;
+			upEdges[x] -= upWeights[x] * divergenceY;
+			downEdges[x] += downWeights[x] * divergenceY;
+		}
+		else
+		{
+			leftEdges[x + 1] -= divergenceX;
+			leftEdges[x] += divergenceX;
+			upEdges[x] -= divergenceY;
+			downEdges[x] += divergenceY;
+		}
+
+		rowPressures[x] += sqrtf(divergenceX * divergenceX + divergenceY * divergenceY) * pressureScale;
+	}
+}
+
+EulerFluidSystem::CellsBounds EulerFluidSystem::GetObstacleBounds(const CPolygon& polygon) const
+{
+	const std::vector<Vec2>& points = polygon.GetWorldPoints();
+	if (points.empty())
+		return CellsBounds();
+
+	AABB aabb(points[0], points[0]);
+	for (const Vec2& point : points)
+	{
+		aabb.EnlargeWithPoint(point);
+	}
+
+	Vec minCoords = (aabb.pMin - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	Vec maxCoords = (aabb.pMax - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+
+	CellsBounds bounds;
+	bounds.min = VecInt{ int(ceilf(Clamp(minCoords.x, -1.f, float(cellsCount.x)))), int(ceilf(Clamp(minCoords.y, -1.f, float(cellsCount.y)))) };
+	bounds.max = VecInt{ int(floorf(Clamp(maxCoords.x, -1.f, float(cellsCount.x)))) + 1, int(floorf(Clamp(maxCoords.y, -1.f, float(cellsCount.y)))) + 1 };
+	return bounds.Intersection(CellsBounds{ VecInt::Zero(), cellsCount });
+}
+
+void EulerFluidSystem::UpdateObstacles(const std::vector<std::shared_ptr<CPolygon>>& polygons)
+{
+	obstaclesUpdate++;
+	staticDirtyBounds.clear();
+	dirtyBounds.clear();
+
+	auto markDirty = [&](const CellsBounds& bounds, bool isStatic)
+	{
+		if (bounds.IsEmpty())
+			return;
+
+		if (isStatic)
+		{
+			staticDirtyBounds.push_back(bounds);
+		}
+		dirtyBounds.push_back(bounds);
+	};
+
+	for (const std::shared_ptr<CPolygon>& polygon : polygons)
+	{
+		auto inserted = obstacles.emplace(polygon.get(), Obstacle());
+		Obstacle& obstacle = inserted.first->second;
+		obstacle.lastUpdate = obstaclesUpdate;
+
+		// the address of a removed polygon can be reused
+		const bool isNew = inserted.second || obstacle.polygon.lock() != polygon;
+		const bool isStatic = polygon->IsStatic();
+		const Vec position = polygon->Getposition();
+		const Vec rotationX = polygon->Getrotation().X;
+
+		bool changed = isNew || isStatic != obstacle.isStatic
+			|| position.x != obstacle.position.x || position.y != obstacle.position.y
+			|| rotationX.x != obstacle.rotationX.x || rotationX.y != obstacle.rotationX.y;
+
+		// moving polygons velocity is rasterized too
+		if (!isStatic)
+		{
+			changed = changed || polygon->speed.x != obstacle.speed.x || polygon->speed.y != obstacle.speed.y
+				|| polygon->angularVelocity != obstacle.angularVelocity;
+		}
+
+		if (!changed)
+			continue;
+
+		if (!isNew)
+		{
+			markDirty(obstacle.bounds, obstacle.isStatic);
+		}
+
+		obstacle.polygon = polygon;
+		obstacle.bounds = GetObstacleBounds(*polygon);
+		obstacle.isStatic = isStatic;
+		obstacle.position = position;
+		obstacle.rotationX = rotationX;
+		obstacle.speed = polygon->speed;
+		obstacle.angularVelocity = polygon->angularVelocity;
+		markDirty(obstacle.bounds, isStatic);
+	}
+
+	for (auto it = obstacles.begin(); it != obstacles.end();)
+	{
+		if (it->second.lastUpdate != obstaclesUpdate)
+		{
+			markDirty(it->second.bounds, it->second.isStatic);
+			it = obstacles.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (const CellsBounds& bounds : staticDirtyBounds)
+	{
+		for (int y = bounds.min.y; y < bounds.max.y; y++)
+		{
+			std::fill(&staticSolidMask[bounds.min.x + y * cellsCount.x], &staticSolidMask[bounds.max.x + y * cellsCount.x], uint8_t(0));
+		}
+
+		for (const auto& entry : obstacles)
+		{
+			const Obstacle& obstacle = entry.second;
+			CellsBounds area = obstacle.bounds.Intersection(bounds);
+			std::shared_ptr<CPolygon> polygon = obstacle.polygon.lock();
+			if (!obstacle.isStatic || area.IsEmpty() || !polygon)
+				continue;
+
+			ForEachCellInside(polygon->GetWorldPoints(), worldPosition, cellSize, area, [&](int x, int y)
+			{
+				staticSolidMask[x + y * cellsCount.x] = 1;
+			});
+		}
+	}
+
+	for (const CellsBounds& bounds : dirtyBounds)
+	{
+		RasterizeObstacles(bounds);
+	}
+}
+
+void EulerFluidSystem::RasterizeObstacles(const CellsBounds& bounds)
+{
+	// static layer, then the moving polygons, the previous flag being kept in bit 1 until the end
+	for (int y = bounds.min.y; y < bounds.max.y; y++)
+	{
+		for (int x = bounds.min.x; x < bounds.max.x; x++)
+		{
+			int index = x + y * cellsCount.x;
+			solidMask[index] = uint8_t(solidMask[index] << 1) | staticSolidMask[index];
+			solidVelocitiesX[index] = 0.f;
+			solidVelocitiesY[index] = 0.f;
+		}
+	}
+
+	for (const auto& entry : obstacles)
+	{
+		const Obstacle& obstacle = entry.second;
+		CellsBounds area = obstacle.bounds.Intersection(bounds);
+		std::shared_ptr<CPolygon> polygon = obstacle.polygon.lock();
+		if (obstacle.isStatic || area.IsEmpty() || !polygon)
+			continue;
+
+		ForEachCellInside(polygon->GetWorldPoints(), worldPosition, cellSize, area, [&](int x, int y)
+		{
+			int index = x + y * cellsCount.x;
+			Vec velocity = polygon->GetPointVelocity(worldPosition + (Vec2(float(x), float(y)) + Vec(0.5f, 0.5f)) * cellSize);
+			solidMask[index] |= 1;
+			solidVelocitiesX[index] = velocity.x;
+			solidVelocitiesY[index] = velocity.y;
+		});
+	}
+
+	// the moving polygons often cover the same cells as before, only their velocities changed
+	CellsBounds changed{ bounds.max, bounds.min };
+	for (int y = bounds.min.y; y < bounds.max.y; y++)
+	{
+		for (int x = bounds.min.x; x < bounds.max.x; x++)
+		{
+			uint8_t& solid = solidMask[x + y * cellsCount.x];
+			const uint8_t wasSolid = solid >> 1;
+			solid &= 1;
+			if (solid == wasSolid)
+				continue;
+
+			solidCellsCount += int(solid) - int(wasSolid);
+			changed.min = VecInt{ Min(changed.min.x, x), Min(changed.min.y, y) };
+			changed.max = VecInt{ Max(changed.max.x, x + 1), Max(changed.max.y, y + 1) };
+		}
+	}
+
+	if (!changed.IsEmpty())
+	{
+		solidChangedBounds.push_back(changed);
+	}
+}
+
+void EulerFluidSystem::UpdateEdgeWeights(const CellsBounds& bounds)
+{
+	for (int y = bounds.min.y; y < bounds.max.y; y++)
+	{
+		for (int x = Max(bounds.min.x - 1, 0); x < Min(bounds.max.x, rightEdgesCount.x); x++)
+		{
+			rightEdgeWeights[x + y * rightEdgesCount.x] = IsSolid(x, y) || IsSolid(x + 1, y) ? 0.f : 1.f;
+		}
+	}
+
+	for (int y = Max(bounds.min.y - 1, 0); y < Min(bounds.max.y, upEdgesCount.y); y++)
+	{
+		for (int x = bounds.min.x; x < bounds.max.x; x++)
+		{
+			upEdgeWeights[x + y * upEdgesCount.x] = IsSolid(x, y) || IsSolid(x, y + 1) ? 0.f : 1.f;
+		}
+	}
+
+	poissonSolver.UpdateEdgeWeights(rightEdgeWeights, upEdgeWeights, bounds.min, bounds.max);
+	if (!paddedCoefficientsDirty)
+	{
+		UpdatePaddedCoefficients(bounds);
+	}
+}
+
+void EulerFluidSystem::ApplySolidBoundaries()
+{
+	for (const CellsBounds& bounds : solidChangedBounds)
+	{
+		UpdateEdgeWeights(bounds);
+	}
+	solidChangedBounds.clear();
+
+	if (solidCellsCount == 0)
+		return;
+
+	// closed edges take the velocity of their solid cells (averaged between two solids)
+	for (int y = 0; y < rightEdgesCount.y; y++)
+	{
+		for (int x = 0; x < rightEdgesCount.x; x++)
+		{
+			int edgeIndex = x + y * rightEdgesCount.x;
+			if (rightEdgeWeights[edgeIndex] > 0.f)
+				continue;
+
+			int cellIndex = x + y * cellsCount.x;
+			float solids = float(solidMask[cellIndex] + solidMask[cellIndex + 1]);
+			horizontalVelocities[edgeIndex] = (solidMask[cellIndex] * solidVelocitiesX[cellIndex] + solidMask[cellIndex + 1] * solidVelocitiesX[cellIndex + 1]) / solids;
+		}
+	}
+
+	for (int y = 0; y < upEdgesCount.y; y++)
+	{
+		for (int x = 0; x < upEdgesCount.x; x++)
+		{
+			int edgeIndex = x + y * upEdgesCount.x;
+			if (upEdgeWeights[edgeIndex] > 0.f)
+				continue;
+
+			int cellIndex = x + y * cellsCount.x;
+			int upCellIndex = cellIndex + cellsCount.x;
+			float solids = float(solidMask[cellIndex] + solidMask[upCellIndex]);
+			verticalVelocities[edgeIndex] = (solidMask[cellIndex] * solidVelocitiesY[cellIndex] + solidMask[upCellIndex] * solidVelocitiesY[upCellIndex]) / solids;
+		}
+	}
+}
+
+void EulerFluidSystem::ClearHalo()
+{
+	const int paddedRow = cellsCount.x + 1;
+	for (int y = 0; y < cellsCount.y; y++)
+	{
+		paddedHorizontalVelocities[y * paddedRow] = 0.f;
+		paddedHorizontalVelocities[cellsCount.x + y * paddedRow] = 0.f;
+	}
+	std::fill_n(paddedVerticalVelocities.begin(), cellsCount.x, 0.f);
+	std::fill_n(paddedVerticalVelocities.end() - cellsCount.x, cellsCount.x, 0.f);
+}
+
+template<typename TRelaxRows>
+void EulerFluidSystem::RelaxSweep(TRelaxRows&& relaxRows, float pressureScale)
+{
+	if (solidCellsCount > 0)
+	{
+		relaxRows([&](int y, int firstX, int step)
+		{
+			RelaxRow<true>(y, firstX, step, pressureScale);
+		});
+	}
+	else
+	{
+		// the border cells moved their halo edges : put the walls back
+		relaxRows([&](int y, int firstX, int step)
+		{
+			RelaxRow<false>(y, firstX, step, pressureScale);
+		});
+		ClearHalo();
+	}
+}
+
+void EulerFluidSystem::ProjectionGaussSeidel(float deltaTime)
 {
 	ResetPressure();
+	BeginPaddedRelaxation();
 
-	int n = 5;
-	for (int i = 0; i < n; i++)
+	const float density = 1.f;
+	const float pressureScale = density * cellSize.x /* arbitrary */ / deltaTime;
+
+	for (int i = 0; i < gaussSeidelIterations; i++)
 	{
-		for (int y = 0; y < cellsCount.y; y++)
+		RelaxSweep([&](auto&& relaxRow)
 		{
-			for (int x = 0; x < cellsCount.x; x++)
+			for (int y = 0; y < cellsCount.y; y++)
 			{
-				Cell& cell = cells[x + y * cellsCount.x];
+				relaxRow(y, 0, 1);
+			}
+		}, pressureScale);
+	}
+
+	EndPaddedRelaxation();
+}
 
-				Vertex* rightEdge = nullptr;
-				Vertex* upEdge = nullptr;
-				Vertex* downEdge = nullptr;
-				Vertex* leftEdge = nullptr;
+void EulerFluidSystem::ProjectionRedBlackGaussSeidel(float deltaTime)
+{
+	ResetPressure();
+	BeginPaddedRelaxation();
 
-				int nbEdges = 0;
-				constexpr Vec zero = Vec::Zero();
-				Vec divergence = zero;
-				Vec velocity = zero;
+	const float density = 1.f;
+	const float pressureScale = density * cellSize.x /* arbitrary, as in ProjectionGaussSeidel */ / deltaTime;
 
-				if (x < rightEdgesCount.x)
+	for (int i = 0; i < gaussSeidelIterations; i++)
+	{
+		// cells (x + y) even, then odd : cells of the same color don't share edges, so a color can be relaxed in any order
+		for (int color = 0; color < 2; color++)
+		{
+			RelaxSweep([&](auto&& relaxRow)
+			{
+				ParallelFor(cellsCount.y, Max(1, 4096 / Max(1, cellsCount.x)), [&](size_t begin, size_t end)
 				{
-					rightEdge = &rightEdges[x + y * rightEdgesCount.x];
-					nbEdges++;
-					divergence.x += rightEdge->velocity.x;
-					velocity += rightEdge->velocity;
-				}
+					for (int y = int(begin); y < int(end); y++)
+					{
+						relaxRow(y, (y + color) & 1, 2);
+					}
+				});
+			}, pressureScale);
+		}
+	}
+
+	EndPaddedRelaxation();
+}
+
+EulerFluidSystem::Vec EulerFluidSystem::Backtrace(Vec worldPos, float deltaTime) const
+{
+	// midpoint (RK2) integration, backward in time
+	Vec midPos = worldPos - SampleVelocity(worldPos) * (deltaTime * 0.5f);
+	return worldPos - SampleVelocity(midPos) * deltaTime;
+}
 
-				if (x > 0)
+void EulerFluidSystem::Advection(float deltaTime)
+{
+	// Semi-Lagrangian : each sample takes the interpolated value found where its fluid was at the start of the step.
+	// Reads the current fields and writes the advected ones in the preallocated buffers, so rows are independent.
+	// Solid cells hold no fluid : they are emptied and left out of the interpolations of the materials.
+	const bool withSolids = solidCellsCount > 0;
+	ParallelFor(cellsCount.y, Max(1, 1024 / Max(1, cellsCount.x)), [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			for (int x = 0; x < cellsCount.x; x++)
+			{
+				int index = x + y * cellsCount.x;
+				if (withSolids && solidMask[index])
 				{
-					leftEdge = &rightEdges[(x - 1) + y * rightEdgesCount.x];
-					nbEdges++;
-					divergence.x -= leftEdge->velocity.x;
-					velocity += leftEdge->velocity;
+					advectedMaterials[index] = 0;
+					advectedFractions[index] = 1.f;
+					continue;
 				}
 
-				if (y < upEdgesCount.y)
+				Vec sourcePos = Backtrace(worldPosition + (Vec2(float(x), float(y)) + Vec(0.5f, 0.5f)) * cellSize, deltaTime);
+				BilinearStencil stencil((sourcePos - worldPosition) / cellSize - Vec(0.5f, 0.5f), cellsCount);
+
+				// interpolated material fraction of each corner fluid, the cell keeps the fluid with the biggest one
+				const int corners[4] = { stencil.x0 + stencil.y0 * cellsCount.x, stencil.x1 + stencil.y0 * cellsCount.x,
+										stencil.x0 + stencil.y1 * cellsCount.x, stencil.x1 + stencil.y1 * cellsCount.x };
+				float weights[4] = { (1.f - stencil.tx) * (1.f - stencil.ty), stencil.tx * (1.f - stencil.ty),
+									(1.f - stencil.tx) * stencil.ty, stencil.tx * stencil.ty };
+
+				// the fluid corners share the weights of the solid ones, a source inside of a solid gives defaultFluid
+				if (withSolids)
 				{
-					upEdge = &upEdges[x + y * upEdgesCount.x];
-					nbEdges++;
-					divergence.y += upEdge->velocity.y;
-					velocity += upEdge->velocity;
+					float fluidWeight = 0.f;
+					for (int corner = 0; corner < 4; corner++)
+					{
+						weights[corner] = solidMask[corners[corner]] ? 0.f : weights[corner];
+						fluidWeight += weights[corner];
+					}
+
+					for (int corner = 0; corner < 4 && fluidWeight > 0.f; corner++)
+					{
+						weights[corner] /= fluidWeight;
+					}
 				}
 
-				if (y > 0)
+				uint8_t bestMaterial = 0;
+				float bestFraction = 0.f;
+				for (int corner = 0; corner < 4; corner++)
 				{
-					downEdge = &upEdges[x + (y - 1) * upEdgesCount.x];
-					nbEdges++;
-					divergence.y -= downEdge->velocity.y;
-					velocity += downEdge->velocity;
-				}
+					uint8_t material = materials[corners[corner]];
+					if (material == 0)
+						continue;
 
-				divergence *= 1.9; // overrelaxation
+					float fraction = 0.f;
+					for (int other = 0; other < 4; other++)
+					{
+						if (materials[corners[other]] == material)
+						{
+							fraction += weights[other] * fractions[corners[other]];
+						}
+					}
 
-				if (rightEdge)
+					if (fraction > bestFraction)
+					{
+						bestFraction = fraction;
+						bestMaterial = material;
+					}
+				}
+
+				if (bestMaterial != 0 && bestFraction > minFluidFraction)
 				{
-					rightEdge->velocity.x -= divergence.x / nbEdges;
+					advectedMaterials[index] = bestMaterial;
+					advectedFractions[index] = Min(bestFraction, 1.f);
 				}
-				if (upEdge)
+				else
 				{
-					upEdge->velocity.y -= divergence.y / nbEdges;
+					advectedMaterials[index] = 0;
+					advectedFractions[index] = 1.f;
 				}
+			}
 
-				if (leftEdge)
+			if (y < rightEdgesCount.y)
+			{
+				for (int x = 0; x < rightEdgesCount.x; x++)
 				{
-					leftEdge->velocity.x += divergence.x / nbEdges;
+					Vec edgePos = worldPosition + Vec(float(x + 1), float(y) + 0.5f) * cellSize;
+					advectedHorizontalVelocities[x + y * rightEdgesCount.x] = SampleHorizontalVelocity(Backtrace(edgePos, deltaTime));
 				}
-				if (downEdge)
+			}
+
+			if (y < upEdgesCount.y)
+			{
+				for (int x = 0; x < upEdgesCount.x; x++)
 				{
-					downEdge->velocity.y += divergence.y / nbEdges;
+					Vec edgePos = worldPosition + Vec(float(x) + 0.5f, float(y + 1)) * cellSize;
+					advectedVerticalVelocities[x + y * upEdgesCount.x] = SampleVerticalVelocity(Backtrace(edgePos, deltaTime));
 				}
-
-				float density = 1.f;
-				cell.pressure += divergence.GetLength() / nbEdges * density * cellSize.x /* arbitrary */ / deltaTime;
-			
-				cell.velocity = velocity / nbEdges;
 			}
 		}
+	});
+
+	if (advectionScheme != AdvectionScheme::SemiLagrangian)
+	{
+		CompensateAdvectionError(deltaTime);
+	}
+
+	materials.swap(advectedMaterials);
+	fractions.swap(advectedFractions);
+	horizontalVelocities.swap(advectedHorizontalVelocities);
+	verticalVelocities.swap(advectedVerticalVelocities);
+
+	// the closed edges took the velocity of the fluid around, they move with their solid again
+	if (withSolids)
+	{
+		ApplySolidBoundaries();
 	}
 }
 
-void EulerFluidSystem::Advection(float deltaTime)
+void EulerFluidSystem::CompensateAdvectionError(float deltaTime)
 {
-	static std::vector<Cell> oldCells;
-	oldCells.resize(cells.size());
-	ResetCells(oldCells);
+	const SamplesPlane cellsPlane = { cellsCount, VecInt{ 0, 0 }, cellsCount, Vec(0.5f, 0.5f) };
+	const SamplesPlane horizontalPlane = { rightEdgesCount, VecInt{ 1, 0 }, VecInt{ cellsCount.x + 1, cellsCount.y }, Vec(0.f, 0.5f) };
+	const SamplesPlane verticalPlane = { upEdgesCount, VecInt{ 0, 1 }, VecInt{ cellsCount.x, cellsCount.y + 1 }, Vec(0.5f, 0.f) };
 
-	for (int y = 0; y < cellsCount.y; y++)
+	// The semi-Lagrangian error is estimated by advecting its result back (forward in time) and comparing with the original values
+	auto compensate = [&](const SamplesPlane& plane, const std::vector<float>& original, std::vector<float>& advected)
 	{
-		for (int x = 0; x < cellsCount.x; x++)
+		auto getCoords = [&](Vec pos)
 		{
-			Cell& cell = cells[x + y * cellsCount.x];
+			return (pos - worldPosition) / cellSize - plane.offset;
+		};
 
-			if (cell.fluid.lock().get() != defaultFluid.get())
+		auto sample = [&](const std::vector<float>& values, Vec pos)
+		{
+			return SampleBilinear(getCoords(pos), plane.gridCount, [&](int x, int y)
 			{
+				return plane.Get(values, x, y);
+			});
+		};
 
-				Vec oldWorldPos = GetWorldPosFromCoords(Vec2Int{ x, y });
-				Vec newWorldPos = oldWorldPos + cell.velocity * deltaTime;
-
-				VecInt coords = GetCellCoordsFromWorldPos(newWorldPos);
+		// limiter : the result stays in the range of the original values the semi-Lagrangian step interpolated
+		auto limit = [&](float value, Vec sourcePos)
+		{
+			BilinearStencil stencil(getCoords(sourcePos), plane.gridCount);
+			float v00 = plane.Get(original, stencil.x0, stencil.y0);
+			float v10 = plane.Get(original, stencil.x1, stencil.y0);
+			float v01 = plane.Get(original, stencil.x0, stencil.y1);
+			float v11 = plane.Get(original, stencil.x1, stencil.y1);
+			return Clamp(value, Min(Min(v00, v10), Min(v01, v11)), Max(Max(v00, v10), Max(v01, v11)));
+		};
 
-				if (coords.x >= 0 && coords.x < cellsCount.x && coords.y >= 0 && coords.y < cellsCount.y)
-				{
-					Cell& newCell = oldCells[coords.x + coords.y * cellsCount.x];
-					newCell.fluid = cell.fluid;
-					newCell.pressure += cell.pressure;
-				}
-				else
+		auto forEachSample = [&](auto&& functor)
+		{
+			ParallelFor(plane.storedCount.y, Max(1, 1024 / Max(1, plane.storedCount.x)), [&](size_t begin, size_t end)
+			{
+				for (int y = int(begin); y < int(end); y++)
 				{
-					cell.fluid = errorFluid;
+					for (int x = 0; x < plane.storedCount.x; x++)
+					{
+						Vec pos = worldPosition + (Vec2(float(x + plane.first.x), float(y + plane.first.y)) + plane.offset) * cellSize;
+						functor(x + y * plane.storedCount.x, pos);
+					}
 				}
-			}
-			else
+			});
+		};
+
+		compensationScratch.resize(original.size());
+
+		if (advectionScheme == AdvectionScheme::MacCormack)
+		{
+			// advected + (original - backAdvected) / 2
+			forEachSample([&](int index, Vec pos)
 			{
-				Vec oldWorldPos = GetWorldPosFromCoords(Vec2Int{ x, y });
-				Vec newWorldPos = oldWorldPos + cell.velocity * deltaTime;
-				newWorldPos.x += 10;
-			}
+				float backAdvected = sample(advected, Backtrace(pos, -deltaTime));
+				compensationScratch[index] = limit(advected[index] + 0.5f * (original[index] - backAdvected), Backtrace(pos, deltaTime));
+			});
+			advected.swap(compensationScratch);
+		}
+		else
+		{
+			// semi-Lagrangian step of original + (original - backAdvected) / 2
+			forEachSample([&](int index, Vec pos)
+			{
+				float backAdvected = sample(advected, Backtrace(pos, -deltaTime));
+				compensationScratch[index] = original[index] + 0.5f * (original[index] - backAdvected);
+			});
+			forEachSample([&](int index, Vec pos)
+			{
+				Vec sourcePos = Backtrace(pos, deltaTime);
+				advected[index] = limit(sample(compensationScratch, sourcePos), sourcePos);
+			});
+		}
+	};
+
+	// Fractions are corrected as a single fluid fraction field, cells keep the material picked by the semi-Lagrangian step
+	for (size_t cell = 0; cell < materials.size(); cell++)
+	{
+		fluidFractions[cell] = materials[cell] != 0 ? fractions[cell] : 0.f;
+		advectedFluidFractions[cell] = advectedMaterials[cell] != 0 ? advectedFractions[cell] : 0.f;
+	}
+
+	compensate(cellsPlane, fluidFractions, advectedFluidFractions);
+
+	for (size_t cell = 0; cell < materials.size(); cell++)
+	{
+		if (advectedMaterials[cell] == 0)
+			continue;
+
+		if (advectedFluidFractions[cell] > minFluidFraction)
+		{
+			advectedFractions[cell] = Min(advectedFluidFractions[cell], 1.f);
+		}
+		else
+		{
+			advectedMaterials[cell] = 0;
+			advectedFractions[cell] = 1.f;
 		}
 	}
 
-	cells = std::move(oldCells);
+	compensate(horizontalPlane, horizontalVelocities, advectedHorizontalVelocities);
+	compensate(verticalPlane, verticalVelocities, advectedVerticalVelocities);
+}
+
+float EulerFluidSystem::SampleDensity(Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, cellsCount, [this](int x, int y)
+	{
+		int index = x + y * cellsCount.x;
+		return fluids[materials[index]]->volumicMass * fractions[index] + fluids[0]->volumicMass * (1.f - fractions[index]);
+	});
+}
+
+float EulerFluidSystem::SamplePressure(Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, cellsCount, [this](int x, int y)
+	{
+		return pressures[x + y * cellsCount.x];
+	});
+}
+
+float EulerFluidSystem::SampleHorizontalVelocity(Vec worldPos) const
+{
+	// horizontal velocities are at the middle of the left edges
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.f, 0.5f);
+	return SampleBilinear(coords, VecInt{ cellsCount.x + 1, cellsCount.y }, [this](int x, int y)
+	{
+		return GetHorizontalVelocity(x, y);
+	});
+}
+
+float EulerFluidSystem::SampleVerticalVelocity(Vec worldPos) const
+{
+	// vertical velocities are at the middle of the bottom edges
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.f);
+	return SampleBilinear(coords, VecInt{ cellsCount.x, cellsCount.y + 1 }, [this](int x, int y)
+	{
+		return GetVerticalVelocity(x, y);
+	});
+}
+
+EulerFluidSystem::Vec EulerFluidSystem::SampleVelocity(Vec worldPos) const
+{
+	return Vec(SampleHorizontalVelocity(worldPos), SampleVerticalVelocity(worldPos));
+}
+
+void EulerFluidSystem::Probe(const std::vector<Vec2>& points, FluidProbeResults& results)
+{
+	results.Resize(points.size());
+
+	ParallelFor(points.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Vec velocity = SampleVelocity(points[i]);
+			results.densities[i] = SampleDensity(points[i]);
+			results.pressures[i] = SamplePressure(points[i]);
+			results.velocitiesX[i] = velocity.x;
+			results.velocitiesY[i] = velocity.y;
+		}
+	});
 }
 
 void EulerFluidSystem::Update(float deltaTime)
@@ -156,6 +938,18 @@ void EulerFluidSystem::Update(float deltaTime)
 
 	Projection(deltaTime);
 
+	gVars->pRenderer->DisplayText(std::string("Pressure solver : ") + GetPressureSolverName(pressureSolver)
+		+ ", iterations : " + std::to_string(lastSolveStats.iterations)
+		+ ", residual : " + std::to_string(lastSolveStats.initialResidual) + " -> " + std::to_string(lastSolveStats.finalResidual)
+		+ (lastSolveStats.converged ? "" : " (not converged)")
+		+ ", " + std::to_string(lastSolveStats.duration) + " ms");
+
+	if (coldSolveIterations >= 0 && pressureSolver != PressureSolverType::GaussSeidel && pressureSolver != PressureSolverType::RedBlackGaussSeidel)
+	{
+		gVars->pRenderer->DisplayText("Warm start : " + std::to_string(coldSolveIterations - lastSolveStats.iterations)
+			+ " iterations saved (cold solve : " + std::to_string(coldSolveIterations) + " iterations)");
+	}
+
 	Advection(deltaTime);
 
 	Draw();
@@ -4,44 +4,142 @@
 #include "Maths.h"
 #include "Fluids/OOP/FluidSystem.hpp"
 #include "Fluids/OOP/Fluid.hpp"
+#include "Fluids/OOP/FluidsTable.hpp"
+#include "Fluids/OOP/PoissonSolver.hpp"
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
 #include "FluidMesh.h"
 
+class CPolygon;
+
+enum class AdvectionScheme
+{
+	SemiLagrangian,	// one bilinear backtrace per sample, first order : smooths the fields a bit more every step
+	MacCormack,		// semi-Lagrangian, plus half of the error measured by advecting the result back
+	BFECC,			// back and forth error compensation : the error is removed from the fields before a second semi-Lagrangian step
+
+	Count,
+};
+
+const char* GetAdvectionSchemeName(AdvectionScheme scheme);
+
 class EulerFluidSystem : public IFluidSystem
 {
 	using Vec = Vec2;
 	using VecInt = Vec2Int;
 
-	struct Vertex
+public:
+	Vec worldPosition; // world pos of bottom left corner
+
+	// Cells planes (structure of arrays), cell (x, y) is at x + y * cellsCount.x
+	VecInt cellsCount;
+	Vec cellSize = Vec::One();
+	std::vector<uint8_t> materials; // index in fluids
+	std::vector<float> fractions; // part of the cell filled by its material, the rest being defaultFluid
+	std::vector<float> pressures;
+
+	// Edges velocities planes, only inner edges are stored (domain borders are walls) :
+	// horizontalVelocities[x + y * rightEdgesCount.x] is the edge between cells (x, y) and (x + 1, y)
+	// verticalVelocities[x + y * upEdgesCount.x] is the edge between cells (x, y) and (x, y + 1)
+	std::vector<float> horizontalVelocities;
+	VecInt rightEdgesCount;
+	std::vector<float> verticalVelocities;
+	VecInt upEdgesCount;
+
+	std::shared_ptr<Fluid> defaultFluid = std::make_shared<Fluid>(GetAir());
+
+	// Fluids indexed by the materials plane, material 0 is defaultFluid
+	FluidsTable fluids = FluidsTable(defaultFluid);
+
+	PressureSolverType pressureSolver = PressureSolverType::MultigridPCG;
+	PoissonSolver poissonSolver;
+	int gaussSeidelIterations = 5;
+	float gaussSeidelOverRelaxation = 1.9f;
+
+	// Gauss-Seidel layout : edges planes padded with the domain border edges (a halo of walls, always 0), so every cell has its 4 edges.
+	// paddedHorizontalVelocities[x + y * (cellsCount.x + 1)] is the left edge of cell (x, y), paddedVerticalVelocities[x + y * cellsCount.x] its bottom edge
+	std::vector<float> paddedHorizontalVelocities;
+	std::vector<float> paddedVerticalVelocities;
+	// Boundary coefficient planes, in the padded layouts : edges weights (0 on the halo and next to solids), 1 / open edges count per cell
+	std::vector<float> paddedHorizontalWeights;
+	std::vector<float> paddedVerticalWeights;
+	std::vector<float> inverseOpenEdgesCounts;
+	bool paddedCoefficientsDirty = true;
+	PressureSolveStats lastSolveStats;
+
+	// Advection destination buffers, allocated once in Reset
+	std::vector<uint8_t> advectedMaterials;
+	std::vector<float> advectedFractions;
+	std::vector<float> advectedHorizontalVelocities;
+	std::vector<float> advectedVerticalVelocities;
+	float minFluidFraction = 0.01f; // below, advected cells are reset to defaultFluid
+
+	// MacCormack and BFECC results are clamped to the values around the backtraced position, so they can't overshoot
+	AdvectionScheme advectionScheme = AdvectionScheme::SemiLagrangian;
+	std::vector<float> fluidFractions; // fractions, 0 for defaultFluid cells
+	std::vector<float> advectedFluidFractions;
+	std::vector<float> compensationScratch;
+
+	// Obstacles : cells whose center is inside of a polygon given to UpdateObstacles.
+	// Edges next to a solid are closed in the pressure solve and move with the solid.
+	std::vector<uint8_t> solidMask; // 1 : solid
+	std::vector<float> solidVelocitiesX; // polygon velocity at the cell center
+	std::vector<float> solidVelocitiesY;
+	int solidCellsCount = 0;
+
+	// Edges weights given to poissonSolver (1 : open, 0 : next to a solid), same layout as the edges velocities
+	std::vector<float> rightEdgeWeights;
+	std::vector<float> upEdgeWeights;
+
+	// Cells [min, max)
+	struct CellsBounds
 	{
-		Vec velocity = Vec::Zero();
+		VecInt min = VecInt::Zero();
+		VecInt max = VecInt::Zero();
 
-		std::weak_ptr<Fluid> fluid;
+		bool IsEmpty() const
+		{
+			return min.x >= max.x || min.y >= max.y;
+		}
+
+		CellsBounds Intersection(const CellsBounds& other) const
+		{
+			return CellsBounds{ VecInt{ Max(min.x, other.min.x), Max(min.y, other.min.y) }, VecInt{ Min(max.x, other.max.x), Min(max.y, other.max.y) } };
+		}
 	};
 
-	struct Cell
+	// Polygon state at its last rasterization
+	struct Obstacle
 	{
-		std::weak_ptr<Fluid> fluid;
-		float pressure;
-		Vec velocity;
+		std::weak_ptr<CPolygon> polygon;
+		CellsBounds bounds;
+		bool isStatic = false;
+		Vec position;
+		Vec rotationX;
+		Vec speed;
+		float angularVelocity = 0.f;
+		int lastUpdate = 0;
 	};
 
-public:
-	Vec worldPosition; // world pos of bottom left corner
+	std::unordered_map<const CPolygon*, Obstacle> obstacles;
+	std::vector<uint8_t> staticSolidMask; // static polygons only, rasterized once
+	std::vector<CellsBounds> staticDirtyBounds;
+	std::vector<CellsBounds> dirtyBounds;
+	std::vector<CellsBounds> solidChangedBounds; // cells whose solid flag changed, their edges weights are updated by ApplySolidBoundaries
+	int obstaclesUpdate = 0;
 
-	std::vector<Cell> cells;
-	VecInt cellsCount;
-	Vec cellSize = Vec::One();
+	std::vector<float> divergences;
+	std::vector<float> pressureSolution; // pressure * deltaTime / density, the solver unknown
 
-	std::vector<Vertex> rightEdges;
-	VecInt rightEdgesCount;
-	std::vector<Vertex> upEdges;
-	VecInt upEdgesCount;
-	//std::vector<Vertex> vertices;
-	//VecInt verticesCount;
+	bool warmStartPressure = true; // start the pressure solve from last frame solution
 
-	std::shared_ptr<Fluid> defaultFluid = std::make_shared<Fluid>(GetAir());
-	std::shared_ptr<Fluid> errorFluid = std::make_shared<Fluid>(GetWater());
+	// Reference cold solve (from zero), run every coldSolvePeriod frames to measure the warm start gain
+	int coldSolvePeriod = 60;
+	int coldSolveIterations = -1;
+	int framesSinceColdSolve = 0;
+	PressureSolverType coldSolveSolver = PressureSolverType::Count;
+	std::vector<float> coldSolution;
 
 	void ResetPressure();
 	
@@ -57,28 +155,41 @@ public:
 		upEdgesCount = newCellsCount;
 		upEdgesCount.y--;
 
-		cells.resize(cellsCount.Product());
-		rightEdges.resize(rightEdgesCount.Product());
-		upEdges.resize(upEdgesCount.Product());
-
-		//for (Vertex& vertex : vertices)
-		//{
-		//	vertex.fluid = defaultFluid;
-		//}
+		materials.assign(cellsCount.Product(), 0);
+		fractions.assign(cellsCount.Product(), 1.f);
+		pressures.assign(cellsCount.Product(), 0.f);
+		horizontalVelocities.assign(rightEdgesCount.Product(), 0.f);
+		verticalVelocities.assign(upEdgesCount.Product(), 0.f);
 
-		ResetCells(cells);
+		advectedMaterials.assign(materials.size(), 0);
+		advectedFractions.assign(fractions.size(), 1.f);
+		advectedHorizontalVelocities.assign(horizontalVelocities.size(), 0.f);
+		advectedVerticalVelocities.assign(verticalVelocities.size(), 0.f);
+		fluidFractions.assign(fractions.size(), 0.f);
+		advectedFluidFractions.assign(fractions.size(), 0.f);
 
 		cellSize = newCellSize;
 
-		m_mesh.pointSize = newCellSize.x * 50;
-	}
+		divergences.assign(cellsCount.Product(), 0.f);
+		pressureSolution.assign(cellsCount.Product(), 0.f);
+		coldSolveIterations = -1;
+		poissonSolver.Resize(cellsCount, cellSize);
+
+		solidMask.assign(cellsCount.Product(), 0);
+		staticSolidMask.assign(cellsCount.Product(), 0);
+		solidVelocitiesX.assign(cellsCount.Product(), 0.f);
+		solidVelocitiesY.assign(cellsCount.Product(), 0.f);
+		solidCellsCount = 0;
+		rightEdgeWeights.assign(rightEdgesCount.Product(), 1.f);
+		upEdgeWeights.assign(upEdgesCount.Product(), 1.f);
+		solidChangedBounds.clear();
+		obstacles.clear();
+
+		paddedHorizontalVelocities.assign((cellsCount.x + 1) * cellsCount.y, 0.f);
+		paddedVerticalVelocities.assign(cellsCount.x * (cellsCount.y + 1), 0.f);
+		paddedCoefficientsDirty = true;
 
-	void ResetCells(std::vector<Cell>& inCells)
-	{
-		for (Cell& cell : inCells)
-		{
-			cell.fluid = defaultFluid;
-		}
+		m_mesh.pointSize = newCellSize.x * 50;
 	}
 
 	virtual void AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius) override
@@ -87,6 +198,7 @@ public:
 
 		VecInt indices =  (relativePos / cellSize).Floor();
 		Vec2Int offset = (radius / cellSize).Floor();
+		uint8_t material = fluids.GetMaterial(fluid);
 
 		for (int y = Max(0,indices.y - offset.y); y < Min(cellsCount.y, indices.y + offset.y); y++)
 		{
@@ -95,17 +207,59 @@ public:
 				//if (x >= 0 && x < verticesCount.x && y >= 0 && y < verticesCount.y) // Check Radius
 				{
 					int vertexIndex = x + y * (cellsCount.x);
-					cells[vertexIndex].fluid = fluid;
-					//cells[vertexIndex].velocity = Velocity;
-					//rightEdges[x + y * rightEdgesCount.x].velocity = Velocity;
+					materials[vertexIndex] = material;
+					fractions[vertexIndex] = 1.f;
+					//horizontalVelocities[x + y * rightEdgesCount.x] = Velocity.x;
 				}
 			}
 		}
 	}
 
 	void Projection(float deltaTime);
+	void ProjectionGaussSeidel(float deltaTime);
+	// Same sweeps in checkerboard order, each color being relaxed on every core
+	void ProjectionRedBlackGaussSeidel(float deltaTime);
+	// Border pass of the sweeps : copies the edges velocities to the padded layout, and builds the coefficient planes the first time
+	void BeginPaddedRelaxation();
+	// Coefficient planes of the cells in bounds, once built they follow the edges weights changes
+	void UpdatePaddedCoefficients(const CellsBounds& bounds);
+	void EndPaddedRelaxation();
+	// Removes the over-relaxed divergence of cells firstX, firstX + step... of row y from their edges, without any border test.
+	// Without solids, the edges weights are skipped and the halo has to be cleared after each sweep.
+	template<bool withSolids>
+	void RelaxRow(int y, int firstX, int step, float pressureScale);
+	void ClearHalo();
+	// Gauss-Seidel sweeps over the rows given by relaxRows(relaxRow), then the border pass
+	template<typename TRelaxRows>
+	void RelaxSweep(TRelaxRows&& relaxRows, float pressureScale);
+
+	// Rasterizes the polygons in solidMask : static ones once, moving ones only over their old and new bounds
+	void UpdateObstacles(const std::vector<std::shared_ptr<CPolygon>>& polygons);
+	// Cells whose center is inside of the polygon AABB
+	CellsBounds GetObstacleBounds(const CPolygon& polygon) const;
+	// Rebuilds solidMask and the solid velocities over bounds, adding the cells whose solid flag changed to solidChangedBounds
+	void RasterizeObstacles(const CellsBounds& bounds);
+	// Edges next to a solid get the solid velocity, and are closed in poissonSolver
+	void ApplySolidBoundaries();
+	// Edges weights of the cells in bounds, on both of their sides
+	void UpdateEdgeWeights(const CellsBounds& bounds);
+
+	bool IsSolid(int x, int y) const
+	{
+		return solidMask[x + y * cellsCount.x] != 0;
+	}
+
+	// Net outflow of each cell per unit of area
+	void ComputeDivergences(std::vector<float>& outDivergences) const;
+	// Removes the gradient of pressureSolution from the edges velocities
+	void ApplyPressureGradient();
 
+	// Semi-Lagrangian advection of the fluids and edges velocities, bilinearly interpolated, then corrected by advectionScheme
 	void Advection(float deltaTime);
+	// MacCormack or BFECC correction of the advected buffers, from the current fields
+	void CompensateAdvectionError(float deltaTime);
+	// World position the fluid at worldPos was at deltaTime ago
+	Vec Backtrace(Vec worldPos, float deltaTime) const;
 
 	virtual void RemoveFluidAt(Vec2 fluidWorldPosition, float radius) override
 	{
@@ -115,6 +269,33 @@ public:
 	void ApplyForces(float deltaTime);
 	virtual void Update(float deltaTime) override;
 
+	virtual void Probe(const std::vector<Vec2>& points, FluidProbeResults& results) override;
+
+	// Bilinear interpolation of the cell centered fields
+	float SampleDensity(Vec worldPos) const;
+	float SamplePressure(Vec worldPos) const;
+
+	// Bilinear interpolation of the staggered edge velocities, domain borders are walls (zero normal velocity)
+	Vec SampleVelocity(Vec worldPos) const;
+	float SampleHorizontalVelocity(Vec worldPos) const;
+	float SampleVerticalVelocity(Vec worldPos) const;
+
+	// Velocity of the edge on the left of cell (x, y), x in [0, cellsCount.x], 0 on the domain borders
+	float GetHorizontalVelocity(int x, int y) const
+	{
+		if (x <= 0 || x >= cellsCount.x)
+			return 0.f;
+		return horizontalVelocities[(x - 1) + y * rightEdgesCount.x];
+	}
+
+	// Velocity of the edge below cell (x, y), y in [0, cellsCount.y], 0 on the domain borders
+	float GetVerticalVelocity(int x, int y) const
+	{
+		if (y <= 0 || y >= cellsCount.y)
+			return 0.f;
+		return verticalVelocities[x + (y - 1) * upEdgesCount.x];
+	}
+
 	static VecInt GetCoordsFromIndex(int index, VecInt count) 
 	{
 		Vec2Int Coords;
@@ -141,20 +322,16 @@ public:
 	CFluidMesh	m_mesh;
 	void Draw()
 	{
-		// TODO : For each fluid
-		m_mesh.Fill(cells.size(), [&](size_t iVertex, float& x, float& y, float& r, float& g, float& b)
+		m_mesh.Fill(materials.size(), [&](size_t iVertex, float& x, float& y, float& r, float& g, float& b)
 		{
-			const Cell& cell = cells[iVertex];
-
-			Vec2 pos = GetWorldPosFromCoords(GetCellCoordsFromIndex(iVertex));
+			Vec2 pos = GetWorldPosFromCoords(GetCellCoordsFromIndex(int(iVertex)));
 			x = pos.x;
 			y = pos.y;
-			if (std::shared_ptr<Fluid> fluid = cell.fluid.lock())
-			{
-				r = fluid->color.x;
-				g = fluid->color.y;
-				b = fluid->color.z;
-			}
+
+			const Fluid& fluid = *fluids[fractions[iVertex] >= 0.5f ? materials[iVertex] : 0];
+			r = fluid.color.x;
+			g = fluid.color.y;
+			b = fluid.color.z;
 		});
 
 		//m_mesh.Fill(vertices.size(), [&](size_t iVertex, float& x, float& y, float& r, float& g, float& b)
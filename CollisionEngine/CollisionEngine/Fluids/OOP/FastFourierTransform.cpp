@@ -0,0 +1,221 @@
+#include "FastFourierTransform.hpp"
+
+namespace
+{
+	// plain product, without the inf / nan recovery of std::complex operator*
+	inline FastFourierTransform::Complex Multiply(const FastFourierTransform::Complex& a, const FastFourierTransform::Complex& b)
+	{
+		return FastFourierTransform::Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+}
+
+void FastFourierTransform::Resize(int newSize)
+{
+	size = Max(1, newSize);
+
+	factors.clear();
+	maxFactor = 1;
+	int remaining = size;
+	for (int factor = 2; factor * factor <= remaining; factor++)
+	{
+		while (remaining % factor == 0)
+		{
+			factors.push_back(factor);
+			remaining /= factor;
+		}
+	}
+	if (remaining > 1)
+	{
+		factors.push_back(remaining);
+	}
+	for (int factor : factors)
+	{
+		maxFactor = Max(maxFactor, factor);
+	}
+
+	twiddles.resize(size);
+	for (int i = 0; i < size; i++)
+	{
+		double angle = -2.0 * M_PI * i / size;
+		twiddles[i] = Complex(cos(angle), sin(angle));
+	}
+}
+
+void FastFourierTransform::Transform(Complex* values, bool inverse, Complex* scratch) const
+{
+	Transform(values, scratch, size, 1, 0, inverse, scratch + size);
+	std::copy(scratch, scratch + size, values);
+}
+
+void FastFourierTransform::Transform(const Complex* input, Complex* output, int count, int stride, size_t factorIndex, bool inverse, Complex* butterfly) const
+{
+	if (count == 1)
+	{
+		output[0] = input[0];
+		return;
+	}
+
+	// decimation in time : the p interleaved sub sequences are transformed into consecutive blocks of output, then merged
+	const int p = factors[factorIndex];
+	const int m = count / p;
+	for (int r = 0; r < p; r++)
+	{
+		if (m == 1)
+		{
+			output[r] = input[r * stride];
+		}
+		else
+		{
+			Transform(input + r * stride, output + r * m, m, stride * p, factorIndex + 1, inverse, butterfly);
+		}
+	}
+
+	// twiddle indices are walked incrementally, exp(-2i pi e / count) being twiddles[e * step]
+	const int step = size / count;
+	const int factorStep = size / p;
+
+	if (p == 2)
+	{
+		for (int k = 0; k < m; k++)
+		{
+			Complex even = output[k];
+			Complex odd = Multiply(output[k + m], GetTwiddle(k * step, inverse));
+			output[k] = even + odd;
+			output[k + m] = even - odd;
+		}
+		return;
+	}
+
+	for (int k = 0; k < m; k++)
+	{
+		int twiddleIndex = 0;
+		for (int r = 0; r < p; r++)
+		{
+			butterfly[r] = Multiply(output[r * m + k], GetTwiddle(twiddleIndex, inverse));
+			twiddleIndex = (twiddleIndex + k * step) % size;
+		}
+
+		for (int q = 0; q < p; q++)
+		{
+			Complex sum = butterfly[0];
+			int twiddleAccumulator = 0;
+			for (int r = 1; r < p; r++)
+			{
+				twiddleAccumulator += q * factorStep;
+				twiddleAccumulator -= twiddleAccumulator >= size ? size : 0;
+				sum += Multiply(butterfly[r], GetTwiddle(twiddleAccumulator, inverse));
+			}
+			output[k + q * m] = sum;
+		}
+	}
+}
+
+void FastCosineTransform::Resize(int newSize)
+{
+	size = Max(1, newSize);
+	packed = size % 2 == 0;
+	fft.Resize(packed ? size / 2 : size);
+
+	shifts.resize(size);
+	for (int k = 0; k < size; k++)
+	{
+		double angle = -M_PI * k / (2.0 * size);
+		shifts[k] = Complex(cos(angle), sin(angle));
+	}
+
+	packingTwiddles.resize(size / 2);
+	for (int k = 0; k < size / 2; k++)
+	{
+		double angle = -2.0 * M_PI * k / size;
+		packingTwiddles[k] = Complex(cos(angle), sin(angle));
+	}
+}
+
+void FastCosineTransform::Forward(float* values, int stride, Complex* scratch) const
+{
+	// Makhoul : even values in order then odd values reversed, the DCT is the real part of the shifted Fourier transform
+	auto getReordered = [&](int i)
+	{
+		return 2 * i < size ? values[2 * i * stride] : values[(2 * (size - 1 - i) + 1) * stride];
+	};
+
+	Complex* spectrum = scratch;
+	if (!packed)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			spectrum[i] = getReordered(i);
+		}
+		fft.Transform(spectrum, false, scratch + size);
+	}
+	else
+	{
+		// the reordered values are real : pairs of them are packed in complex values, transformed at half size, then split
+		const int half = size / 2;
+		Complex* packedValues = scratch + size;
+		for (int i = 0; i < half; i++)
+		{
+			packedValues[i] = Complex(getReordered(2 * i), getReordered(2 * i + 1));
+		}
+		fft.Transform(packedValues, false, scratch + size + half);
+
+		for (int k = 0; k < half; k++)
+		{
+			Complex value = packedValues[k];
+			Complex mirrored = std::conj(packedValues[(half - k) % half]);
+			Complex even = (value + mirrored) * 0.5;
+			Complex odd = Multiply(value - mirrored, Complex(0.0, -0.5));
+			Complex twiddledOdd = Multiply(packingTwiddles[k], odd);
+			spectrum[k] = even + twiddledOdd;
+			spectrum[k + half] = even - twiddledOdd;
+		}
+	}
+
+	for (int k = 0; k < size; k++)
+	{
+		values[k * stride] = float(Multiply(shifts[k], spectrum[k]).real());
+	}
+}
+
+void FastCosineTransform::Inverse(float* values, int stride, Complex* scratch) const
+{
+	// the real input makes the Fourier transform hermitian, so it is rebuilt from X[k] and X[size - k]
+	Complex* spectrum = scratch;
+	for (int k = 0; k < size; k++)
+	{
+		float mirrored = k > 0 ? values[(size - k) * stride] : 0.f;
+		spectrum[k] = Multiply(std::conj(shifts[k]), Complex(values[k * stride], -mirrored));
+	}
+
+	auto setReordered = [&](int i, double value)
+	{
+		values[(2 * i < size ? 2 * i : 2 * (size - 1 - i) + 1) * stride] = float(value);
+	};
+
+	if (!packed)
+	{
+		fft.Transform(spectrum, true, scratch + size);
+		for (int i = 0; i < size; i++)
+		{
+			setReordered(i, spectrum[i].real() / size);
+		}
+	}
+	else
+	{
+		const int half = size / 2;
+		Complex* packedValues = scratch + size;
+		for (int k = 0; k < half; k++)
+		{
+			Complex even = (spectrum[k] + spectrum[k + half]) * 0.5;
+			Complex odd = Multiply((spectrum[k] - spectrum[k + half]) * 0.5, std::conj(packingTwiddles[k]));
+			packedValues[k] = even + Multiply(odd, Complex(0.0, 1.0));
+		}
+		fft.Transform(packedValues, true, scratch + size + half);
+
+		for (int i = 0; i < half; i++)
+		{
+			setReordered(2 * i, packedValues[i].real() / half);
+			setReordered(2 * i + 1, packedValues[i].imag() / half);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef _OOP_FAST_FOURIER_TRANSFORM_HPP_
+#define _OOP_FAST_FOURIER_TRANSFORM_HPP_
+
+#include "Maths.h"
+#include <complex>
+#include <vector>
+
+// Complex discrete Fourier transform of any size, mixed radix Cooley-Tukey :
+// O(n log n) when size only has small prime factors, O(n * p) for a prime factor p.
+class FastFourierTransform
+{
+public:
+	using Complex = std::complex<double>;
+
+	void Resize(int newSize);
+
+	int GetSize() const
+	{
+		return size;
+	}
+
+	// Complex values needed by the scratch buffer of Transform
+	int GetScratchSize() const
+	{
+		return size + maxFactor;
+	}
+
+	// In place, not normalized (inverse(forward(x)) = size * x)
+	void Transform(Complex* values, bool inverse, Complex* scratch) const;
+
+private:
+	int size = 0;
+	int maxFactor = 1;
+	std::vector<int> factors; // prime factors of size, smallest first
+	std::vector<Complex> twiddles; // exp(-2i pi k / size)
+
+	void Transform(const Complex* input, Complex* output, int count, int stride, size_t factorIndex, bool inverse, Complex* butterfly) const;
+
+	Complex GetTwiddle(int index, bool inverse) const
+	{
+		return inverse ? std::conj(twiddles[index]) : twiddles[index];
+	}
+};
+
+// DCT-II and its inverse (scaled DCT-III) computed with a Fourier transform of the same size, or half of it for even sizes.
+// The DCT-II basis are the eigenvectors of the cell centered Laplacian with walls on both ends.
+class FastCosineTransform
+{
+public:
+	using Complex = FastFourierTransform::Complex;
+
+	void Resize(int newSize);
+
+	int GetSize() const
+	{
+		return size;
+	}
+
+	int GetScratchSize() const
+	{
+		return 2 * size + fft.GetScratchSize();
+	}
+
+	// On values[i * stride], i in [0, size)
+	void Forward(float* values, int stride, Complex* scratch) const;
+	void Inverse(float* values, int stride, Complex* scratch) const;
+
+private:
+	int size = 0;
+	bool packed = false; // even size, transformed as size / 2 complex values
+	FastFourierTransform fft;
+	std::vector<Complex> shifts; // exp(-i pi k / (2 * size))
+	std::vector<Complex> packingTwiddles; // exp(-2i pi k / size), k < size / 2
+};
+
+#endif
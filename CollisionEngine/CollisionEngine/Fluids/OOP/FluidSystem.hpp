@@ -3,6 +3,29 @@
 
 #include "Maths.h"
 #include <memory>
+#include <vector>
+
+// Fields sampled by IFluidSystem::Probe, stored as structure of arrays (one entry per probed point)
+struct FluidProbeResults
+{
+	std::vector<float> densities;
+	std::vector<float> pressures;
+	std::vector<float> velocitiesX;
+	std::vector<float> velocitiesY;
+
+	void Resize(size_t count)
+	{
+		densities.resize(count);
+		pressures.resize(count);
+		velocitiesX.resize(count);
+		velocitiesY.resize(count);
+	}
+
+	size_t GetSize() const
+	{
+		return densities.size();
+	}
+};
 
 class IFluidSystem
 {
@@ -11,6 +34,9 @@ public:
 	virtual void AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec2 worldPosition, Vec2 Velocity, float radius) = 0;
 	virtual void RemoveFluidAt(Vec2 worldPosition, float radius) = 0;
 	virtual void Update(float deltaTime) = 0;
+
+	// Samples density, pressure and velocity at every point (evaluated in parallel)
+	virtual void Probe(const std::vector<Vec2>& points, FluidProbeResults& results) = 0;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef _OOP_FLUIDS_TABLE_HPP_
+#define _OOP_FLUIDS_TABLE_HPP_
+
+#include "Fluids/OOP/Fluid.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Fluids of the grid fluid systems, indexed by their uint8_t materials : material 0 is the default fluid of the system
+class FluidsTable
+{
+public:
+	static constexpr size_t maxFluidsCount = 256;
+
+	explicit FluidsTable(const std::shared_ptr<Fluid>& defaultFluid) : fluids{ defaultFluid }
+	{
+	}
+
+	const std::shared_ptr<Fluid>& operator[](size_t material) const
+	{
+		return fluids[material];
+	}
+
+	size_t size() const
+	{
+		return fluids.size();
+	}
+
+	// Index of fluid, added if needed (the default fluid when the table is full)
+	uint8_t GetMaterial(const std::weak_ptr<Fluid>& fluid)
+	{
+		std::shared_ptr<Fluid> lockedFluid = fluid.lock();
+		for (size_t i = 0; i < fluids.size(); i++)
+		{
+			if (fluids[i] == lockedFluid)
+			{
+				return uint8_t(i);
+			}
+		}
+
+		if (!lockedFluid || fluids.size() >= maxFluidsCount)
+		{
+			return 0;
+		}
+
+		fluids.push_back(lockedFluid);
+		return uint8_t(fluids.size() - 1);
+	}
+
+private:
+	std::vector<std::shared_ptr<Fluid>> fluids;
+};
+
+#endif
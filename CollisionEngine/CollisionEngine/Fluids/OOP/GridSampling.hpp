@@ -0,0 +1,51 @@
+#ifndef _OOP_GRID_SAMPLING_HPP_
+#define _OOP_GRID_SAMPLING_HPP_
+
+#include "Maths.h"
+
+// Bilinear stencil at continuous coords (sample (x, y) being at coords (x, y)), coords are clamped to the grid
+struct BilinearStencil
+{
+	int x0, y0, x1, y1;
+	float tx, ty;
+
+	BilinearStencil(Vec2 coords, Vec2Int count)
+	{
+		coords.x = Clamp(coords.x, 0.f, float(count.x - 1));
+		coords.y = Clamp(coords.y, 0.f, float(count.y - 1));
+
+		x0 = Min(int(coords.x), count.x - 2 < 0 ? 0 : count.x - 2);
+		y0 = Min(int(coords.y), count.y - 2 < 0 ? 0 : count.y - 2);
+		x1 = Min(x0 + 1, count.x - 1);
+		y1 = Min(y0 + 1, count.y - 1);
+		tx = coords.x - x0;
+		ty = coords.y - y0;
+	}
+};
+
+// Bilinear interpolation of the samples returned by getter(x, y)
+template<typename TGetter>
+float SampleBilinear(Vec2 coords, Vec2Int count, TGetter&& getter)
+{
+	BilinearStencil stencil(coords, count);
+
+	float bottom = getter(stencil.x0, stencil.y0) * (1.f - stencil.tx) + getter(stencil.x1, stencil.y0) * stencil.tx;
+	float top = getter(stencil.x0, stencil.y1) * (1.f - stencil.tx) + getter(stencil.x1, stencil.y1) * stencil.tx;
+	return bottom * (1.f - stencil.ty) + top * stencil.ty;
+}
+
+// Gradient of the bilinear interpolation, per unit of coords
+template<typename TGetter>
+Vec2 SampleBilinearGradient(Vec2 coords, Vec2Int count, TGetter&& getter)
+{
+	BilinearStencil stencil(coords, count);
+
+	float v00 = getter(stencil.x0, stencil.y0);
+	float v10 = getter(stencil.x1, stencil.y0);
+	float v01 = getter(stencil.x0, stencil.y1);
+	float v11 = getter(stencil.x1, stencil.y1);
+	return Vec2((v10 - v00) * (1.f - stencil.ty) + (v11 - v01) * stencil.ty,
+		(v01 - v00) * (1.f - stencil.tx) + (v11 - v10) * stencil.tx);
+}
+
+#endif
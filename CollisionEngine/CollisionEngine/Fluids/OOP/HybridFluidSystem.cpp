@@ -0,0 +1,525 @@
+#include "HybridFluidSystem.hpp"
+
+#include "Fluids/OOP/GridSampling.hpp"
+#include "GlobalVariables.h"
+#include "Parallel.h"
+#include "Renderer.h"
+#include "Timer.h"
+
+#include <string>
+
+namespace
+{
+	constexpr size_t particlesPerJob = 1024;
+
+	// Bilinear (tent) weight of a particle at offset from an edge
+	inline float GetTransferWeight(Vec2 offset, Vec2 cellSize)
+	{
+		return Max(0.f, 1.f - fabsf(offset.x) / cellSize.x) * Max(0.f, 1.f - fabsf(offset.y) / cellSize.y);
+	}
+}
+
+const char* GetHybridTransferName(HybridTransferType type)
+{
+	switch (type)
+	{
+	case HybridTransferType::FLIP:
+		return "FLIP";
+	case HybridTransferType::APIC:
+		return "APIC";
+	default:
+		return "Unknown";
+	}
+}
+
+void HybridFluidSystem::Reset(Vec newWorldPosition, VecInt newCellsCount, Vec newCellSize)
+{
+	worldPosition = newWorldPosition;
+	cellsCount = newCellsCount;
+	cellSize = newCellSize;
+
+	rightEdgesCount = VecInt{ cellsCount.x - 1, cellsCount.y };
+	upEdgesCount = VecInt{ cellsCount.x, cellsCount.y - 1 };
+
+	horizontalVelocities.assign(rightEdgesCount.Product(), 0.f);
+	verticalVelocities.assign(upEdgesCount.Product(), 0.f);
+	horizontalWeights.assign(rightEdgesCount.Product(), 0.f);
+	verticalWeights.assign(upEdgesCount.Product(), 0.f);
+	previousHorizontalVelocities.assign(rightEdgesCount.Product(), 0.f);
+	previousVerticalVelocities.assign(upEdgesCount.Product(), 0.f);
+
+	divergences.assign(cellsCount.Product(), 0.f);
+	pressureSolution.assign(cellsCount.Product(), 0.f);
+	poissonSolver.Resize(cellsCount, cellSize);
+
+	cellMaterials.assign(cellsCount.Product(), 0);
+	cellFractions.assign(cellsCount.Product(), 0.f);
+
+	positions.clear();
+	velocities.clear();
+	horizontalGradients.clear();
+	verticalGradients.clear();
+	particleMaterials.clear();
+	particlesSorted = false;
+
+	m_mesh.pointSize = newCellSize.x * 50 / particlesPerCellSide;
+}
+
+void HybridFluidSystem::AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius)
+{
+	uint8_t material = fluids.GetMaterial(fluid);
+	if (material == 0)
+	{
+		// defaultFluid is where there are no particles
+		RemoveFluidAt(fluidWorldPosition, radius);
+		return;
+	}
+
+	if (!particlesSorted)
+	{
+		SortParticles();
+	}
+
+	Vec relativePos = fluidWorldPosition - worldPosition;
+	VecInt indices = (relativePos / cellSize).Floor();
+	Vec2Int offset = (radius / cellSize).Floor();
+
+	std::uniform_real_distribution<float> jitter(0.25f, 0.75f);
+	const float subCellSize = 1.f / particlesPerCellSide;
+
+	for (int y = Max(0, indices.y - offset.y); y < Min(cellsCount.y, indices.y + offset.y); y++)
+	{
+		for (int x = Max(0, indices.x - offset.x); x < Min(cellsCount.x, indices.x + offset.x); x++)
+		{
+			int cellIndex = x + y * cellsCount.x;
+			if (cellStarts[cellIndex + 1] > cellStarts[cellIndex])
+			{
+				continue; // already filled
+			}
+
+			// one jittered particle per sub cell
+			for (int subY = 0; subY < particlesPerCellSide; subY++)
+			{
+				for (int subX = 0; subX < particlesPerCellSide; subX++)
+				{
+					Vec coords = Vec(x + (subX + jitter(seedRandom)) * subCellSize, y + (subY + jitter(seedRandom)) * subCellSize);
+					positions.push_back(worldPosition + coords * cellSize);
+					velocities.push_back(Velocity);
+					horizontalGradients.push_back(Vec::Zero());
+					verticalGradients.push_back(Vec::Zero());
+					particleMaterials.push_back(material);
+				}
+			}
+		}
+	}
+
+	particlesSorted = false;
+}
+
+template<typename TPredicate>
+void HybridFluidSystem::FilterParticles(TPredicate&& keep)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		if (!keep(i))
+			continue;
+
+		positions[kept] = positions[i];
+		velocities[kept] = velocities[i];
+		horizontalGradients[kept] = horizontalGradients[i];
+		verticalGradients[kept] = verticalGradients[i];
+		particleMaterials[kept] = particleMaterials[i];
+		kept++;
+	}
+
+	positions.resize(kept);
+	velocities.resize(kept);
+	horizontalGradients.resize(kept);
+	verticalGradients.resize(kept);
+	particleMaterials.resize(kept);
+	particlesSorted = false;
+}
+
+void HybridFluidSystem::RemoveFluidAt(Vec2 fluidWorldPosition, float radius)
+{
+	// same square as AddFluidAt
+	Vec relativePos = fluidWorldPosition - worldPosition;
+	VecInt indices = (relativePos / cellSize).Floor();
+	Vec2Int offset = (radius / cellSize).Floor();
+
+	FilterParticles([&](size_t i)
+	{
+		VecInt coords = ((positions[i] - worldPosition) / cellSize).Floor();
+		return coords.x < indices.x - offset.x || coords.x >= indices.x + offset.x || coords.y < indices.y - offset.y || coords.y >= indices.y + offset.y;
+	});
+}
+
+void HybridFluidSystem::SortParticles()
+{
+	// counting sort per cell, then the particles arrays are reordered so that each cell particles are contiguous
+	const int particlesCount = int(positions.size());
+	const int cellsTotal = cellsCount.Product();
+
+	particleCells.resize(particlesCount);
+	ParallelFor(particlesCount, particlesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			particleCells[i] = GetCellIndex(positions[i]);
+		}
+	});
+
+	cellStarts.assign(cellsTotal + 1, 0);
+	for (int cell : particleCells)
+	{
+		cellStarts[cell]++;
+	}
+	for (int cell = 1; cell <= cellsTotal; cell++)
+	{
+		cellStarts[cell] += cellStarts[cell - 1];
+	}
+
+	// cellStarts[cell] is the end of the cell, decremented down to its start
+	sortedIndices.resize(particlesCount);
+	for (int i = particlesCount - 1; i >= 0; i--)
+	{
+		sortedIndices[--cellStarts[particleCells[i]]] = i;
+	}
+
+	auto reorder = [&](auto& values, auto& scratch)
+	{
+		scratch.resize(values.size());
+		for (int i = 0; i < particlesCount; i++)
+		{
+			scratch[i] = values[sortedIndices[i]];
+		}
+		values.swap(scratch);
+	};
+	reorder(positions, sortScratchVectors);
+	reorder(velocities, sortScratchVectors);
+	reorder(horizontalGradients, sortScratchVectors);
+	reorder(verticalGradients, sortScratchVectors);
+	reorder(particleMaterials, sortScratchMaterials);
+
+	const float fullCellCount = float(particlesPerCellSide * particlesPerCellSide);
+	for (int cell = 0; cell < cellsTotal; cell++)
+	{
+		int count = cellStarts[cell + 1] - cellStarts[cell];
+		cellFractions[cell] = Min(1.f, count / fullCellCount);
+		cellMaterials[cell] = count > 0 ? particleMaterials[cellStarts[cell]] : uint8_t(0);
+	}
+
+	particlesSorted = true;
+}
+
+void HybridFluidSystem::ParticlesToGrid()
+{
+	const bool affine = transferType == HybridTransferType::APIC;
+
+	// Calls functor(particleIndex) for the particles of cells [minX, maxX] x [minY, maxY], clamped to the grid
+	auto forEachParticleIn = [&](int minX, int maxX, int minY, int maxY, auto&& functor)
+	{
+		minX = Max(0, minX);
+		maxX = Min(cellsCount.x - 1, maxX);
+		for (int y = Max(0, minY); y <= Min(cellsCount.y - 1, maxY); y++)
+		{
+			int first = cellStarts[minX + y * cellsCount.x];
+			int last = cellStarts[maxX + 1 + y * cellsCount.x];
+			for (int i = first; i < last; i++)
+			{
+				functor(i);
+			}
+		}
+	};
+
+	// Each edge gathers the particles in its tent support : the 2 cells on its sides and their neighbors along the edge.
+	// Edges without particles are in defaultFluid and keep their last grid velocity.
+	ParallelFor(rightEdgesCount.y, 1, [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			for (int x = 0; x < rightEdgesCount.x; x++)
+			{
+				Vec edgePos = worldPosition + Vec(float(x + 1), y + 0.5f) * cellSize;
+				float weightSum = 0.f;
+				float velocitySum = 0.f;
+				forEachParticleIn(x, x + 1, y - 1, y + 1, [&](int i)
+				{
+					Vec offset = edgePos - positions[i];
+					float weight = GetTransferWeight(offset, cellSize);
+					float velocity = velocities[i].x + (affine ? Vec::Dot(horizontalGradients[i], offset) : 0.f);
+					weightSum += weight;
+					velocitySum += weight * velocity;
+				});
+
+				int index = x + y * rightEdgesCount.x;
+				horizontalWeights[index] = weightSum;
+				if (weightSum > 0.f)
+					horizontalVelocities[index] = velocitySum / weightSum;
+			}
+		}
+	});
+
+	ParallelFor(upEdgesCount.y, 1, [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			for (int x = 0; x < upEdgesCount.x; x++)
+			{
+				Vec edgePos = worldPosition + Vec(x + 0.5f, float(y + 1)) * cellSize;
+				float weightSum = 0.f;
+				float velocitySum = 0.f;
+				forEachParticleIn(x - 1, x + 1, y, y + 1, [&](int i)
+				{
+					Vec offset = edgePos - positions[i];
+					float weight = GetTransferWeight(offset, cellSize);
+					float velocity = velocities[i].y + (affine ? Vec::Dot(verticalGradients[i], offset) : 0.f);
+					weightSum += weight;
+					velocitySum += weight * velocity;
+				});
+
+				int index = x + y * upEdgesCount.x;
+				verticalWeights[index] = weightSum;
+				if (weightSum > 0.f)
+					verticalVelocities[index] = velocitySum / weightSum;
+			}
+		}
+	});
+
+	previousHorizontalVelocities = horizontalVelocities;
+	previousVerticalVelocities = verticalVelocities;
+}
+
+void HybridFluidSystem::ApplyForces(float deltaTime)
+{
+	// only where there is fluid, defaultFluid cells are pushed around by the pressure
+	for (size_t i = 0; i < horizontalVelocities.size(); i++)
+	{
+		if (horizontalWeights[i] > 0.f)
+			horizontalVelocities[i] += gravity.x * deltaTime;
+	}
+	for (size_t i = 0; i < verticalVelocities.size(); i++)
+	{
+		if (verticalWeights[i] > 0.f)
+			verticalVelocities[i] += gravity.y * deltaTime;
+	}
+}
+
+void HybridFluidSystem::Projection(float deltaTime)
+{
+	// Same projection as EulerFluidSystem : A * pressureSolution = -divergence, warm started
+	for (int y = 0; y < cellsCount.y; y++)
+	{
+		for (int x = 0; x < cellsCount.x; x++)
+		{
+			float divergence = (GetHorizontalEdge(horizontalVelocities, x + 1, y) - GetHorizontalEdge(horizontalVelocities, x, y)) / cellSize.x
+				+ (GetVerticalEdge(verticalVelocities, x, y + 1) - GetVerticalEdge(verticalVelocities, x, y)) / cellSize.y;
+			divergences[x + y * cellsCount.x] = -divergence;
+		}
+	}
+
+	lastSolveStats = poissonSolver.Solve(pressureSolver, divergences, pressureSolution);
+
+	for (int y = 0; y < rightEdgesCount.y; y++)
+	{
+		for (int x = 0; x < rightEdgesCount.x; x++)
+		{
+			int cell = x + y * cellsCount.x;
+			horizontalVelocities[x + y * rightEdgesCount.x] -= (pressureSolution[cell + 1] - pressureSolution[cell]) / cellSize.x;
+		}
+	}
+
+	for (int y = 0; y < upEdgesCount.y; y++)
+	{
+		for (int x = 0; x < upEdgesCount.x; x++)
+		{
+			int cell = x + y * cellsCount.x;
+			verticalVelocities[x + y * upEdgesCount.x] -= (pressureSolution[cell + cellsCount.x] - pressureSolution[cell]) / cellSize.y;
+		}
+	}
+
+	lastDeltaTime = deltaTime;
+}
+
+void HybridFluidSystem::GridToParticles()
+{
+	ParallelFor(positions.size(), particlesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vec position = positions[i];
+			Vec gridVelocity = SampleVelocity(position);
+
+			if (transferType == HybridTransferType::APIC)
+			{
+				velocities[i] = gridVelocity;
+				horizontalGradients[i] = SampleHorizontalEdgesGradient(horizontalVelocities, position);
+				verticalGradients[i] = SampleVerticalEdgesGradient(verticalVelocities, position);
+			}
+			else
+			{
+				// FLIP : the particle keeps its own velocity plus the grid change, blended with the grid velocity to damp the noise
+				Vec previousGridVelocity = Vec(SampleHorizontalEdges(previousHorizontalVelocities, position), SampleVerticalEdges(previousVerticalVelocities, position));
+				Vec flipVelocity = velocities[i] + gridVelocity - previousGridVelocity;
+				velocities[i] = flipVelocity * flipRatio + gridVelocity * (1.f - flipRatio);
+			}
+		}
+	});
+}
+
+void HybridFluidSystem::AdvectParticles(float deltaTime)
+{
+	const Vec domainMin = worldPosition + cellSize * 0.01f;
+	const Vec domainMax = worldPosition + Vec2(cellsCount) * cellSize - cellSize * 0.01f;
+
+	ParallelFor(positions.size(), particlesPerJob, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Vec midPos = positions[i] + SampleVelocity(positions[i]) * (deltaTime * 0.5f);
+			Vec newPos = positions[i] + SampleVelocity(midPos) * deltaTime;
+			positions[i] = Vec(Clamp(newPos.x, domainMin.x, domainMax.x), Clamp(newPos.y, domainMin.y, domainMax.y));
+		}
+	});
+
+	particlesSorted = false;
+}
+
+void HybridFluidSystem::Update(float deltaTime)
+{
+	CTimer timer;
+	timer.Start();
+
+	if (!particlesSorted)
+	{
+		SortParticles();
+	}
+
+	ParticlesToGrid();
+	ApplyForces(deltaTime);
+	Projection(deltaTime);
+	GridToParticles();
+	AdvectParticles(deltaTime);
+
+	timer.Stop();
+
+	gVars->pRenderer->DisplayText(std::string("Hybrid ") + GetHybridTransferName(transferType) + " : " + std::to_string(positions.size()) + " particles"
+		+ ", " + GetPressureSolverName(pressureSolver) + " iterations : " + std::to_string(lastSolveStats.iterations)
+		+ (lastSolveStats.converged ? "" : " (not converged)")
+		+ ", step : " + std::to_string(timer.GetDuration() * 1000.f) + " ms");
+
+	Draw();
+}
+
+float HybridFluidSystem::SampleHorizontalEdges(const std::vector<float>& edges, Vec worldPos) const
+{
+	// horizontal velocities are at the middle of the left edges
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.f, 0.5f);
+	return SampleBilinear(coords, VecInt{ cellsCount.x + 1, cellsCount.y }, [&](int x, int y)
+	{
+		return GetHorizontalEdge(edges, x, y);
+	});
+}
+
+float HybridFluidSystem::SampleVerticalEdges(const std::vector<float>& edges, Vec worldPos) const
+{
+	// vertical velocities are at the middle of the bottom edges
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.f);
+	return SampleBilinear(coords, VecInt{ cellsCount.x, cellsCount.y + 1 }, [&](int x, int y)
+	{
+		return GetVerticalEdge(edges, x, y);
+	});
+}
+
+HybridFluidSystem::Vec HybridFluidSystem::SampleHorizontalEdgesGradient(const std::vector<float>& edges, Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.f, 0.5f);
+	return SampleBilinearGradient(coords, VecInt{ cellsCount.x + 1, cellsCount.y }, [&](int x, int y)
+	{
+		return GetHorizontalEdge(edges, x, y);
+	}) / cellSize;
+}
+
+HybridFluidSystem::Vec HybridFluidSystem::SampleVerticalEdgesGradient(const std::vector<float>& edges, Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.f);
+	return SampleBilinearGradient(coords, VecInt{ cellsCount.x, cellsCount.y + 1 }, [&](int x, int y)
+	{
+		return GetVerticalEdge(edges, x, y);
+	}) / cellSize;
+}
+
+float HybridFluidSystem::SampleHorizontalVelocity(Vec worldPos) const
+{
+	return SampleHorizontalEdges(horizontalVelocities, worldPos);
+}
+
+float HybridFluidSystem::SampleVerticalVelocity(Vec worldPos) const
+{
+	return SampleVerticalEdges(verticalVelocities, worldPos);
+}
+
+HybridFluidSystem::Vec HybridFluidSystem::SampleVelocity(Vec worldPos) const
+{
+	return Vec(SampleHorizontalVelocity(worldPos), SampleVerticalVelocity(worldPos));
+}
+
+float HybridFluidSystem::SampleDensity(Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, cellsCount, [this](int x, int y)
+	{
+		int index = x + y * cellsCount.x;
+		float fraction = cellFractions[index];
+		return fluids[cellMaterials[index]]->volumicMass * fraction + fluids[0]->volumicMass * (1.f - fraction);
+	});
+}
+
+float HybridFluidSystem::SamplePressure(Vec worldPos) const
+{
+	float density = 1.f;
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, cellsCount, [this](int x, int y)
+	{
+		return pressureSolution[x + y * cellsCount.x];
+	}) * density / lastDeltaTime;
+}
+
+void HybridFluidSystem::Probe(const std::vector<Vec2>& points, FluidProbeResults& results)
+{
+	if (!particlesSorted)
+	{
+		SortParticles();
+	}
+
+	results.Resize(points.size());
+
+	ParallelFor(points.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Vec velocity = SampleVelocity(points[i]);
+			results.densities[i] = SampleDensity(points[i]);
+			results.pressures[i] = SamplePressure(points[i]);
+			results.velocitiesX[i] = velocity.x;
+			results.velocitiesY[i] = velocity.y;
+		}
+	});
+}
+
+void HybridFluidSystem::Draw()
+{
+	m_mesh.Fill(positions.size(), [&](size_t iVertex, float& x, float& y, float& r, float& g, float& b)
+	{
+		x = positions[iVertex].x;
+		y = positions[iVertex].y;
+
+		const Fluid& fluid = *fluids[particleMaterials[iVertex]];
+		r = fluid.color.x;
+		g = fluid.color.y;
+		b = fluid.color.z;
+	});
+
+	m_mesh.Draw();
+}
@@ -0,0 +1,161 @@
+#ifndef _OOP_HYBRID_FLUID_SYSTEM_HPP_
+#define _OOP_HYBRID_FLUID_SYSTEM_HPP_
+
+#include "Maths.h"
+#include "Fluids/OOP/FluidSystem.hpp"
+#include "Fluids/OOP/Fluid.hpp"
+#include "Fluids/OOP/FluidsTable.hpp"
+#include "Fluids/OOP/PoissonSolver.hpp"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#include "FluidMesh.h"
+
+enum class HybridTransferType
+{
+	FLIP,	// particles get the grid velocity change, blended with the grid velocity (PIC) by flipRatio
+	APIC,	// particles get the grid velocity and its gradient, which goes back to the grid in the next transfer
+
+	Count,
+};
+
+const char* GetHybridTransferName(HybridTransferType type);
+
+// Particle-grid hybrid : particles carry the fluids and their velocity, the MAC grid of EulerFluidSystem (same layout)
+// is only used each frame to apply forces and make the velocity divergence free.
+// Transfers gather the particles around each edge (particles are sorted per cell), so there is no neighbor search between particles.
+// Like in EulerFluidSystem, cells without particles hold defaultFluid and take part in the pressure solve.
+class HybridFluidSystem : public IFluidSystem
+{
+	using Vec = Vec2;
+	using VecInt = Vec2Int;
+
+public:
+	Vec worldPosition; // world pos of bottom left corner
+	VecInt cellsCount;
+	Vec cellSize = Vec::One();
+
+	// Edges velocities planes, same layout as EulerFluidSystem
+	std::vector<float> horizontalVelocities;
+	VecInt rightEdgesCount;
+	std::vector<float> verticalVelocities;
+	VecInt upEdgesCount;
+
+	std::shared_ptr<Fluid> defaultFluid = std::make_shared<Fluid>(GetAir());
+
+	// Fluids indexed by the particles materials, material 0 is defaultFluid
+	FluidsTable fluids = FluidsTable(defaultFluid);
+
+	HybridTransferType transferType = HybridTransferType::APIC;
+	float flipRatio = 0.95f; // FLIP only, 0 is PIC (stable but viscous), 1 is pure FLIP (noisy)
+	Vec gravity = Vec(0.f, -9.8f);
+	int particlesPerCellSide = 2; // particles seeded per cell by AddFluidAt
+
+	PressureSolverType pressureSolver = PressureSolverType::MultigridPCG;
+	PoissonSolver poissonSolver;
+	PressureSolveStats lastSolveStats;
+	std::vector<float> divergences;
+	std::vector<float> pressureSolution; // pressure * deltaTime / density, warm starts the next solve
+
+	// Particles (structure of arrays), sorted per cell
+	std::vector<Vec> positions;
+	std::vector<Vec> velocities;
+	std::vector<Vec> horizontalGradients; // APIC : gradient of the horizontal velocity around the particle
+	std::vector<Vec> verticalGradients;
+	std::vector<uint8_t> particleMaterials;
+
+	void Reset(Vec newWorldPosition, VecInt newCellsCount, Vec newCellSize);
+
+	// Seeds particles in the empty cells of the square around fluidWorldPosition
+	virtual void AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius) override;
+	virtual void RemoveFluidAt(Vec2 fluidWorldPosition, float radius) override;
+
+	virtual void Update(float deltaTime) override;
+
+	// Sorts the particles per cell, counts them in each cell
+	void SortParticles();
+	void ParticlesToGrid();
+	void ApplyForces(float deltaTime);
+	void Projection(float deltaTime);
+	void GridToParticles();
+	// Moves the particles in the grid velocity field (midpoint integration), they stay inside of the domain
+	void AdvectParticles(float deltaTime);
+
+	virtual void Probe(const std::vector<Vec2>& points, FluidProbeResults& results) override;
+
+	// Bilinear interpolation of the cell centered fields, a cell being full when it holds particlesPerCellSide^2 particles
+	float SampleDensity(Vec worldPos) const;
+	float SamplePressure(Vec worldPos) const;
+
+	// Bilinear interpolation of the staggered edge velocities, domain borders are walls
+	Vec SampleVelocity(Vec worldPos) const;
+	float SampleHorizontalVelocity(Vec worldPos) const;
+	float SampleVerticalVelocity(Vec worldPos) const;
+
+	size_t GetParticlesCount() const
+	{
+		return positions.size();
+	}
+
+	void Draw();
+
+private:
+	// Particles of cell i are [cellStarts[i], cellStarts[i + 1])
+	std::vector<int> cellStarts;
+	std::vector<int> particleCells;
+	std::vector<int> sortedIndices;
+	bool particlesSorted = false;
+
+	// Per cell, after SortParticles
+	std::vector<uint8_t> cellMaterials;
+	std::vector<float> cellFractions;
+
+	// Edges weights of the last ParticlesToGrid (0 : no particle around) and velocities before forces and projection (FLIP)
+	std::vector<float> horizontalWeights;
+	std::vector<float> verticalWeights;
+	std::vector<float> previousHorizontalVelocities;
+	std::vector<float> previousVerticalVelocities;
+
+	float lastDeltaTime = 1.f / 60.f;
+	std::minstd_rand seedRandom;
+
+	CFluidMesh	m_mesh;
+
+	// Sorted particles reordering scratch
+	std::vector<Vec> sortScratchVectors;
+	std::vector<uint8_t> sortScratchMaterials;
+
+	// Same as EulerFluidSystem::GetHorizontalVelocity / GetVerticalVelocity, on any edges plane
+	float GetHorizontalEdge(const std::vector<float>& edges, int x, int y) const
+	{
+		if (x <= 0 || x >= cellsCount.x)
+			return 0.f;
+		return edges[(x - 1) + y * rightEdgesCount.x];
+	}
+
+	float GetVerticalEdge(const std::vector<float>& edges, int x, int y) const
+	{
+		if (y <= 0 || y >= cellsCount.y)
+			return 0.f;
+		return edges[x + (y - 1) * upEdgesCount.x];
+	}
+
+	float SampleHorizontalEdges(const std::vector<float>& edges, Vec worldPos) const;
+	float SampleVerticalEdges(const std::vector<float>& edges, Vec worldPos) const;
+	// Gradients per world unit
+	Vec SampleHorizontalEdgesGradient(const std::vector<float>& edges, Vec worldPos) const;
+	Vec SampleVerticalEdgesGradient(const std::vector<float>& edges, Vec worldPos) const;
+
+	int GetCellIndex(Vec worldPos) const
+	{
+		VecInt coords = ((worldPos - worldPosition) / cellSize).Floor();
+		return Clamp(coords.x, 0, cellsCount.x - 1) + Clamp(coords.y, 0, cellsCount.y - 1) * cellsCount.x;
+	}
+
+	// Keeps only the particles for which keep(index) is true
+	template<typename TPredicate>
+	void FilterParticles(TPredicate&& keep);
+};
+
+#endif
@@ -0,0 +1,754 @@
+#include "PoissonSolver.hpp"
+
+#include "Parallel.h"
+#include "Timer.h"
+
+#include <algorithm>
+
+namespace
+{
+	// rows processed per job, so that each job handles a few thousand cells
+	size_t GetRowsPerJob(const Vec2Int& count)
+	{
+		return Max(1, 4096 / Max(1, count.x));
+	}
+
+	// blocks of GetRowsPerJob rows
+	size_t GetRowsBlocksCount(const Vec2Int& count)
+	{
+		size_t rowsPerJob = GetRowsPerJob(count);
+		return (size_t(count.y) + rowsPerJob - 1) / rowsPerJob;
+	}
+
+	// Cell centered bilinear prolongation : a fine cell gets 3/4 of its parent and 1/4 of the closest other coarse cell (clamped on borders)
+	inline void GetProlongationStencil(int fine, int coarseCount, int& parent, int& other)
+	{
+		parent = fine / 2;
+		other = Clamp((fine & 1) ? parent + 1 : parent - 1, 0, coarseCount - 1);
+	}
+
+	inline float GetProlongationWeight(int fine, int coarse, int coarseCount)
+	{
+		int parent, other;
+		GetProlongationStencil(fine, coarseCount, parent, other);
+		return (parent == coarse ? 0.75f : 0.f) + (other == coarse ? 0.25f : 0.f);
+	}
+}
+
+const char* GetPressureSolverName(PressureSolverType type)
+{
+	switch (type)
+	{
+	case PressureSolverType::GaussSeidel:
+		return "Gauss-Seidel";
+	case PressureSolverType::RedBlackGaussSeidel:
+		return "Red-black Gauss-Seidel";
+	case PressureSolverType::Multigrid:
+		return "Multigrid";
+	case PressureSolverType::MultigridPCG:
+		return "Multigrid PCG";
+	case PressureSolverType::Spectral:
+		return "Spectral";
+	default:
+		return "Unknown";
+	}
+}
+
+void PoissonSolver::Resize(Vec2Int cellsCount, Vec2 cellSize)
+{
+	// the levels and buffers keep their capacity, resizing below the largest grid so far doesn't allocate
+	levelsCount = 0;
+
+	Vec2Int count = cellsCount;
+	Vec2 coefficients = Vec2(1.f / Sqr(cellSize.x), 1.f / Sqr(cellSize.y));
+
+	while (true)
+	{
+		if (levelsCount == levels.size())
+		{
+			levels.emplace_back();
+		}
+		Level& level = levels[levelsCount++];
+		level.count = count;
+		level.coefficients = coefficients;
+		level.x.assign(count.Product(), 0.f);
+		level.b.assign(count.Product(), 0.f);
+		level.r.assign(count.Product(), 0.f);
+		level.rightWeights.assign(Max(0, count.x - 1) * count.y, 1.f);
+		level.upWeights.assign(count.x * Max(0, count.y - 1), 1.f);
+		ComputeDiagonal(level);
+
+		if (count.x <= 4 || count.y <= 4)
+		{
+			break;
+		}
+
+		count = Vec2Int{ (count.x + 1) / 2, (count.y + 1) / 2 };
+		coefficients = coefficients * 0.25f; // cells are twice bigger
+	}
+
+	cgResidual.assign(cellsCount.Product(), 0.f);
+	cgDirection.assign(cellsCount.Product(), 0.f);
+	cgProduct.assign(cellsCount.Product(), 0.f);
+
+	// 1D eigenvalues of the cell centered Laplacian with walls : 4 / cellSize^2 * sin^2(pi * k / (2 * count))
+	closedEdgesCount = 0;
+	rowsTransform.Resize(cellsCount.x);
+	columnsTransform.Resize(cellsCount.y);
+	spectralScratch.resize(Max(GetRowsBlocksCount(cellsCount) * rowsTransform.GetScratchSize(),
+		GetRowsBlocksCount(Vec2Int{ cellsCount.y, cellsCount.x }) * columnsTransform.GetScratchSize()));
+	const Vec2 finestCoefficients = levels[0].coefficients;
+	eigenvalues.resize(cellsCount.Product());
+	for (int y = 0; y < cellsCount.y; y++)
+	{
+		float vertical = 4.f * finestCoefficients.y * Sqr(sinf(float(M_PI) * y / (2.f * cellsCount.y)));
+		for (int x = 0; x < cellsCount.x; x++)
+		{
+			float horizontal = 4.f * finestCoefficients.x * Sqr(sinf(float(M_PI) * x / (2.f * cellsCount.x)));
+			eigenvalues[x + y * cellsCount.x] = horizontal + vertical;
+		}
+	}
+}
+
+void PoissonSolver::SetEdgeWeights(const std::vector<float>& rightWeights, const std::vector<float>& upWeights)
+{
+	assert(levelsCount > 0);
+	assert(rightWeights.size() == levels[0].rightWeights.size() && upWeights.size() == levels[0].upWeights.size());
+
+	levels[0].rightWeights = rightWeights;
+	levels[0].upWeights = upWeights;
+
+	auto isClosed = [](float weight) { return weight != 1.f; };
+	closedEdgesCount = int(std::count_if(rightWeights.begin(), rightWeights.end(), isClosed) + std::count_if(upWeights.begin(), upWeights.end(), isClosed));
+
+	UpdateLevels(Vec2Int::Zero(), levels[0].count);
+}
+
+void PoissonSolver::UpdateEdgeWeights(const std::vector<float>& rightWeights, const std::vector<float>& upWeights, Vec2Int min, Vec2Int max)
+{
+	assert(levelsCount > 0);
+	assert(rightWeights.size() == levels[0].rightWeights.size() && upWeights.size() == levels[0].upWeights.size());
+
+	Level& finest = levels[0];
+	const Vec2Int count = finest.count;
+
+	// the edges of the cells, on both of their sides
+	for (int y = min.y; y < max.y; y++)
+	{
+		for (int x = Max(min.x - 1, 0); x < Min(max.x, count.x - 1); x++)
+		{
+			int index = x + y * (count.x - 1);
+			closedEdgesCount += int(rightWeights[index] != 1.f) - int(finest.rightWeights[index] != 1.f);
+			finest.rightWeights[index] = rightWeights[index];
+		}
+	}
+
+	for (int y = Max(min.y - 1, 0); y < Min(max.y, count.y - 1); y++)
+	{
+		for (int x = min.x; x < max.x; x++)
+		{
+			int index = x + y * count.x;
+			closedEdgesCount += int(upWeights[index] != 1.f) - int(finest.upWeights[index] != 1.f);
+			finest.upWeights[index] = upWeights[index];
+		}
+	}
+
+	UpdateLevels(min, max);
+}
+
+void PoissonSolver::UpdateLevels(Vec2Int min, Vec2Int max)
+{
+	for (size_t levelIndex = 0; ; levelIndex++)
+	{
+		// the cells around share the edges of the changed ones
+		Level& fine = levels[levelIndex];
+		ComputeDiagonal(fine, Vec2Int{ Max(min.x - 1, 0), Max(min.y - 1, 0) }, Vec2Int{ Min(max.x + 1, fine.count.x), Min(max.y + 1, fine.count.y) });
+
+		if (levelIndex + 1 == levelsCount)
+			break;
+
+		// a coarse edge covers 2 fine edges, its weight is their average
+		Level& coarse = levels[levelIndex + 1];
+		min = Vec2Int{ min.x / 2, min.y / 2 };
+		max = Vec2Int{ (max.x + 1) / 2, (max.y + 1) / 2 };
+
+		for (int y = min.y; y < max.y; y++)
+		{
+			int fineY0 = 2 * y;
+			int fineY1 = Min(2 * y + 1, fine.count.y - 1);
+			for (int x = Max(min.x - 1, 0); x < Min(max.x, coarse.count.x - 1); x++)
+			{
+				int fineX = 2 * x + 1;
+				coarse.rightWeights[x + y * (coarse.count.x - 1)] = 0.5f * (fine.rightWeights[fineX + fineY0 * (fine.count.x - 1)] + fine.rightWeights[fineX + fineY1 * (fine.count.x - 1)]);
+			}
+		}
+
+		for (int y = Max(min.y - 1, 0); y < Min(max.y, coarse.count.y - 1); y++)
+		{
+			int fineY = 2 * y + 1;
+			for (int x = min.x; x < max.x; x++)
+			{
+				int fineX0 = 2 * x;
+				int fineX1 = Min(2 * x + 1, fine.count.x - 1);
+				coarse.upWeights[x + y * coarse.count.x] = 0.5f * (fine.upWeights[fineX0 + fineY * fine.count.x] + fine.upWeights[fineX1 + fineY * fine.count.x]);
+			}
+		}
+	}
+}
+
+void PoissonSolver::ComputeDiagonal(Level& level)
+{
+	level.diagonal.resize(level.count.Product());
+	ComputeDiagonal(level, Vec2Int::Zero(), level.count);
+}
+
+void PoissonSolver::ComputeDiagonal(Level& level, Vec2Int min, Vec2Int max)
+{
+	const Vec2Int count = level.count;
+	for (int y = min.y; y < max.y; y++)
+	{
+		for (int x = min.x; x < max.x; x++)
+		{
+			float horizontal = (x > 0 ? level.rightWeights[(x - 1) + y * (count.x - 1)] : 0.f)
+				+ (x < count.x - 1 ? level.rightWeights[x + y * (count.x - 1)] : 0.f);
+			float vertical = (y > 0 ? level.upWeights[x + (y - 1) * count.x] : 0.f)
+				+ (y < count.y - 1 ? level.upWeights[x + y * count.x] : 0.f);
+			level.diagonal[x + y * count.x] = horizontal * level.coefficients.x + vertical * level.coefficients.y;
+		}
+	}
+}
+
+PressureSolveStats PoissonSolver::Solve(PressureSolverType type, const std::vector<float>& rhs, std::vector<float>& solution)
+{
+	assert(levelsCount > 0);
+	assert(rhs.size() == levels[0].b.size());
+
+	CTimer timer;
+	timer.Start();
+
+	Level& finest = levels[0];
+	finest.b = rhs;
+	RemoveMean(finest, finest.b);
+	solution.resize(finest.b.size(), 0.f);
+
+	PressureSolveStats stats;
+	if (type == PressureSolverType::Spectral && closedEdgesCount == 0)
+	{
+		stats = SolveSpectral(solution);
+	}
+	else if (type == PressureSolverType::MultigridPCG || type == PressureSolverType::Spectral)
+	{
+		stats = SolveMultigridPCG(solution);
+	}
+	else
+	{
+		stats = SolveMultigrid(solution);
+	}
+
+	timer.Stop();
+	stats.duration = timer.GetDuration() * 1000.f;
+	return stats;
+}
+
+PressureSolveStats PoissonSolver::SolveMultigrid(std::vector<float>& solution)
+{
+	PressureSolveStats stats;
+	Level& finest = levels[0];
+
+	double rhsNorm = sqrt(Dot(finest.b, finest.b));
+	if (rhsNorm == 0.0)
+	{
+		solution.assign(solution.size(), 0.f);
+		stats.converged = true;
+		return stats;
+	}
+
+	finest.x.swap(solution);
+
+	ComputeResidual(finest);
+	stats.initialResidual = stats.finalResidual = float(sqrt(Dot(finest.r, finest.r)) / rhsNorm);
+	if (stats.initialResidual > 1.f)
+	{
+		// the guess is worse than zero (the right hand side dropped since last solve)
+		finest.x.assign(finest.x.size(), 0.f);
+		finest.r = finest.b;
+		stats.initialResidual = stats.finalResidual = 1.f;
+	}
+	stats.converged = stats.finalResidual <= tolerance;
+
+	while (!stats.converged && stats.iterations < maxIterations)
+	{
+		VCycle(0);
+		stats.iterations++;
+
+		ComputeResidual(finest);
+		stats.finalResidual = float(sqrt(Dot(finest.r, finest.r)) / rhsNorm);
+		stats.converged = stats.finalResidual <= tolerance;
+	}
+
+	finest.x.swap(solution);
+	return stats;
+}
+
+PressureSolveStats PoissonSolver::SolveMultigridPCG(std::vector<float>& solution)
+{
+	PressureSolveStats stats;
+	Level& finest = levels[0];
+	const size_t size = finest.b.size();
+
+	double rhsNorm = sqrt(Dot(finest.b, finest.b));
+	if (rhsNorm == 0.0)
+	{
+		solution.assign(size, 0.f);
+		stats.converged = true;
+		return stats;
+	}
+
+	// r = b - Ax
+	ApplyOperator(finest, solution, cgProduct);
+	for (size_t i = 0; i < size; i++)
+	{
+		cgResidual[i] = finest.b[i] - cgProduct[i];
+	}
+
+	stats.initialResidual = stats.finalResidual = float(sqrt(Dot(cgResidual, cgResidual)) / rhsNorm);
+	if (stats.initialResidual > 1.f)
+	{
+		// the guess is worse than zero (the right hand side dropped since last solve)
+		solution.assign(size, 0.f);
+		cgResidual = finest.b;
+		stats.initialResidual = stats.finalResidual = 1.f;
+	}
+	stats.converged = stats.finalResidual <= tolerance;
+
+	double residualDotPreconditioned = 0.0;
+	while (!stats.converged && stats.iterations < maxIterations)
+	{
+		// z = M^-1 r, one V-cycle from zero (symmetric, so it can be used as a preconditioner)
+		finest.b.swap(cgResidual);
+		finest.x.assign(size, 0.f);
+		VCycle(0);
+		finest.b.swap(cgResidual);
+		RemoveMean(finest, finest.x);
+		const std::vector<float>& preconditioned = finest.x;
+
+		double newResidualDotPreconditioned = Dot(cgResidual, preconditioned);
+		if (stats.iterations == 0)
+		{
+			cgDirection = preconditioned;
+		}
+		else
+		{
+			float beta = float(newResidualDotPreconditioned / residualDotPreconditioned);
+			for (size_t i = 0; i < size; i++)
+			{
+				cgDirection[i] = preconditioned[i] + beta * cgDirection[i];
+			}
+		}
+		residualDotPreconditioned = newResidualDotPreconditioned;
+
+		ApplyOperator(finest, cgDirection, cgProduct);
+		double directionDotProduct = Dot(cgDirection, cgProduct);
+		if (directionDotProduct <= 0.0)
+		{
+			break; // already converged up to float precision
+		}
+
+		float alpha = float(residualDotPreconditioned / directionDotProduct);
+		for (size_t i = 0; i < size; i++)
+		{
+			solution[i] += alpha * cgDirection[i];
+			cgResidual[i] -= alpha * cgProduct[i];
+		}
+
+		stats.iterations++;
+		stats.finalResidual = float(sqrt(Dot(cgResidual, cgResidual)) / rhsNorm);
+		stats.converged = stats.finalResidual <= tolerance;
+	}
+
+	return stats;
+}
+
+PressureSolveStats PoissonSolver::SolveSpectral(std::vector<float>& solution)
+{
+	PressureSolveStats stats;
+	Level& finest = levels[0];
+	const Vec2Int count = finest.count;
+
+	double rhsNorm = sqrt(Dot(finest.b, finest.b));
+	if (rhsNorm == 0.0)
+	{
+		solution.assign(solution.size(), 0.f);
+		stats.converged = true;
+		return stats;
+	}
+
+	// residual of the guess, only for the stats : the solve doesn't need one
+	auto computeResidual = [&]()
+	{
+		ApplyOperator(finest, solution, cgProduct);
+		for (size_t i = 0; i < cgResidual.size(); i++)
+		{
+			cgResidual[i] = finest.b[i] - cgProduct[i];
+		}
+		return float(sqrt(Dot(cgResidual, cgResidual)) / rhsNorm);
+	};
+	stats.initialResidual = Min(computeResidual(), 1.f);
+
+	// x = DCT^-1(DCT(b) / eigenvalues). Columns are transformed as rows of the transposed grid, strided accesses being much slower.
+	// The rows are split in fixed blocks, each with its part of spectralScratch.
+	auto transformRows = [this](const FastCosineTransform& transform, std::vector<float>& values, int rowsCount, bool inverse)
+	{
+		const int rowSize = transform.GetSize();
+		const size_t rowsPerBlock = GetRowsPerJob(Vec2Int{ rowSize, rowsCount });
+		const size_t scratchSize = transform.GetScratchSize();
+		ParallelFor(GetRowsBlocksCount(Vec2Int{ rowSize, rowsCount }), 1, [&](size_t firstBlock, size_t lastBlock)
+		{
+			for (size_t block = firstBlock; block < lastBlock; block++)
+			{
+				FastCosineTransform::Complex* scratch = &spectralScratch[block * scratchSize];
+				for (size_t y = block * rowsPerBlock; y < Min(size_t(rowsCount), (block + 1) * rowsPerBlock); y++)
+				{
+					float* row = &values[y * rowSize];
+					inverse ? transform.Inverse(row, 1, scratch) : transform.Forward(row, 1, scratch);
+				}
+			}
+		});
+	};
+
+	solution = finest.b;
+	spectralTransposed.resize(solution.size());
+
+	transformRows(rowsTransform, solution, count.y, false);
+	Transpose(solution, count, spectralTransposed);
+	transformRows(columnsTransform, spectralTransposed, count.x, false);
+
+	// the constant mode (eigenvalue 0) is the free constant of the solution, set to 0 for a zero mean pressure
+	ParallelFor(count.x, GetRowsPerJob(Vec2Int{ count.y, count.x }), [&](size_t begin, size_t end)
+	{
+		for (int x = int(begin); x < int(end); x++)
+		{
+			for (int y = 0; y < count.y; y++)
+			{
+				float eigenvalue = eigenvalues[x + y * count.x];
+				float& value = spectralTransposed[y + x * count.y];
+				value = eigenvalue > 0.f ? value / eigenvalue : 0.f;
+			}
+		}
+	});
+
+	transformRows(columnsTransform, spectralTransposed, count.x, true);
+	Transpose(spectralTransposed, Vec2Int{ count.y, count.x }, solution);
+	transformRows(rowsTransform, solution, count.y, true);
+
+	stats.iterations = 1;
+	stats.finalResidual = computeResidual();
+	stats.converged = stats.finalResidual <= tolerance;
+	return stats;
+}
+
+void PoissonSolver::Transpose(const std::vector<float>& values, Vec2Int count, std::vector<float>& outTransposed)
+{
+	// by blocks, so that both the reads and the writes stay in cache
+	constexpr int blockSize = 32;
+	const int blocksCountY = (count.y + blockSize - 1) / blockSize;
+	ParallelFor(blocksCountY, 1, [&](size_t begin, size_t end)
+	{
+		for (int blockY = int(begin) * blockSize; blockY < int(end) * blockSize && blockY < count.y; blockY += blockSize)
+		{
+			for (int blockX = 0; blockX < count.x; blockX += blockSize)
+			{
+				for (int y = blockY; y < Min(blockY + blockSize, count.y); y++)
+				{
+					for (int x = blockX; x < Min(blockX + blockSize, count.x); x++)
+					{
+						outTransposed[y + x * count.y] = values[x + y * count.x];
+					}
+				}
+			}
+		}
+	});
+}
+
+void PoissonSolver::VCycle(size_t levelIndex)
+{
+	Level& level = levels[levelIndex];
+
+	if (levelIndex + 1 == levelsCount)
+	{
+		Smooth(level, coarsestSweeps, true);
+		Smooth(level, coarsestSweeps, false);
+		RemoveMean(level, level.x);
+		return;
+	}
+
+	Level& coarse = levels[levelIndex + 1];
+
+	Smooth(level, smoothingSweeps, true);
+	ComputeResidual(level);
+	Restrict(level, coarse);
+
+	coarse.x.assign(coarse.x.size(), 0.f);
+	VCycle(levelIndex + 1);
+
+	ProlongAndCorrect(coarse, level);
+	Smooth(level, smoothingSweeps, false); // reversed colors order keeps the cycle symmetric
+}
+
+void PoissonSolver::Smooth(Level& level, int sweeps, bool redFirst)
+{
+	const Vec2Int count = level.count;
+	const Vec2 coefficients = level.coefficients;
+
+	auto relaxCell = [&](int x, int y)
+	{
+		int index = x + y * count.x;
+		float diagonal = level.diagonal[index];
+		if (diagonal <= 0.f)
+			return;
+
+		float horizontal = 0.f;
+		float vertical = 0.f;
+		if (x > 0)
+			horizontal += level.rightWeights[(x - 1) + y * (count.x - 1)] * level.x[index - 1];
+		if (x < count.x - 1)
+			horizontal += level.rightWeights[x + y * (count.x - 1)] * level.x[index + 1];
+		if (y > 0)
+			vertical += level.upWeights[x + (y - 1) * count.x] * level.x[index - count.x];
+		if (y < count.y - 1)
+			vertical += level.upWeights[index] * level.x[index + count.x];
+
+		level.x[index] = (level.b[index] + horizontal * coefficients.x + vertical * coefficients.y) / diagonal;
+	};
+
+	for (int sweep = 0; sweep < sweeps; sweep++)
+	{
+		for (int colorIndex = 0; colorIndex < 2; colorIndex++)
+		{
+			int color = redFirst ? colorIndex : 1 - colorIndex;
+
+			// cells of the same color don't share edges, so each color can be updated in parallel
+			ParallelFor(count.y, GetRowsPerJob(count), [&](size_t begin, size_t end)
+			{
+				for (int y = int(begin); y < int(end); y++)
+				{
+					int firstX = (y + color) & 1;
+					if (y == 0 || y == count.y - 1)
+					{
+						for (int x = firstX; x < count.x; x += 2)
+						{
+							relaxCell(x, y);
+						}
+						continue;
+					}
+
+					if (firstX == 0)
+					{
+						relaxCell(0, y);
+						firstX = 2;
+					}
+
+					// inner cells have their 4 neighbors
+					float* xs = &level.x[y * count.x];
+					const float* up = &level.x[(y + 1) * count.x];
+					const float* down = &level.x[(y - 1) * count.x];
+					const float* bs = &level.b[y * count.x];
+					const float* diagonals = &level.diagonal[y * count.x];
+					const float* rightWeights = &level.rightWeights[y * (count.x - 1)];
+					const float* upWeights = &level.upWeights[y * count.x];
+					const float* downWeights = &level.upWeights[(y - 1) * count.x];
+
+					int x = firstX;
+					for (; x < count.x - 1; x += 2)
+					{
+						if (diagonals[x] <= 0.f)
+							continue;
+
+						float horizontal = rightWeights[x - 1] * xs[x - 1] + rightWeights[x] * xs[x + 1];
+						float vertical = downWeights[x] * down[x] + upWeights[x] * up[x];
+						xs[x] = (bs[x] + horizontal * coefficients.x + vertical * coefficients.y) / diagonals[x];
+					}
+
+					if (x == count.x - 1)
+					{
+						relaxCell(x, y);
+					}
+				}
+			});
+		}
+	}
+}
+
+void PoissonSolver::ApplyOperator(const std::vector<float>& x, std::vector<float>& out)
+{
+	out.resize(x.size());
+	ApplyOperator(levels[0], x, out);
+}
+
+void PoissonSolver::ApplyOperator(const Level& level, const std::vector<float>& x, std::vector<float>& out)
+{
+	const Vec2Int count = level.count;
+	const Vec2 coefficients = level.coefficients;
+
+	ParallelFor(count.y, GetRowsPerJob(count), [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			for (int x2 = 0; x2 < count.x; x2++)
+			{
+				int index = x2 + y * count.x;
+
+				float horizontal = 0.f;
+				float vertical = 0.f;
+				if (x2 > 0)
+					horizontal += level.rightWeights[(x2 - 1) + y * (count.x - 1)] * x[index - 1];
+				if (x2 < count.x - 1)
+					horizontal += level.rightWeights[x2 + y * (count.x - 1)] * x[index + 1];
+				if (y > 0)
+					vertical += level.upWeights[x2 + (y - 1) * count.x] * x[index - count.x];
+				if (y < count.y - 1)
+					vertical += level.upWeights[index] * x[index + count.x];
+
+				out[index] = level.diagonal[index] * x[index] - horizontal * coefficients.x - vertical * coefficients.y;
+			}
+		}
+	});
+}
+
+void PoissonSolver::ComputeResidual(Level& level)
+{
+	ApplyOperator(level, level.x, level.r);
+
+	for (size_t i = 0; i < level.r.size(); i++)
+	{
+		level.r[i] = level.b[i] - level.r[i];
+	}
+}
+
+void PoissonSolver::Restrict(const Level& fine, Level& coarse)
+{
+	// transpose of the prolongation, scaled so that a constant residual stays constant.
+	// separable : rows are first restricted along x, then columns along y
+	std::vector<float>& rowsRestricted = restrictScratch;
+	rowsRestricted.resize(coarse.count.x * fine.count.y);
+
+	auto restrict1D = [](const float* values, int stride, int fineCount, int coarseIndex, int coarseCount) -> float
+	{
+		int first = 2 * coarseIndex - 1;
+		int last = 2 * coarseIndex + 2;
+		if (first >= 0 && last < fineCount && coarseIndex > 0 && coarseIndex < coarseCount - 1)
+		{
+			return 0.25f * values[first * stride] + 0.75f * values[(first + 1) * stride] + 0.75f * values[(first + 2) * stride] + 0.25f * values[last * stride];
+		}
+
+		float sum = 0.f;
+		for (int fine = Max(0, first); fine <= Min(fineCount - 1, last); fine++)
+		{
+			sum += GetProlongationWeight(fine, coarseIndex, coarseCount) * values[fine * stride];
+		}
+		return sum;
+	};
+
+	ParallelFor(fine.count.y, GetRowsPerJob(fine.count), [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			const float* row = &fine.r[y * fine.count.x];
+			for (int coarseX = 0; coarseX < coarse.count.x; coarseX++)
+			{
+				rowsRestricted[coarseX + y * coarse.count.x] = restrict1D(row, 1, fine.count.x, coarseX, coarse.count.x);
+			}
+		}
+	});
+
+	ParallelFor(coarse.count.y, GetRowsPerJob(coarse.count), [&](size_t begin, size_t end)
+	{
+		for (int coarseY = int(begin); coarseY < int(end); coarseY++)
+		{
+			for (int coarseX = 0; coarseX < coarse.count.x; coarseX++)
+			{
+				coarse.b[coarseX + coarseY * coarse.count.x] = 0.25f * restrict1D(&rowsRestricted[coarseX], coarse.count.x, fine.count.y, coarseY, coarse.count.y);
+			}
+		}
+	});
+}
+
+void PoissonSolver::ProlongAndCorrect(const Level& coarse, Level& fine)
+{
+	ParallelFor(fine.count.y, GetRowsPerJob(fine.count), [&](size_t begin, size_t end)
+	{
+		for (int y = int(begin); y < int(end); y++)
+		{
+			int parentY, otherY;
+			GetProlongationStencil(y, coarse.count.y, parentY, otherY);
+
+			for (int x = 0; x < fine.count.x; x++)
+			{
+				int parentX, otherX;
+				GetProlongationStencil(x, coarse.count.x, parentX, otherX);
+
+				const float* parentRow = &coarse.x[parentY * coarse.count.x];
+				const float* otherRow = &coarse.x[otherY * coarse.count.x];
+				float correction = 0.75f * (0.75f * parentRow[parentX] + 0.25f * parentRow[otherX])
+					+ 0.25f * (0.75f * otherRow[parentX] + 0.25f * otherRow[otherX]);
+
+				fine.x[x + y * fine.count.x] += correction;
+			}
+		}
+	});
+}
+
+void PoissonSolver::RemoveMean(const Level& level, std::vector<float>& values)
+{
+	double sum = 0.0;
+	size_t activeCount = 0;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		if (level.diagonal[i] > 0.f)
+		{
+			sum += values[i];
+			activeCount++;
+		}
+	}
+
+	if (activeCount == 0)
+		return;
+
+	float mean = float(sum / activeCount);
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		if (level.diagonal[i] > 0.f)
+		{
+			values[i] -= mean;
+		}
+	}
+}
+
+double PoissonSolver::Dot(const std::vector<float>& a, const std::vector<float>& b)
+{
+	// fixed amount of partial sums, so the result doesn't depend on the amount of threads
+	constexpr size_t partialsCount = 64;
+	double partials[partialsCount] = {};
+
+	size_t chunkSize = (a.size() + partialsCount - 1) / partialsCount;
+	ParallelFor(partialsCount, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t chunk = begin; chunk < end; chunk++)
+		{
+			double sum = 0.0;
+			size_t last = Min((chunk + 1) * chunkSize, a.size());
+			for (size_t i = chunk * chunkSize; i < last; i++)
+			{
+				sum += double(a[i]) * double(b[i]);
+			}
+			partials[chunk] = sum;
+		}
+	});
+
+	double sum = 0.0;
+	for (double partial : partials)
+	{
+		sum += partial;
+	}
+	return sum;
+}
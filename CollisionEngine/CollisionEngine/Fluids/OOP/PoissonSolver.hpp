@@ -0,0 +1,114 @@
+#ifndef _OOP_POISSON_SOLVER_HPP_
+#define _OOP_POISSON_SOLVER_HPP_
+
+#include "Maths.h"
+#include "Fluids/OOP/FastFourierTransform.hpp"
+#include <vector>
+
+enum class PressureSolverType
+{
+	GaussSeidel,	// fixed amount of over-relaxed Gauss-Seidel sweeps on the edges velocities
+	RedBlackGaussSeidel, // same sweeps in checkerboard order, parallel
+	Multigrid,		// geometric multigrid V-cycles
+	MultigridPCG,	// conjugate gradient preconditioned by a multigrid V-cycle
+	Spectral,		// direct solve with cosine transforms, only when every edge is open (MultigridPCG otherwise)
+
+	Count,
+};
+
+const char* GetPressureSolverName(PressureSolverType type);
+
+struct PressureSolveStats
+{
+	int iterations = 0;
+	float initialResidual = 0.f; // |b - Ax| / |b| of the initial guess
+	float finalResidual = 0.f;
+	float duration = 0.f; // ms
+	bool converged = false;
+};
+
+// Solves the pressure Poisson equation on a grid of cells :
+// for each cell, sum over its open edges of coef * (x[cell] - x[neighbor]) = b[cell], with coef = 1 / cellSize^2 on the edge axis.
+// Domain borders are walls (no flux) : the solution is defined up to a constant, so b is made zero mean.
+class PoissonSolver
+{
+public:
+	float tolerance = 1e-4f; // on the relative residual |b - Ax| / |b|
+	int maxIterations = 30;
+	int smoothingSweeps = 2; // red black Gauss-Seidel sweeps before and after each coarse correction
+	int coarsestSweeps = 40;
+
+	void Resize(Vec2Int cellsCount, Vec2 cellSize);
+
+	// Opens (1) or closes (0) the edges between cells, all open after Resize. Same layout as Level::rightWeights and Level::upWeights.
+	// Cells with every edge closed are left out of the solve.
+	void SetEdgeWeights(const std::vector<float>& rightWeights, const std::vector<float>& upWeights);
+	// Same, when only the edges of the cells in [min, max) changed
+	void UpdateEdgeWeights(const std::vector<float>& rightWeights, const std::vector<float>& upWeights, Vec2Int min, Vec2Int max);
+
+	// solution is used as the initial guess
+	PressureSolveStats Solve(PressureSolverType type, const std::vector<float>& rhs, std::vector<float>& solution);
+
+	// out = A * x on the finest level
+	void ApplyOperator(const std::vector<float>& x, std::vector<float>& out);
+
+	// Parallel dot product, the result doesn't depend on the amount of threads
+	static double Dot(const std::vector<float>& a, const std::vector<float>& b);
+
+private:
+	struct Level
+	{
+		Vec2Int count;
+		Vec2 coefficients; // 1 / cellSize^2 per axis
+
+		std::vector<float> x;
+		std::vector<float> b;
+		std::vector<float> r;
+
+		// Edges weights (1 : open, 0 : closed) :
+		// rightWeights[x + y * (count.x - 1)] is the edge between cells (x, y) and (x + 1, y)
+		// upWeights[x + y * count.x] is the edge between cells (x, y) and (x, y + 1)
+		std::vector<float> rightWeights;
+		std::vector<float> upWeights;
+		std::vector<float> diagonal;
+	};
+
+	std::vector<Level> levels;
+	size_t levelsCount = 0; // in use, the next ones are kept for larger grids
+
+	// MGPCG buffers, on the finest level
+	std::vector<float> cgResidual;
+	std::vector<float> cgDirection;
+	std::vector<float> cgProduct;
+
+	std::vector<float> restrictScratch;
+
+	// Spectral solve : A is diagonal in the 2D DCT-II basis, with eigenvalues[kx + ky * count.x]
+	int closedEdgesCount = 0; // on the finest level, the spectral solve needs them all open
+	FastCosineTransform rowsTransform;
+	FastCosineTransform columnsTransform;
+	std::vector<float> eigenvalues;
+	std::vector<float> spectralTransposed;
+	std::vector<FastCosineTransform::Complex> spectralScratch; // of the transforms of each block of rows, see SolveSpectral
+
+	PressureSolveStats SolveMultigrid(std::vector<float>& solution);
+	PressureSolveStats SolveMultigridPCG(std::vector<float>& solution);
+	PressureSolveStats SolveSpectral(std::vector<float>& solution);
+	static void Transpose(const std::vector<float>& values, Vec2Int count, std::vector<float>& outTransposed);
+
+	void VCycle(size_t levelIndex);
+
+	// Diagonals and coarse levels over the cells in [min, max) of the finest level, whose edges changed
+	void UpdateLevels(Vec2Int min, Vec2Int max);
+	void ComputeDiagonal(Level& level);
+	void ComputeDiagonal(Level& level, Vec2Int min, Vec2Int max);
+	void Smooth(Level& level, int sweeps, bool redFirst);
+	void ComputeResidual(Level& level);
+	void Restrict(const Level& fine, Level& coarse);
+	void ProlongAndCorrect(const Level& coarse, Level& fine);
+	void ApplyOperator(const Level& level, const std::vector<float>& x, std::vector<float>& out);
+
+	void RemoveMean(const Level& level, std::vector<float>& values);
+};
+
+#endif
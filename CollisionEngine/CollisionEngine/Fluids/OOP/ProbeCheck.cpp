@@ -0,0 +1,153 @@
+#include "ProbeCheck.hpp"
+
+#include "Fluids/OOP/AdaptiveEulerFluidSystem.hpp"
+#include "Fluids/OOP/EulerFluidSystem.hpp"
+#include "Fluids/OOP/HybridFluidSystem.hpp"
+#include "Fluids/OOP/SPHMullerFluidSystem.hpp"
+#include "Fluids/OOP/TiledEulerFluidSystem.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	constexpr float cellSize = 0.4f;
+	constexpr float discRadius = 2.f;
+	constexpr float insideDistance = 0.25f; // SPHMullerFluidSystem adds a 1m square whatever the radius
+
+	struct CheckedSystem
+	{
+		const char* name;
+		std::unique_ptr<IFluidSystem> system;
+		float emptyDensity;
+		float minFluidDensity; // inside of the disc
+		float maxFluidDensity;
+	};
+
+	template<typename... TArgs>
+	std::string Format(const char* format, TArgs... args)
+	{
+		char text[256];
+		snprintf(text, sizeof(text), format, args...);
+		return text;
+	}
+
+	// Same domains as CFluidSpawner
+	std::vector<CheckedSystem> CreateSystems(const Fluid& fluid)
+	{
+		std::vector<CheckedSystem> systems;
+		const Vec2 cellSizes = Vec2(cellSize, cellSize);
+		const float airDensity = GetAir().volumicMass;
+
+		std::unique_ptr<EulerFluidSystem> euler = std::make_unique<EulerFluidSystem>();
+		euler->Reset(Vec2::Zero(), Vec2Int{ 200, 200 }, cellSizes);
+		systems.push_back({ "Euler", std::move(euler), airDensity, fluid.volumicMass, fluid.volumicMass });
+
+		std::unique_ptr<TiledEulerFluidSystem> tiled = std::make_unique<TiledEulerFluidSystem>();
+		tiled->Reset(Vec2::Zero(), Vec2Int{ 4096, 4096 }, cellSizes);
+		systems.push_back({ "Tiled Euler", std::move(tiled), airDensity, fluid.volumicMass, fluid.volumicMass });
+
+		std::unique_ptr<AdaptiveEulerFluidSystem> adaptive = std::make_unique<AdaptiveEulerFluidSystem>();
+		adaptive->Reset(Vec2::Zero(), Vec2Int{ 100, 100 }, cellSizes);
+		systems.push_back({ "Adaptive Euler", std::move(adaptive), airDensity, fluid.volumicMass, fluid.volumicMass });
+
+		std::unique_ptr<HybridFluidSystem> hybrid = std::make_unique<HybridFluidSystem>();
+		hybrid->Reset(Vec2::Zero(), Vec2Int{ 200, 200 }, cellSizes);
+		systems.push_back({ "Hybrid", std::move(hybrid), airDensity, fluid.volumicMass, fluid.volumicMass });
+
+		// the density is the sum of the particles kernels, 0 without any particle around. The particles are added a kernel radius apart,
+		// so it stays under the rest density until the steps pack them.
+		std::unique_ptr<SPHMullerFluidSystem> sph = std::make_unique<SPHMullerFluidSystem>();
+		const float restDensity = sph->restDensity;
+		systems.push_back({ "SPH", std::move(sph), 0.f, 0.1f * restDensity, restDensity });
+
+		return systems;
+	}
+
+	constexpr float tolerance = 1e-4f; // relative
+
+	bool IsInRange(float value, float min, float max)
+	{
+		return value >= min - tolerance * fabsf(min) && value <= max + tolerance * fabsf(max);
+	}
+}
+
+std::string ProbeCheckResult::ToString() const
+{
+	std::string text = systemName + (HasPassed() ? " : passed" : " : failed");
+	for (const std::string& failure : failures)
+	{
+		text += "\n  " + failure;
+	}
+	return text;
+}
+
+std::vector<ProbeCheckResult> RunProbeCheck()
+{
+	std::vector<ProbeCheckResult> results;
+
+	std::shared_ptr<Fluid> oil = std::make_shared<Fluid>(GetOil());
+	const Vec2 center = Vec2(20.f, 20.f);
+
+	// inside of the disc, then far around it
+	std::vector<Vec2> points;
+	points.push_back(center);
+	for (float distance : { insideDistance, 4.f * discRadius })
+	{
+		points.push_back(center + Vec2(distance, 0.f));
+		points.push_back(center + Vec2(-distance, 0.f));
+		points.push_back(center + Vec2(0.f, distance));
+		points.push_back(center + Vec2(0.f, -distance));
+	}
+	const size_t insideCount = 5;
+
+	for (CheckedSystem& checked : CreateSystems(*oil))
+	{
+		ProbeCheckResult result;
+		result.systemName = checked.name;
+		IFluidSystem& system = *checked.system;
+
+		// the results are resized to the points
+		FluidProbeResults probe;
+		probe.Resize(points.size() * 2);
+		system.Probe(points, probe);
+		if (probe.GetSize() != points.size())
+			result.failures.push_back(Format("%zu results for %zu points", probe.GetSize(), points.size()));
+
+		for (size_t i = 0; i < probe.GetSize(); i++)
+		{
+			if (!IsInRange(probe.densities[i], checked.emptyDensity, checked.emptyDensity))
+				result.failures.push_back(Format("empty system density %g instead of %g", probe.densities[i], checked.emptyDensity));
+		}
+
+		system.AddFluidAt(oil, center, Vec2::Zero(), discRadius);
+		system.Probe(points, probe);
+
+		for (size_t i = 0; i < probe.GetSize(); i++)
+		{
+			if (i < insideCount)
+			{
+				if (!IsInRange(probe.densities[i], checked.minFluidDensity, checked.maxFluidDensity))
+					result.failures.push_back(Format("density %g inside of the fluid, out of [%g, %g]", probe.densities[i], checked.minFluidDensity, checked.maxFluidDensity));
+			}
+			else if (!IsInRange(probe.densities[i], checked.emptyDensity, checked.emptyDensity))
+			{
+				result.failures.push_back(Format("density %g out of the fluid instead of %g", probe.densities[i], checked.emptyDensity));
+			}
+
+			if (!std::isfinite(probe.pressures[i]) || !std::isfinite(probe.velocitiesX[i]) || !std::isfinite(probe.velocitiesY[i]))
+				result.failures.push_back(Format("pressure %g, horizontal velocity %g not finite", probe.pressures[i], probe.velocitiesX[i]));
+		}
+
+		// the points are probed in parallel, independently
+		FluidProbeResults probeAgain;
+		system.Probe(points, probeAgain);
+		if (probeAgain.densities != probe.densities || probeAgain.pressures != probe.pressures
+			|| probeAgain.velocitiesX != probe.velocitiesX || probeAgain.velocitiesY != probe.velocitiesY)
+			result.failures.push_back("probing the same points again gives other results");
+
+		results.push_back(result);
+	}
+
+	return results;
+}
@@ -0,0 +1,24 @@
+#ifndef _OOP_PROBE_CHECK_HPP_
+#define _OOP_PROBE_CHECK_HPP_
+
+#include <string>
+#include <vector>
+
+struct ProbeCheckResult
+{
+	std::string systemName;
+	std::vector<std::string> failures;
+
+	bool HasPassed() const
+	{
+		return failures.empty();
+	}
+
+	std::string ToString() const;
+};
+
+// IFluidSystem::Probe on every fluid system, without any step : the probed densities have to match the empty system,
+// then a disc of fluid added by AddFluidAt inside of it and the empty system around it. Probing twice gives the same results.
+std::vector<ProbeCheckResult> RunProbeCheck();
+
+#endif
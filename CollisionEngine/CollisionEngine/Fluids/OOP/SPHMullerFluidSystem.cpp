@@ -1,5 +1,7 @@
 #include "SPHMullerFluidSystem.hpp"
 
+#include "Parallel.h"
+
 float SPHMullerFluidSystem::GetMass()
 {
 	float particleRadiusRatio = 3.0f;
@@ -54,6 +56,7 @@ void	SPHMullerFluidSystem::AddParticle(const std::weak_ptr<struct Fluid>& fluid,
 	particle.fluid = fluid;
 
 	particles.emplace_back(std::move(particle));
+	neighborGridDirty = true;
 }
 
 void	SPHMullerFluidSystem::RemoveParticle()
@@ -85,6 +88,9 @@ void	SPHMullerFluidSystem::Update(float dt)
 
 	BorderCollisions(); // OK
 
+	// positions are final for this frame : probes and next frame contacts share the grid
+	UpdateNeighborGrid();
+
 	Draw(); // OK
 }
 
@@ -120,16 +126,91 @@ void	SPHMullerFluidSystem::ComputePressure()
 	}
 }
 
+void	SPHMullerFluidSystem::UpdateNeighborGrid()
+{
+	neighborGridDirty = false;
+
+	if (particles.empty())
+	{
+		neighborGridSize = Vec2Int::Zero();
+		neighborCellStarts.assign(1, 0);
+		neighborParticles.clear();
+		return;
+	}
+
+	AABB bounds(particles[0].position, particles[0].position);
+	for (const Particle& particle : particles)
+	{
+		bounds.EnlargeWithPoint(particle.position);
+	}
+
+	// cells must be at least radius wide for the 3x3 cells search, make them bigger if particles are too spread out
+	size_t maxCellCount = Max<size_t>(1024, particles.size() * 4);
+	neighborCellSize = radius;
+	Vec2 extent = bounds.pMax - bounds.pMin;
+	while ((extent.x / neighborCellSize + 1) * (extent.y / neighborCellSize + 1) > maxCellCount)
+	{
+		neighborCellSize *= 2.f;
+	}
+
+	neighborGridMin = bounds.pMin;
+	neighborGridSize = (extent / neighborCellSize).Floor() + Vec2Int::One();
+
+	// counting sort of the particles per cell
+	neighborCellStarts.assign(neighborGridSize.Product() + 1, 0);
+	particleCells.resize(particles.size());
+	for (size_t i = 0; i < particles.size(); i++)
+	{
+		Vec2Int coords = GetNeighborCellCoords(particles[i].position);
+		int cell = coords.x + coords.y * neighborGridSize.x;
+		particleCells[i] = cell;
+		neighborCellStarts[cell + 1]++;
+	}
+
+	for (size_t cell = 1; cell < neighborCellStarts.size(); cell++)
+	{
+		neighborCellStarts[cell] += neighborCellStarts[cell - 1];
+	}
+
+	neighborParticles.resize(particles.size());
+	for (size_t i = 0; i < particles.size(); i++)
+	{
+		// neighborCellStarts[cell] is used as insertion cursor, it is shifted back to the start of the next cell
+		neighborParticles[neighborCellStarts[particleCells[i]]++] = int(i);
+	}
+
+	for (size_t cell = neighborCellStarts.size() - 1; cell > 0; cell--)
+	{
+		neighborCellStarts[cell] = neighborCellStarts[cell - 1];
+	}
+	neighborCellStarts[0] = 0;
+}
+
+Vec2Int SPHMullerFluidSystem::GetNeighborCellCoords(const Vec2& pos) const
+{
+	Vec2Int coords = ((pos - neighborGridMin) / neighborCellSize).Floor();
+	coords.x = Clamp(coords.x, 0, neighborGridSize.x - 1);
+	coords.y = Clamp(coords.y, 0, neighborGridSize.y - 1);
+	return coords;
+}
+
 void	SPHMullerFluidSystem::UpdateContacts()
 {
 	contacts.clear();
-	contacts.reserve(Sqr(particles.size()));
+
+	if (neighborGridDirty)
+	{
+		UpdateNeighborGrid();
+	}
 
 	for (int i = 0; i < particles.size(); i++)
 	{
 		Particle& p1 = particles[i];
-		for (int j = i + 1; j < particles.size(); j++)
+		ForEachParticleAround(p1.position, [&](int j)
 		{
+			if (j <= i)
+				return;
+
 			Particle& p2 = particles[j];
 			
 			float sqrLength = (p1.position - p2.position).GetSqrLength();
@@ -142,8 +223,61 @@ void	SPHMullerFluidSystem::UpdateContacts()
 
 				contacts.push_back(contact);
 			}
-		}
+		});
+	}
+}
+
+void	SPHMullerFluidSystem::Probe(const std::vector<Vec2>& points, FluidProbeResults& results)
+{
+	if (neighborGridDirty)
+	{
+		UpdateNeighborGrid();
 	}
+
+	results.Resize(points.size());
+
+	const float mass = GetMass();
+
+	ParallelFor(points.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vec2& point = points[i];
+
+			// Shepard normalized interpolation for pressure and velocity, so values don't fade near the surface
+			float density = 0.f;
+			float weightSum = 0.f;
+			float pressure = 0.f;
+			Vec2 velocity = Vec2::Zero();
+
+			ForEachParticleAround(point, [&](int j)
+			{
+				const Particle& particle = particles[j];
+				float sqrLength = (point - particle.position).GetSqrLength();
+				if (sqrLength >= Sqr(radius))
+					return;
+
+				float weight = mass * KernelDefault(sqrt(sqrLength), radius);
+				density += weight;
+
+				float volumeWeight = weight / particle.density;
+				weightSum += volumeWeight;
+				pressure += particle.pressure * volumeWeight;
+				velocity += particle.velocity * volumeWeight;
+			});
+
+			if (weightSum > 0.f)
+			{
+				pressure /= weightSum;
+				velocity /= weightSum;
+			}
+
+			results.densities[i] = density;
+			results.pressures[i] = pressure;
+			results.velocitiesX[i] = velocity.x;
+			results.velocitiesY[i] = velocity.y;
+		}
+	});
 }
 
 void	SPHMullerFluidSystem::ResetAcceleration()
@@ -227,6 +361,8 @@ void	SPHMullerFluidSystem::Integrate(float deltaTime)
 
 		particle.position += particle.velocity * deltaTime;
 	}
+
+	neighborGridDirty = true;
 }
 
 void	SPHMullerFluidSystem::BorderCollisions()
@@ -36,6 +36,15 @@ class SPHMullerFluidSystem : public IFluidSystem
 		std::vector<Particle> particles;
 		CFluidMesh	mesh;
 
+		// Neighbor grid : particle indices sorted per cell (counting sort), cells are at least radius wide
+		Vec2 neighborGridMin;
+		Vec2Int neighborGridSize;
+		float neighborCellSize = 0.f;
+		std::vector<int> neighborCellStarts; // particles of cell i are neighborParticles[neighborCellStarts[i], neighborCellStarts[i + 1]]
+		std::vector<int> neighborParticles;
+		std::vector<int> particleCells;
+		bool neighborGridDirty = true;
+
 	public:
 		std::shared_ptr<Fluid> defaultFluid = std::make_shared<Fluid>(GetAir());
 		float restDensity = 0.59f;
@@ -47,9 +56,32 @@ class SPHMullerFluidSystem : public IFluidSystem
 		void AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec2 worldPosition, Vec2 Velocity, float radius) override;
 		void RemoveFluidAt(Vec2 worldPosition, float radius) override;
 		void Update(float deltaTime) override;
+		void Probe(const std::vector<Vec2>& points, FluidProbeResults& results) override;
 		void Draw();
 
 	private:
+		void	UpdateNeighborGrid();
+
+		Vec2Int	GetNeighborCellCoords(const Vec2& pos) const;
+
+		// Calls functor(particleIndex) for every particle in the cells overlapping the radius around pos
+		template<typename TFunctor>
+		void	ForEachParticleAround(const Vec2& pos, TFunctor&& functor) const
+		{
+			Vec2Int coords = GetNeighborCellCoords(pos);
+			for (int y = Max(0, coords.y - 1); y <= Min(neighborGridSize.y - 1, coords.y + 1); y++)
+			{
+				for (int x = Max(0, coords.x - 1); x <= Min(neighborGridSize.x - 1, coords.x + 1); x++)
+				{
+					int cell = x + y * neighborGridSize.x;
+					for (int i = neighborCellStarts[cell]; i < neighborCellStarts[cell + 1]; i++)
+					{
+						functor(neighborParticles[i]);
+					}
+				}
+			}
+		}
+
 		void	UpdateContacts();
 		void	ComputeDensity();
 		void	ComputePressure();
@@ -0,0 +1,712 @@
+#include "TiledEulerFluidSystem.hpp"
+
+#include "Fluids/OOP/GridSampling.hpp"
+#include "GlobalVariables.h"
+#include "Parallel.h"
+#include "Renderer.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+	using Tile = TiledEulerFluidSystem::Tile;
+	constexpr int tileSize = TiledEulerFluidSystem::tileSize;
+
+	// Value of the cell on the left of tile cell (x, y), in the left tile when x == 0.
+	// The found tile is nullptr when the cell is not allocated (the edge between them is a wall).
+	template<typename TArray>
+	inline const Tile* GetLeftCell(const Tile& tile, int x, int y, TArray array, float& value)
+	{
+		const Tile* neighbor = x > 0 ? &tile : tile.left;
+		value = neighbor ? (neighbor->*array)[((x + tileSize - 1) % tileSize) + y * tileSize] : 0.f;
+		return neighbor;
+	}
+
+	template<typename TArray>
+	inline const Tile* GetDownCell(const Tile& tile, int x, int y, TArray array, float& value)
+	{
+		const Tile* neighbor = y > 0 ? &tile : tile.down;
+		value = neighbor ? (neighbor->*array)[x + ((y + tileSize - 1) % tileSize) * tileSize] : 0.f;
+		return neighbor;
+	}
+
+	// Velocity of the edges on the right and above tile cell (x, y), owned by the next cells
+	inline float GetRightEdgeVelocity(const Tile& tile, int x, int y)
+	{
+		const Tile* neighbor = x < tileSize - 1 ? &tile : tile.right;
+		return neighbor ? neighbor->Current().horizontalVelocities[((x + 1) % tileSize) + y * tileSize] : 0.f;
+	}
+
+	inline float GetUpEdgeVelocity(const Tile& tile, int x, int y)
+	{
+		const Tile* neighbor = y < tileSize - 1 ? &tile : tile.up;
+		return neighbor ? neighbor->Current().verticalVelocities[x + ((y + 1) % tileSize) * tileSize] : 0.f;
+	}
+
+	void ResetTileFields(TiledEulerFluidSystem::TileFields& fields)
+	{
+		std::fill(std::begin(fields.materials), std::end(fields.materials), uint8_t(0));
+		std::fill(std::begin(fields.fractions), std::end(fields.fractions), 1.f);
+		std::fill(std::begin(fields.horizontalVelocities), std::end(fields.horizontalVelocities), 0.f);
+		std::fill(std::begin(fields.verticalVelocities), std::end(fields.verticalVelocities), 0.f);
+	}
+}
+
+template<typename TFunctor>
+void TiledEulerFluidSystem::ForEachActiveTile(TFunctor&& functor)
+{
+	ParallelFor(activeTiles.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			functor(GetActiveTile(i));
+		}
+	});
+}
+
+void TiledEulerFluidSystem::Reset(Vec newWorldPosition, VecInt newCellsCount, Vec newCellSize)
+{
+	worldPosition = newWorldPosition;
+	cellSize = newCellSize;
+
+	tilesCount = VecInt{ (newCellsCount.x + tileSize - 1) / tileSize, (newCellsCount.y + tileSize - 1) / tileSize };
+	cellsCount = VecInt{ tilesCount.x * tileSize, tilesCount.y * tileSize };
+
+	tileMap.assign(tilesCount.Product(), -1);
+	wantedTiles.assign(tilesCount.Product(), 0);
+	wantedTilesList.clear();
+
+	freeTiles.clear();
+	for (int i = int(tilePool.size()) - 1; i >= 0; i--)
+	{
+		freeTiles.push_back(i);
+	}
+	activeTiles.clear();
+	activeTilesDirty = false;
+	solverDomainDirty = true;
+
+	m_mesh.pointSize = newCellSize.x * 50;
+}
+
+TiledEulerFluidSystem::Tile& TiledEulerFluidSystem::AllocateTile(int tileIndex)
+{
+	if (tileMap[tileIndex] >= 0)
+	{
+		return *tilePool[tileMap[tileIndex]];
+	}
+
+	int poolIndex;
+	if (freeTiles.empty())
+	{
+		poolIndex = int(tilePool.size());
+		tilePool.push_back(std::make_unique<Tile>());
+	}
+	else
+	{
+		poolIndex = freeTiles.back();
+		freeTiles.pop_back();
+	}
+
+	Tile& tile = *tilePool[poolIndex];
+	tile.coords = VecInt{ tileIndex % tilesCount.x, tileIndex / tilesCount.x };
+	tile.quietFrames = 0;
+	tile.current = 0;
+	ResetTileFields(tile.fields[0]);
+	ResetTileFields(tile.fields[1]);
+	std::fill(std::begin(tile.pressures), std::end(tile.pressures), 0.f);
+
+	tileMap[tileIndex] = poolIndex;
+	activeTilesDirty = true;
+	return tile;
+}
+
+void TiledEulerFluidSystem::FreeTile(int tileIndex)
+{
+	freeTiles.push_back(tileMap[tileIndex]);
+	tileMap[tileIndex] = -1;
+	activeTilesDirty = true;
+}
+
+void TiledEulerFluidSystem::RebuildActiveTiles()
+{
+	activeTiles.clear();
+	for (int poolIndex = 0; poolIndex < int(tilePool.size()); poolIndex++)
+	{
+		const Tile& tile = *tilePool[poolIndex];
+		if (tileMap[tile.coords.x + tile.coords.y * tilesCount.x] == poolIndex)
+		{
+			activeTiles.push_back(poolIndex);
+		}
+	}
+
+	// tile order, so that the solver sums don't depend on the allocation history
+	std::sort(activeTiles.begin(), activeTiles.end(), [this](int a, int b)
+	{
+		const VecInt& coordsA = tilePool[a]->coords;
+		const VecInt& coordsB = tilePool[b]->coords;
+		return coordsA.x + coordsA.y * tilesCount.x < coordsB.x + coordsB.y * tilesCount.x;
+	});
+
+	auto getTile = [this](int x, int y) -> Tile*
+	{
+		if (x < 0 || y < 0 || x >= tilesCount.x || y >= tilesCount.y)
+			return nullptr;
+		int poolIndex = tileMap[x + y * tilesCount.x];
+		return poolIndex >= 0 ? tilePool[poolIndex].get() : nullptr;
+	};
+
+	for (int poolIndex : activeTiles)
+	{
+		Tile& tile = *tilePool[poolIndex];
+		tile.left = getTile(tile.coords.x - 1, tile.coords.y);
+		tile.right = getTile(tile.coords.x + 1, tile.coords.y);
+		tile.down = getTile(tile.coords.x, tile.coords.y - 1);
+		tile.up = getTile(tile.coords.x, tile.coords.y + 1);
+	}
+
+	activeTilesDirty = false;
+	solverDomainDirty = true;
+}
+
+void TiledEulerFluidSystem::UpdateActiveTiles()
+{
+	if (activeTilesDirty)
+	{
+		RebuildActiveTiles();
+	}
+
+	// a tile is busy when it holds fluid or motion
+	ForEachActiveTile([&](Tile& tile)
+	{
+		const TileFields& fields = tile.Current();
+		bool busy = false;
+		for (int i = 0; i < tileCellsCount && !busy; i++)
+		{
+			busy = (fields.materials[i] != 0 && fields.fractions[i] > minFluidFraction)
+				|| fabsf(fields.horizontalVelocities[i]) > quietVelocity
+				|| fabsf(fields.verticalVelocities[i]) > quietVelocity;
+		}
+		tile.quietFrames = busy ? 0 : tile.quietFrames + 1;
+	});
+
+	// busy tiles and their neighbors are wanted, so that fluid always has allocated tiles to move to
+	for (int poolIndex : activeTiles)
+	{
+		const Tile& tile = *tilePool[poolIndex];
+		if (tile.quietFrames > 0)
+			continue;
+
+		for (int y = Max(0, tile.coords.y - 1); y <= Min(tilesCount.y - 1, tile.coords.y + 1); y++)
+		{
+			for (int x = Max(0, tile.coords.x - 1); x <= Min(tilesCount.x - 1, tile.coords.x + 1); x++)
+			{
+				int tileIndex = x + y * tilesCount.x;
+				if (!wantedTiles[tileIndex])
+				{
+					wantedTiles[tileIndex] = 1;
+					wantedTilesList.push_back(tileIndex);
+				}
+			}
+		}
+	}
+
+	for (int poolIndex : activeTiles)
+	{
+		Tile& tile = *tilePool[poolIndex];
+		int tileIndex = tile.coords.x + tile.coords.y * tilesCount.x;
+		if (wantedTiles[tileIndex])
+		{
+			tile.quietFrames = 0;
+		}
+		else if (tile.quietFrames >= quietFramesBeforeFree)
+		{
+			FreeTile(tileIndex);
+		}
+	}
+
+	for (int tileIndex : wantedTilesList)
+	{
+		AllocateTile(tileIndex);
+		wantedTiles[tileIndex] = 0;
+	}
+	wantedTilesList.clear();
+
+	if (activeTilesDirty)
+	{
+		RebuildActiveTiles();
+	}
+}
+
+void TiledEulerFluidSystem::AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius)
+{
+	Vec relativePos = fluidWorldPosition - worldPosition;
+
+	VecInt indices = (relativePos / cellSize).Floor();
+	Vec2Int offset = (radius / cellSize).Floor();
+	uint8_t material = fluids.GetMaterial(fluid);
+
+	for (int y = Max(0, indices.y - offset.y); y < Min(cellsCount.y, indices.y + offset.y); y++)
+	{
+		for (int x = Max(0, indices.x - offset.x); x < Min(cellsCount.x, indices.x + offset.x); x++)
+		{
+			int tileIndex = (x / tileSize) + (y / tileSize) * tilesCount.x;
+			if (material == 0 && tileMap[tileIndex] < 0)
+			{
+				continue; // not allocated tiles are already empty
+			}
+
+			TileFields& fields = AllocateTile(tileIndex).Current();
+			int cellIndex = (x % tileSize) + (y % tileSize) * tileSize;
+			fields.materials[cellIndex] = material;
+			fields.fractions[cellIndex] = 1.f;
+		}
+	}
+}
+
+void TiledEulerFluidSystem::RemoveFluidAt(Vec2 fluidWorldPosition, float radius)
+{
+	AddFluidAt(defaultFluid, fluidWorldPosition, Vec::Zero(), radius);
+}
+
+void TiledEulerFluidSystem::ApplyForces(float deltaTime)
+{
+	// same forces as EulerFluidSystem
+	const Vec acceleration = Vec{ 3, -9.8 } *0.01;
+	ForEachActiveTile([&](Tile& tile)
+	{
+		TileFields& fields = tile.Current();
+		std::fill(std::begin(fields.horizontalVelocities), std::end(fields.horizontalVelocities), acceleration.x);
+		std::fill(std::begin(fields.verticalVelocities), std::end(fields.verticalVelocities), acceleration.y);
+	});
+}
+
+void TiledEulerFluidSystem::UpdateSolverDomain()
+{
+	if (!solverDomainDirty)
+	{
+		return;
+	}
+	solverDomainDirty = false;
+
+	// groups found by flood fill through the neighbor tiles, in the order of their first tile so that they are stable
+	tilesSolverGroups.assign(tilePool.size(), -1);
+	solverGroupsCount = 0;
+	for (int firstTile : activeTiles)
+	{
+		if (tilesSolverGroups[firstTile] >= 0)
+			continue;
+
+		int groupIndex = int(solverGroupsCount++);
+		if (solverGroups.size() < solverGroupsCount)
+		{
+			solverGroups.push_back(std::make_unique<SolverGroup>());
+		}
+		SolverGroup& group = *solverGroups[groupIndex];
+		group.tiles.clear();
+
+		tilesSolverGroups[firstTile] = groupIndex;
+		groupSearchStack.push_back(firstTile);
+		while (!groupSearchStack.empty())
+		{
+			int poolIndex = groupSearchStack.back();
+			groupSearchStack.pop_back();
+			group.tiles.push_back(poolIndex);
+
+			const Tile& tile = *tilePool[poolIndex];
+			for (const Tile* neighbor : { tile.left, tile.right, tile.down, tile.up })
+			{
+				if (!neighbor)
+					continue;
+
+				int neighborPoolIndex = tileMap[neighbor->coords.x + neighbor->coords.y * tilesCount.x];
+				if (tilesSolverGroups[neighborPoolIndex] < 0)
+				{
+					tilesSolverGroups[neighborPoolIndex] = groupIndex;
+					groupSearchStack.push_back(neighborPoolIndex);
+				}
+			}
+		}
+
+		std::sort(group.tiles.begin(), group.tiles.end(), [this](int a, int b)
+		{
+			const VecInt& coordsA = tilePool[a]->coords;
+			const VecInt& coordsB = tilePool[b]->coords;
+			return coordsA.x + coordsA.y * tilesCount.x < coordsB.x + coordsB.y * tilesCount.x;
+		});
+		UpdateSolverGroup(group, groupIndex);
+	}
+}
+
+void TiledEulerFluidSystem::UpdateSolverGroup(SolverGroup& group, int groupIndex)
+{
+	VecInt tilesMin = tilePool[group.tiles[0]]->coords;
+	VecInt tilesMax = tilesMin;
+	for (int poolIndex : group.tiles)
+	{
+		const VecInt& coords = tilePool[poolIndex]->coords;
+		tilesMin = VecInt{ Min(tilesMin.x, coords.x), Min(tilesMin.y, coords.y) };
+		tilesMax = VecInt{ Max(tilesMax.x, coords.x), Max(tilesMax.y, coords.y) };
+	}
+
+	VecInt newTilesCount = VecInt{ tilesMax.x - tilesMin.x + 1, tilesMax.y - tilesMin.y + 1 };
+	VecInt count = VecInt{ newTilesCount.x * tileSize, newTilesCount.y * tileSize };
+	if (!(newTilesCount == group.tilesCount) || !(tilesMin == group.tilesMin))
+	{
+		// the solution layout changed, it is gathered from the tiles again
+		group.tilesMin = tilesMin;
+		group.tilesCount = newTilesCount;
+		group.solver.Resize(count, cellSize);
+		group.rhs.assign(count.Product(), 0.f);
+		group.solution.assign(count.Product(), 0.f);
+	}
+
+	// the tiles of other groups in the box are closed as the free ones
+	auto isInGroup = [&](int x, int y)
+	{
+		int poolIndex = tileMap[(group.tilesMin.x + x / tileSize) + (group.tilesMin.y + y / tileSize) * tilesCount.x];
+		return poolIndex >= 0 && tilesSolverGroups[poolIndex] == groupIndex;
+	};
+
+	group.rightWeights.resize((count.x - 1) * count.y);
+	for (int y = 0; y < count.y; y++)
+	{
+		for (int x = 0; x < count.x - 1; x++)
+		{
+			group.rightWeights[x + y * (count.x - 1)] = (isInGroup(x, y) && isInGroup(x + 1, y)) ? 1.f : 0.f;
+		}
+	}
+
+	group.upWeights.resize(count.x * (count.y - 1));
+	for (int y = 0; y < count.y - 1; y++)
+	{
+		for (int x = 0; x < count.x; x++)
+		{
+			group.upWeights[x + y * count.x] = (isInGroup(x, y) && isInGroup(x, y + 1)) ? 1.f : 0.f;
+		}
+	}
+
+	group.solver.SetEdgeWeights(group.rightWeights, group.upWeights);
+}
+
+void TiledEulerFluidSystem::Projection(float deltaTime)
+{
+	// Edges between allocated and free tiles are walls
+	ForEachActiveTile([&](Tile& tile)
+	{
+		TileFields& fields = tile.Current();
+		if (!tile.left)
+		{
+			for (int y = 0; y < tileSize; y++)
+				fields.horizontalVelocities[y * tileSize] = 0.f;
+		}
+		if (!tile.down)
+		{
+			for (int x = 0; x < tileSize; x++)
+				fields.verticalVelocities[x] = 0.f;
+		}
+	});
+
+	UpdateSolverDomain();
+	lastSolveStats = PressureSolveStats();
+	lastSolveStats.converged = true;
+
+	for (size_t groupIndex = 0; groupIndex < solverGroupsCount; groupIndex++)
+	{
+		SolverGroup& group = *solverGroups[groupIndex];
+
+		// A * pressure = -divergence, cells out of the group stay at 0 and are left out of the solve
+		std::fill(group.rhs.begin(), group.rhs.end(), 0.f);
+		ParallelFor(group.tiles.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const Tile& tile = *tilePool[group.tiles[i]];
+				const TileFields& fields = tile.Current();
+				for (int y = 0; y < tileSize; y++)
+				{
+					for (int x = 0; x < tileSize; x++)
+					{
+						int index = x + y * tileSize;
+						float divergence = (GetRightEdgeVelocity(tile, x, y) - fields.horizontalVelocities[index]) / cellSize.x
+							+ (GetUpEdgeVelocity(tile, x, y) - fields.verticalVelocities[index]) / cellSize.y;
+
+						int solverIndex = GetSolverCellIndex(group, tile, index);
+						group.rhs[solverIndex] = -divergence;
+						group.solution[solverIndex] = tile.pressures[index]; // warm start
+					}
+				}
+			}
+		});
+
+		group.solver.tolerance = tolerance;
+		group.solver.maxIterations = maxIterations;
+		PressureSolveStats stats = group.solver.Solve(pressureSolver, group.rhs, group.solution);
+		lastSolveStats.iterations = Max(lastSolveStats.iterations, stats.iterations);
+		lastSolveStats.initialResidual = Max(lastSolveStats.initialResidual, stats.initialResidual);
+		lastSolveStats.finalResidual = Max(lastSolveStats.finalResidual, stats.finalResidual);
+		lastSolveStats.duration += stats.duration;
+		lastSolveStats.converged = lastSolveStats.converged && stats.converged;
+
+		ParallelFor(group.tiles.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Tile& tile = *tilePool[group.tiles[i]];
+				for (int index = 0; index < tileCellsCount; index++)
+				{
+					tile.pressures[index] = group.solution[GetSolverCellIndex(group, tile, index)];
+				}
+			}
+		});
+	}
+
+	// velocity -= gradient(pressure) on the open edges
+	ForEachActiveTile([&](Tile& tile)
+	{
+		TileFields& fields = tile.Current();
+		for (int y = 0; y < tileSize; y++)
+		{
+			for (int x = 0; x < tileSize; x++)
+			{
+				int index = x + y * tileSize;
+				float left, down;
+				if (GetLeftCell(tile, x, y, &Tile::pressures, left))
+				{
+					fields.horizontalVelocities[index] -= (tile.pressures[index] - left) / cellSize.x;
+				}
+				if (GetDownCell(tile, x, y, &Tile::pressures, down))
+				{
+					fields.verticalVelocities[index] -= (tile.pressures[index] - down) / cellSize.y;
+				}
+			}
+		}
+	});
+
+	lastDeltaTime = deltaTime;
+}
+
+TiledEulerFluidSystem::Vec TiledEulerFluidSystem::Backtrace(Vec worldPos, float deltaTime) const
+{
+	// midpoint (RK2) integration, backward in time
+	Vec midPos = worldPos - SampleVelocity(worldPos) * (deltaTime * 0.5f);
+	return worldPos - SampleVelocity(midPos) * deltaTime;
+}
+
+void TiledEulerFluidSystem::Advection(float deltaTime)
+{
+	// Same semi-Lagrangian advection as EulerFluidSystem, tile by tile
+	ForEachActiveTile([&](Tile& tile)
+	{
+		TileFields& next = tile.Next();
+		const VecInt origin = VecInt{ tile.coords.x * tileSize, tile.coords.y * tileSize };
+
+		for (int y = 0; y < tileSize; y++)
+		{
+			for (int x = 0; x < tileSize; x++)
+			{
+				int index = x + y * tileSize;
+				const VecInt cell = VecInt{ origin.x + x, origin.y + y };
+
+				Vec sourcePos = Backtrace(worldPosition + (Vec2(cell) + Vec(0.5f, 0.5f)) * cellSize, deltaTime);
+				BilinearStencil stencil((sourcePos - worldPosition) / cellSize - Vec(0.5f, 0.5f), cellsCount);
+
+				// interpolated material fraction of each corner fluid, the cell keeps the fluid with the biggest one
+				const uint8_t materials[4] = { GetCellMaterial(stencil.x0, stencil.y0), GetCellMaterial(stencil.x1, stencil.y0),
+											GetCellMaterial(stencil.x0, stencil.y1), GetCellMaterial(stencil.x1, stencil.y1) };
+				const float fractions[4] = { GetCellFraction(stencil.x0, stencil.y0), GetCellFraction(stencil.x1, stencil.y0),
+											GetCellFraction(stencil.x0, stencil.y1), GetCellFraction(stencil.x1, stencil.y1) };
+				const float weights[4] = { (1.f - stencil.tx) * (1.f - stencil.ty), stencil.tx * (1.f - stencil.ty),
+										(1.f - stencil.tx) * stencil.ty, stencil.tx * stencil.ty };
+
+				uint8_t bestMaterial = 0;
+				float bestFraction = 0.f;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					if (materials[corner] == 0)
+						continue;
+
+					float fraction = 0.f;
+					for (int other = 0; other < 4; other++)
+					{
+						if (materials[other] == materials[corner])
+						{
+							fraction += weights[other] * fractions[other];
+						}
+					}
+
+					if (fraction > bestFraction)
+					{
+						bestFraction = fraction;
+						bestMaterial = materials[corner];
+					}
+				}
+
+				if (bestMaterial != 0 && bestFraction > minFluidFraction)
+				{
+					next.materials[index] = bestMaterial;
+					next.fractions[index] = Min(bestFraction, 1.f);
+				}
+				else
+				{
+					next.materials[index] = 0;
+					next.fractions[index] = 1.f;
+				}
+
+				// walls stay closed
+				bool leftOpen = (x > 0 || tile.left);
+				bool downOpen = (y > 0 || tile.down);
+
+				Vec leftEdgePos = worldPosition + Vec(float(cell.x), float(cell.y) + 0.5f) * cellSize;
+				next.horizontalVelocities[index] = leftOpen ? SampleHorizontalVelocity(Backtrace(leftEdgePos, deltaTime)) : 0.f;
+
+				Vec downEdgePos = worldPosition + Vec(float(cell.x) + 0.5f, float(cell.y)) * cellSize;
+				next.verticalVelocities[index] = downOpen ? SampleVerticalVelocity(Backtrace(downEdgePos, deltaTime)) : 0.f;
+			}
+		}
+	});
+
+	ForEachActiveTile([](Tile& tile)
+	{
+		tile.current = 1 - tile.current;
+	});
+}
+
+void TiledEulerFluidSystem::Update(float deltaTime)
+{
+	UpdateActiveTiles();
+
+	ApplyForces(deltaTime);
+
+	Projection(deltaTime);
+
+	gVars->pRenderer->DisplayText("Tiled Euler : " + std::to_string(activeTiles.size()) + " / " + std::to_string(tilesCount.Product()) + " tiles"
+		+ " in " + std::to_string(solverGroupsCount) + " groups"
+		+ ", " + GetPressureSolverName(pressureSolver) + " iterations : " + std::to_string(lastSolveStats.iterations)
+		+ ", residual : " + std::to_string(lastSolveStats.initialResidual) + " -> " + std::to_string(lastSolveStats.finalResidual)
+		+ (lastSolveStats.converged ? "" : " (not converged)")
+		+ ", " + std::to_string(lastSolveStats.duration) + " ms");
+
+	Advection(deltaTime);
+
+	Draw();
+}
+
+uint8_t TiledEulerFluidSystem::GetCellMaterial(int x, int y) const
+{
+	const Tile* tile = GetTileOfCell(x, y);
+	return tile ? tile->Current().materials[(x % tileSize) + (y % tileSize) * tileSize] : uint8_t(0);
+}
+
+float TiledEulerFluidSystem::GetCellFraction(int x, int y) const
+{
+	const Tile* tile = GetTileOfCell(x, y);
+	return tile ? tile->Current().fractions[(x % tileSize) + (y % tileSize) * tileSize] : 1.f;
+}
+
+float TiledEulerFluidSystem::GetCellPressure(int x, int y) const
+{
+	const Tile* tile = GetTileOfCell(x, y);
+	return tile ? tile->pressures[(x % tileSize) + (y % tileSize) * tileSize] : 0.f;
+}
+
+float TiledEulerFluidSystem::GetHorizontalVelocity(int x, int y) const
+{
+	const Tile* tile = GetTileOfCell(x, y);
+	if (!tile || (x % tileSize == 0 && !tile->left))
+		return 0.f;
+	return tile->Current().horizontalVelocities[(x % tileSize) + (y % tileSize) * tileSize];
+}
+
+float TiledEulerFluidSystem::GetVerticalVelocity(int x, int y) const
+{
+	const Tile* tile = GetTileOfCell(x, y);
+	if (!tile || (y % tileSize == 0 && !tile->down))
+		return 0.f;
+	return tile->Current().verticalVelocities[(x % tileSize) + (y % tileSize) * tileSize];
+}
+
+float TiledEulerFluidSystem::SampleDensity(Vec worldPos) const
+{
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, cellsCount, [this](int x, int y)
+	{
+		float fraction = GetCellFraction(x, y);
+		return fluids[GetCellMaterial(x, y)]->volumicMass * fraction + fluids[0]->volumicMass * (1.f - fraction);
+	});
+}
+
+float TiledEulerFluidSystem::SamplePressure(Vec worldPos) const
+{
+	float density = 1.f;
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.5f);
+	return SampleBilinear(coords, cellsCount, [this](int x, int y)
+	{
+		return GetCellPressure(x, y);
+	}) * density / lastDeltaTime;
+}
+
+float TiledEulerFluidSystem::SampleHorizontalVelocity(Vec worldPos) const
+{
+	// horizontal velocities are at the middle of the left edges
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.f, 0.5f);
+	return SampleBilinear(coords, VecInt{ cellsCount.x + 1, cellsCount.y }, [this](int x, int y)
+	{
+		return GetHorizontalVelocity(x, y);
+	});
+}
+
+float TiledEulerFluidSystem::SampleVerticalVelocity(Vec worldPos) const
+{
+	// vertical velocities are at the middle of the bottom edges
+	Vec coords = (worldPos - worldPosition) / cellSize - Vec(0.5f, 0.f);
+	return SampleBilinear(coords, VecInt{ cellsCount.x, cellsCount.y + 1 }, [this](int x, int y)
+	{
+		return GetVerticalVelocity(x, y);
+	});
+}
+
+TiledEulerFluidSystem::Vec TiledEulerFluidSystem::SampleVelocity(Vec worldPos) const
+{
+	return Vec(SampleHorizontalVelocity(worldPos), SampleVerticalVelocity(worldPos));
+}
+
+void TiledEulerFluidSystem::Probe(const std::vector<Vec2>& points, FluidProbeResults& results)
+{
+	results.Resize(points.size());
+
+	ParallelFor(points.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Vec velocity = SampleVelocity(points[i]);
+			results.densities[i] = SampleDensity(points[i]);
+			results.pressures[i] = SamplePressure(points[i]);
+			results.velocitiesX[i] = velocity.x;
+			results.velocitiesY[i] = velocity.y;
+		}
+	});
+}
+
+void TiledEulerFluidSystem::Draw()
+{
+	// only allocated tiles are drawn, the others are empty
+	m_mesh.Fill(activeTiles.size() * tileCellsCount, [&](size_t iVertex, float& x, float& y, float& r, float& g, float& b)
+	{
+		const Tile& tile = *tilePool[activeTiles[iVertex / tileCellsCount]];
+		int index = int(iVertex % tileCellsCount);
+
+		Vec2 pos = worldPosition + Vec2(float(tile.coords.x * tileSize + index % tileSize), float(tile.coords.y * tileSize + index / tileSize)) * cellSize;
+		x = pos.x;
+		y = pos.y;
+
+		const TileFields& fields = tile.Current();
+		const Fluid& fluid = *fluids[fields.fractions[index] >= 0.5f ? fields.materials[index] : 0];
+		r = fluid.color.x;
+		g = fluid.color.y;
+		b = fluid.color.z;
+	});
+
+	m_mesh.Draw();
+}
@@ -0,0 +1,190 @@
+#ifndef _OOP_TILED_EULER_FLUID_SYSTEM_HPP_
+#define _OOP_TILED_EULER_FLUID_SYSTEM_HPP_
+
+#include "Maths.h"
+#include "Fluids/OOP/FluidSystem.hpp"
+#include "Fluids/OOP/Fluid.hpp"
+#include "Fluids/OOP/FluidsTable.hpp"
+#include "Fluids/OOP/PoissonSolver.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FluidMesh.h"
+
+// Sparse version of EulerFluidSystem : the grid is cut in tiles of tileSize x tileSize cells, only allocated where there is fluid or motion
+// (plus one tile around them), so that the cost follows the fluid volume instead of the domain area.
+// Same MAC discretization, each cell owning the edges on its left and below it. Borders of the allocated region are walls, like the domain borders.
+class TiledEulerFluidSystem : public IFluidSystem
+{
+	using Vec = Vec2;
+	using VecInt = Vec2Int;
+
+public:
+	static constexpr int tileSize = 16;
+	static constexpr int tileCellsCount = tileSize * tileSize;
+
+	// Tile cell (x, y) is at x + y * tileSize
+	struct TileFields
+	{
+		uint8_t materials[tileCellsCount]; // index in fluids
+		float fractions[tileCellsCount]; // part of the cell filled by its material, the rest being defaultFluid
+		float horizontalVelocities[tileCellsCount]; // edge on the left of each cell
+		float verticalVelocities[tileCellsCount]; // edge below each cell
+	};
+
+	struct Tile
+	{
+		VecInt coords; // in tiles
+		int quietFrames = 0;
+
+		// neighbor tiles, nullptr when not allocated
+		Tile* left = nullptr;
+		Tile* right = nullptr;
+		Tile* down = nullptr;
+		Tile* up = nullptr;
+
+		TileFields fields[2]; // current and advected, swapped after each advection
+		int current = 0;
+
+		float pressures[tileCellsCount]; // pressure * deltaTime / density, kept to warm start the next solve
+
+		TileFields& Current() { return fields[current]; }
+		const TileFields& Current() const { return fields[current]; }
+		TileFields& Next() { return fields[1 - current]; }
+	};
+
+	Vec worldPosition; // world pos of bottom left corner
+	VecInt cellsCount; // multiple of tileSize
+	Vec cellSize = Vec::One();
+	VecInt tilesCount;
+
+	std::shared_ptr<Fluid> defaultFluid = std::make_shared<Fluid>(GetAir());
+
+	// Fluids indexed by the materials planes, material 0 is defaultFluid
+	FluidsTable fluids = FluidsTable(defaultFluid);
+
+	float minFluidFraction = 0.01f; // below, advected cells are reset to defaultFluid
+	float quietVelocity = 1e-3f; // tiles without fluid and with edges velocities below are quiet
+	int quietFramesBeforeFree = 30;
+
+	// Pressure is solved on the bounding box of each group of connected allocated tiles, edges towards free tiles being closed,
+	// so that distant splashes don't solve the domain between them. Warm started from last frame pressure.
+	PressureSolverType pressureSolver = PressureSolverType::MultigridPCG;
+	float tolerance = 1e-4f; // on the relative residual |b - Ax| / |b|
+	int maxIterations = 30;
+	PressureSolveStats lastSolveStats; // worst group, durations summed
+
+	void Reset(Vec newWorldPosition, VecInt newCellsCount, Vec newCellSize);
+
+	virtual void AddFluidAt(const std::weak_ptr<struct Fluid>& fluid, Vec fluidWorldPosition, Vec Velocity, float radius) override;
+	virtual void RemoveFluidAt(Vec2 fluidWorldPosition, float radius) override;
+
+	virtual void Update(float deltaTime) override;
+
+	void ApplyForces(float deltaTime);
+	void Projection(float deltaTime);
+	void Advection(float deltaTime);
+
+	// Allocates the tiles around busy tiles, frees the tiles that stayed quiet long enough
+	void UpdateActiveTiles();
+
+	virtual void Probe(const std::vector<Vec2>& points, FluidProbeResults& results) override;
+
+	// Bilinear interpolation of the cell centered fields
+	float SampleDensity(Vec worldPos) const;
+	float SamplePressure(Vec worldPos) const;
+
+	// Bilinear interpolation of the staggered edge velocities, 0 outside of the allocated tiles
+	Vec SampleVelocity(Vec worldPos) const;
+	float SampleHorizontalVelocity(Vec worldPos) const;
+	float SampleVerticalVelocity(Vec worldPos) const;
+
+	// Velocity of the edge on the left of cell (x, y), x in [0, cellsCount.x], 0 on walls
+	float GetHorizontalVelocity(int x, int y) const;
+	// Velocity of the edge below cell (x, y), y in [0, cellsCount.y], 0 on walls
+	float GetVerticalVelocity(int x, int y) const;
+
+	const Tile* GetTileOfCell(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= cellsCount.x || y >= cellsCount.y)
+			return nullptr;
+
+		int poolIndex = tileMap[(x / tileSize) + (y / tileSize) * tilesCount.x];
+		return poolIndex >= 0 ? tilePool[poolIndex].get() : nullptr;
+	}
+
+	size_t GetActiveTilesCount() const
+	{
+		return activeTiles.size();
+	}
+
+	void Draw();
+
+private:
+	std::vector<int> tileMap; // pool index of each tile, -1 when not allocated
+	std::vector<std::unique_ptr<Tile>> tilePool; // freed tiles are kept for reuse
+	std::vector<int> freeTiles;
+	std::vector<int> activeTiles; // pool indices of the allocated tiles, sorted by tile index
+	bool activeTilesDirty = false;
+
+	// tiles wanted by UpdateActiveTiles, cleared after use
+	std::vector<uint8_t> wantedTiles;
+	std::vector<int> wantedTilesList;
+
+	// Connected allocated tiles, solved on their bounding box, the cells of the other tiles in the box being left out of the solve
+	struct SolverGroup
+	{
+		VecInt tilesMin;
+		VecInt tilesCount;
+		std::vector<int> tiles; // pool indices, in tile order
+		PoissonSolver solver;
+		std::vector<float> rightWeights;
+		std::vector<float> upWeights;
+		std::vector<float> rhs;
+		std::vector<float> solution;
+	};
+
+	// the groups are kept with their buffers when there are fewer, so changing the domain only allocates above the largest one so far
+	std::vector<std::unique_ptr<SolverGroup>> solverGroups;
+	size_t solverGroupsCount = 0;
+	bool solverDomainDirty = true;
+	std::vector<int> tilesSolverGroups; // per pool index, -1 for free tiles
+	std::vector<int> groupSearchStack;
+
+	float lastDeltaTime = 1.f / 60.f;
+
+	CFluidMesh	m_mesh;
+
+	Tile& GetActiveTile(size_t activeIndex)
+	{
+		return *tilePool[activeTiles[activeIndex]];
+	}
+
+	Tile& AllocateTile(int tileIndex);
+	void FreeTile(int tileIndex);
+	void RebuildActiveTiles();
+
+	uint8_t GetCellMaterial(int x, int y) const;
+	float GetCellFraction(int x, int y) const;
+	float GetCellPressure(int x, int y) const;
+
+	// World position the fluid at worldPos was at deltaTime ago
+	Vec Backtrace(Vec worldPos, float deltaTime) const;
+
+	// Calls functor(tile) on every allocated tile, in parallel
+	template<typename TFunctor>
+	void ForEachActiveTile(TFunctor&& functor);
+
+	// Finds the groups of connected tiles, resizes their solvers to their bounding boxes and closes the edges outside of their tiles
+	void UpdateSolverDomain();
+	void UpdateSolverGroup(SolverGroup& group, int groupIndex);
+
+	static int GetSolverCellIndex(const SolverGroup& group, const Tile& tile, int cellIndex)
+	{
+		int x = (tile.coords.x - group.tilesMin.x) * tileSize + cellIndex % tileSize;
+		int y = (tile.coords.y - group.tilesMin.y) * tileSize + cellIndex / tileSize;
+		return x + y * group.tilesCount.x * tileSize;
+	}
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "Parallel.h"
+
+CJobSystem::CJobSystem()
+{
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	for (unsigned int i = 1; i < threadCount; ++i)
+	{
+		m_workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+CJobSystem::~CJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void CJobSystem::Run(TJobFunction job, void* context, size_t count, size_t blockSize)
+{
+	std::unique_lock<std::mutex> runLock(m_runMutex, std::try_to_lock);
+	if (!runLock.owns_lock() || m_workers.empty())
+	{
+		job(context, 0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = job;
+		m_context = context;
+		m_count = count;
+		m_blockSize = blockSize;
+		m_nextBlock = 0;
+		m_busyWorkers = m_workers.size();
+		m_generation++;
+	}
+	m_wakeUp.notify_all();
+
+	ProcessBlocks();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_busyWorkers == 0; });
+	m_job = nullptr;
+	m_context = nullptr;
+}
+
+void CJobSystem::ProcessBlocks()
+{
+	size_t blockCount = (m_count + m_blockSize - 1) / m_blockSize;
+	for (size_t block = m_nextBlock++; block < blockCount; block = m_nextBlock++)
+	{
+		size_t begin = block * m_blockSize;
+		size_t end = begin + m_blockSize < m_count ? begin + m_blockSize : m_count;
+		m_job(m_context, begin, end);
+	}
+}
+
+void CJobSystem::WorkerLoop()
+{
+	size_t lastGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [&]() { return m_exit || m_generation != lastGeneration; });
+			if (m_exit)
+			{
+				return;
+			}
+			lastGeneration = m_generation;
+		}
+
+		ProcessBlocks();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyWorkers--;
+		}
+		m_done.notify_one();
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent worker threads used by ParallelFor.
+// Jobs are type erased through a function pointer + context so that dispatching does not allocate.
+class CJobSystem
+{
+public:
+	using TJobFunction = void(*)(void* context, size_t begin, size_t end);
+
+	static CJobSystem& Get()
+	{
+		static CJobSystem instance;
+		return instance;
+	}
+
+	~CJobSystem();
+
+	size_t	GetWorkerCount() const { return m_workers.size() + 1; } // + calling thread
+
+	// Calls job(context, begin, end) on blocks of [0, count), blocks being shared between all workers and the calling thread.
+	// Returns once every block has been processed.
+	void	Run(TJobFunction job, void* context, size_t count, size_t blockSize);
+
+private:
+	CJobSystem();
+	CJobSystem(const CJobSystem&) = delete;
+	CJobSystem& operator=(const CJobSystem&) = delete;
+
+	void	WorkerLoop();
+	void	ProcessBlocks();
+
+	std::vector<std::thread>	m_workers;
+
+	std::mutex					m_mutex;
+	std::condition_variable		m_wakeUp;
+	std::condition_variable		m_done;
+	std::mutex					m_runMutex; // one Run at a time, a Run issued while another one is running is executed serially
+
+	TJobFunction				m_job = nullptr;
+	void*						m_context = nullptr;
+	size_t						m_count = 0;
+	size_t						m_blockSize = 1;
+	std::atomic<size_t>			m_nextBlock{ 0 };
+	size_t						m_busyWorkers = 0;
+	size_t						m_generation = 0;
+	bool						m_exit = false;
+};
+
+// Calls functor(begin, end) on contiguous ranges of [0, count) on every core.
+// Ranges are at least minBlockSize long, so small loops stay on the calling thread.
+template<typename TFunctor>
+void ParallelFor(size_t count, size_t minBlockSize, TFunctor&& functor)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	CJobSystem& jobSystem = CJobSystem::Get();
+
+	if (minBlockSize == 0)
+	{
+		minBlockSize = 1;
+	}
+
+	// a few blocks per worker to balance uneven work
+	size_t blockSize = count / (jobSystem.GetWorkerCount() * 4);
+	if (blockSize < minBlockSize)
+	{
+		blockSize = minBlockSize;
+	}
+
+	if (blockSize >= count)
+	{
+		functor(size_t(0), count);
+		return;
+	}
+
+	using TFunctorType = std::remove_reference_t<TFunctor>;
+	jobSystem.Run([](void* context, size_t begin, size_t end)
+	{
+		(*static_cast<TFunctorType*>(context))(begin, end);
+	}, (void*)&functor, count, blockSize);
+}
+
+#endif
@@ -105,21 +105,25 @@ void	CPhysicEngine::CollisionNarrowPhase()
 	//// Helps stabilisation with gravity
 	//std::sort(m_pairsToCheck.begin(), m_pairsToCheck.end(), [](const SPolygonPair& s1, const SPolygonPair& s2)
 	//{
-	//	float scoreS1 = min(s1.GetpolyA()->Getposition().y, s1.GetpolyB()->Getposition().y);
-	//	float scoreS2 = min(s2.GetpolyA()->Getposition().y, s2.GetpolyB()->Getposition().y);
+	//	const std::vector<CPolygonPtr>& polygons = gVars->pWorld->GetPolygons();
+	//	float scoreS1 = min(polygons[s1.GetbodyA()]->Getposition().y, polygons[s1.GetbodyB()]->Getposition().y);
+	//	float scoreS2 = min(polygons[s2.GetbodyA()]->Getposition().y, polygons[s2.GetbodyB()]->Getposition().y);
 	//	return scoreS1 > scoreS2;
 	//});
 
+	// the polygons are only referenced by the collisions found
+	const std::vector<CPolygonPtr>& worldPolygons = gVars->pWorld->GetPolygons();
 	for (const SPolygonPair& pair : m_pairsToCheck)
 	{
-		SCollision collision;
-		collision.polyA = pair.GetpolyA();
-		collision.polyB = pair.GetpolyB();
-		if (pair.GetpolyA()->CheckCollision(*(pair.GetpolyB()), collision.point, collision.normal, collision.distance)) 
+		const CPolygonPtr& polyA = worldPolygons[pair.GetbodyA()];
+		const CPolygonPtr& polyB = worldPolygons[pair.GetbodyB()];
+		Vec2 point, normal;
+		float distance;
+		if (polyA->CheckCollision(*polyB, point, normal, distance)) 
 		{
-			m_collidingPairs.push_back(collision);
-			pair.GetpolyA()->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
-			pair.GetpolyB()->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
+			m_collidingPairs.push_back(SCollision(polyA, polyB, point, normal, distance));
+			polyA->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
+			polyB->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
 		}
 	}
 }
@@ -130,12 +134,12 @@ void CPhysicEngine::AddPolygon(CPolygonPtr polygon, bool addGravity)
 	{
 		polygon->ApplyForce(Vec2(0, 0), gravity / polygon->invMass);
 	}
-	m_broadPhase->OnObjectAdded(polygon);
+	m_broadPhase.AddPolygon(polygon);
 	m_polygons.push_back(polygon);
 }
 
 void CPhysicEngine::RemovePolygon(CPolygonPtr polygon)
 {
 	m_polygons.erase(std::remove(m_polygons.begin(), m_polygons.end(), polygon), m_polygons.end());
-	m_broadPhase->OnObjectRemoved(polygon);
+	m_broadPhase.RemovePolygon(polygon);
 }
\ No newline at end of file
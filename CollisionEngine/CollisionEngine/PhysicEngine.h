@@ -98,6 +98,34 @@ public:
 	{
 		m_broadPhase.PreviousBroadPhase();
 	}
+	bool SelectBroadPhase(const std::string& name)
+	{
+		return m_broadPhase.SelectBroadPhase(name);
+	}
+
+	void SetParallelBroadPhase(bool parallel)
+	{
+		m_broadPhase.SetParallelPairs(parallel);
+	}
+
+	bool IsBroadPhaseParallel() const
+	{
+		return m_broadPhase.GetParallelPairs();
+	}
+
+	void SetAutoBroadPhase(bool autoSelect)
+	{
+		m_broadPhase.SetAutoSelect(autoSelect);
+	}
+	bool IsBroadPhaseAuto() const
+	{
+		return m_broadPhase.GetAutoSelect();
+	}
+
+	std::vector<SBroadPhaseBenchmarkResult> BenchmarkBroadPhases(int framesCount, float deltaTime)
+	{
+		return m_broadPhase.Benchmark(framesCount, deltaTime);
+	}
 };
 
 #endif
\ No newline at end of file
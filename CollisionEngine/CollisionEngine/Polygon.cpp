@@ -2,6 +2,7 @@
 #include <GL/glu.h>
 
 #include "PhysicEngine.h"
+#include "BroadPhases/MovedPolygons.h"
 #include "NarrowPhases/SeparatingAxisTest.h"
 #include "NarrowPhases/GilbertJohnsonKeerthi.h"
 #include "NarrowPhases/ExpandingPolytopeAlgorithm.h"
@@ -19,6 +20,17 @@ CPolygon::~CPolygon()
 	DestroyBuffers();
 }
 
+std::shared_ptr<CPolygon> CPolygon::CreateShapeCopy() const
+{
+	std::shared_ptr<CPolygon> copy(new CPolygon(m_index));
+	copy->points = points;
+	copy->position = position;
+	copy->rotation = rotation;
+	copy->speed = speed;
+	copy->invMass = invMass;
+	return copy;
+}
+
 void CPolygon::Build()
 {
 	m_lines.clear();
@@ -74,11 +86,6 @@ void CPolygon::Draw()
 	glPopMatrix();
 }
 
-size_t	CPolygon::GetIndex() const
-{
-	return m_index;
-}
-
 float	CPolygon::GetArea() const
 {
 	return fabsf(m_signedArea);
@@ -112,9 +119,9 @@ Circle CPolygon::GetCircle() const
 
 void CPolygon::OnTransformUpdated()
 {
-	if (onTransformUpdatedCallback) 
+	if (movedPolygons != nullptr)
 	{
-		onTransformUpdatedCallback(*this); 
+		movedPolygons->Add(*this);
 	}
 }
 
@@ -2,6 +2,7 @@
 #define _POLYGON_H_
 
 #include <GL/glew.h>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -9,6 +10,8 @@
 
 #include "Maths.h"
 
+class CMovedPolygons;
+
 enum class CollisionState
 {
 	NOT_COLLIDING,
@@ -43,7 +46,10 @@ public:
 
 	CollisionState collisionState = CollisionState::NOT_COLLIDING;
 
-	std::function<void(const CPolygon&)> onTransformUpdatedCallback;
+	// Set by the broad phase holding the polygon, which updates its body once per query rather than on every change of the transform (see CMovedPolygons)
+	CMovedPolygons*		movedPolygons = nullptr;
+	uint32_t			broadPhaseBody = 0;
+	int					indexInMovedPolygons = -1;
 
 	GETTER(position)
 	//SETTER(position, OnTransformUpdated)
@@ -87,7 +93,9 @@ public:
 
 	void				Build();
 	void				Draw();
-	size_t				GetIndex() const;
+	// Same points and transform without the rendering buffers, for the broad phases tried aside (see BroadPhaseSwitcher)
+	std::shared_ptr<CPolygon>	CreateShapeCopy() const;
+	size_t				GetIndex() const { return m_index; }
 
 	float				GetArea() const;
 	Circle				GetCircle() const;
@@ -154,33 +162,37 @@ private:
 typedef std::shared_ptr<CPolygon>	CPolygonPtr;
 
 
+// Pair of polygons by their indices in the world (see CPolygon::GetIndex), valid for the frame it is found in :
+// no reference is counted when the broad phases emit it, the narrow phase reading the polygons from the world.
 class SPolygonPair
 {
 private:
-	// polyA < polyB
-	CPolygonPtr	polyA;
-	CPolygonPtr	polyB;
+	// bodyA < bodyB
+	uint32_t	bodyA;
+	uint32_t	bodyB;
 
 public:
-	GETTER(polyA)
-	GETTER(polyB)
+	GETTER(bodyA)
+	GETTER(bodyB)
 
-	SPolygonPair(const CPolygonPtr& _polyA, const CPolygonPtr& _polyB) : polyA(_polyA), polyB(_polyB)
+	SPolygonPair(uint32_t _bodyA, uint32_t _bodyB) : bodyA(Min(_bodyA, _bodyB)), bodyB(Max(_bodyA, _bodyB))
 	{
-		if (_polyA == _polyB)
-		{
-			throw std::exception("SPolygonPair : polyA and polyB can't be the same.");
-		}
+		assert(_bodyA != _bodyB && "SPolygonPair : bodyA and bodyB can't be the same.");
+	}
 
-		if (_polyA > _polyB)
-		{
-			swap(polyA, polyB);
-		}
+	SPolygonPair(const CPolygonPtr& _polyA, const CPolygonPtr& _polyB) : SPolygonPair(uint32_t(_polyA->GetIndex()), uint32_t(_polyB->GetIndex()))
+	{
+	}
+
+	// bodyA in the high bits, so the keys sort as the pairs
+	uint64_t GetKey() const
+	{
+		return (uint64_t(bodyA) << 32) | bodyB;
 	}
 
 	bool operator==(const SPolygonPair& rhs) const
 	{
-		return (polyA == rhs.polyA) && (polyB == rhs.polyB); // polyA < polyB => opti
+		return GetKey() == rhs.GetKey();
 	}
 };
 
@@ -191,18 +203,14 @@ namespace std {
 	{
 		std::size_t operator()(const SPolygonPair& pair) const
 		{
-			using std::size_t;
-			using std::hash;
-			using std::string;
-
-			// Compute individual hash values for first,
-			// second and third and combine them using XOR
-			// and bit shifting:
-
-			size_t p1 = (size_t)pair.GetpolyA().get();
-			size_t p2 = (size_t)pair.GetpolyB().get();
-
-			return (3463 * p1) ^ (3467 * p2);
+			// 64 bits finalizer of MurmurHash3 : the keys of close indices only differ in their low bits
+			uint64_t key = pair.GetKey();
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdull;
+			key ^= key >> 33;
+			key *= 0xc4ceb9fe1a85ec53ull;
+			key ^= key >> 33;
+			return std::size_t(key);
 		}
 	};
 
@@ -12,6 +12,9 @@ enum class Key : unsigned int
 	F5,
 	F6,
 	F7,
+	F8,
+	F9,
+	F10,
 
 	Count,
 };
@@ -19,6 +19,9 @@ CSDLRenderWindow::CSDLRenderWindow(int width, int height)
 	m_sdlKeyMap[SDL_SCANCODE_F5] = Key::F5;
 	m_sdlKeyMap[SDL_SCANCODE_F6] = Key::F6;
 	m_sdlKeyMap[SDL_SCANCODE_F7] = Key::F7;
+	m_sdlKeyMap[SDL_SCANCODE_F8] = Key::F8;
+	m_sdlKeyMap[SDL_SCANCODE_F9] = Key::F9;
+	m_sdlKeyMap[SDL_SCANCODE_F10] = Key::F10;
 }
 
 void CSDLRenderWindow::Init()
@@ -0,0 +1,52 @@
+#ifndef _SCENE_BROAD_PHASE_BENCHMARK_H_
+#define _SCENE_BROAD_PHASE_BENCHMARK_H_
+
+#include "BaseScene.h"
+
+#include "Behaviors/SimplePolygonBounce.h"
+#include "Behaviors/BroadPhaseBenchmark.h"
+
+// Many small polygons moving without physics response, only the broad phase and the narrow phase run
+class CSceneBroadPhaseBenchmark : public CBaseScene
+{
+public:
+	CSceneBroadPhaseBenchmark(size_t polyCount)
+		: CBaseScene(1.0f, 40.0f), m_polyCount(polyCount){}
+
+protected:
+	virtual void Create() override
+	{
+		CBaseScene::Create();
+
+		// quadratic broad phases would make the scene unusable
+		gVars->pPhysicEngine->SelectBroadPhase("AABB tree");
+
+		gVars->pWorld->AddBehavior<CSimplePolygonBounce>(nullptr);
+		gVars->pWorld->AddBehavior<CBroadPhaseBenchmark>(nullptr);
+
+		float width = gVars->pRenderer->GetWorldWidth();
+		float height = gVars->pRenderer->GetWorldHeight();
+
+		SRandomPolyParams params;
+		params.minRadius = 0.05f;
+		params.maxRadius = 0.15f;
+		params.minBounds = Vec2(-width * 0.5f + m_borderSize, -height * 0.5f + m_borderSize);
+		params.maxBounds = params.minBounds * -1.0f;
+		params.minPoints = 3;
+		params.maxPoints = 16; // above 8 points, the AABBs are moved from the base AABB of the polygon (see UpdateAABBTransformFromPolygon)
+		params.minSpeed = 1.0f;
+		params.maxSpeed = 3.0f;
+
+		for (size_t i = 0; i < m_polyCount; ++i)
+		{
+			CPolygonPtr poly = gVars->pWorld->AddRandomPoly(params);
+			poly->density = 0.0f; // moved by CSimplePolygonBounce only
+			gVars->pPhysicEngine->AddPolygon(poly, false);
+		}
+	}
+
+private:
+	size_t m_polyCount;
+};
+
+#endif
@@ -56,16 +56,17 @@ private:
 			gVars->pRenderer->DisplayText("Amount of pairs to check : " + std::to_string(pairs.size()));
 
 			std::vector<SCollision> collisions;
+			const std::vector<CPolygonPtr>& worldPolygons = gVars->pWorld->GetPolygons();
 			for (const SPolygonPair& pair : pairs)
 			{
 				SCollision collision;
-				collision.polyA = pair.GetpolyA();
-				collision.polyB = pair.GetpolyB();
-				if (pair.GetpolyA()->CheckCollision(*(pair.GetpolyB()), collision.point, collision.normal, collision.distance))
+				collision.polyA = worldPolygons[pair.GetbodyA()];
+				collision.polyB = worldPolygons[pair.GetbodyB()];
+				if (collision.polyA->CheckCollision(*(collision.polyB), collision.point, collision.normal, collision.distance))
 				{
 					collisions.push_back(collision);
-					pair.GetpolyA()->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
-					pair.GetpolyB()->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
+					collision.polyA->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
+					collision.polyB->collisionState = CollisionState::NARROW_PHASE_SUCCESS;
 				}
 			}
 
@@ -81,14 +82,14 @@ private:
 
 		void AddPolygon(const CPolygonPtr& polygon)
 		{
-			m_broadPhase->OnObjectAdded(polygon);
+			m_broadPhase.AddPolygon(polygon);
 			m_polygons.push_back(polygon);
 		}
 
 		void RemovePolygon(const CPolygonPtr& polygon)
 		{
 			m_polygons.erase(std::remove(m_polygons.begin(), m_polygons.end(), polygon), m_polygons.end());
-			m_broadPhase->OnObjectRemoved(polygon);
+			m_broadPhase.RemovePolygon(polygon);
 		}
 	};
 
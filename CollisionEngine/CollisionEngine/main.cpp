@@ -17,6 +17,10 @@
 #include "Scenes/SceneSmallPhysic.h"
 #include "Scenes/SceneComplexPhysic.h"
 #include "Scenes/SceneFluid.h"
+#include "Scenes/SceneBroadPhaseBenchmark.h"
+#include "Fluids/OOP/AdvectionBenchmark.hpp"
+#include "Fluids/OOP/ProbeCheck.hpp"
+#include "Parallel.h"
 
 
 extern "C" { FILE __iob_func[3] = { *stdin,*stdout,*stderr }; }
@@ -25,6 +29,29 @@ extern "C" { FILE __iob_func[3] = { *stdin,*stdout,*stderr }; }
 */
 int _tmain(int argc, char** argv)
 {
+    // benchmarks and checks run without the window, so that their timings are not shared with the rendering and the job system is free
+    if (argc > 1 && std::string(argv[1]) == "--advection-benchmark")
+    {
+        // the advection runs on the job system, its timings depend on the amount of threads
+        std::cout << "Job system threads : " << CJobSystem::Get().GetWorkerCount() << std::endl;
+        for (const AdvectionBenchmarkResult& result : RunAdvectionBenchmark({ 64, 128, 256 }))
+        {
+            std::cout << result.ToString() << std::endl;
+        }
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--probe-check")
+    {
+        bool passed = true;
+        for (const ProbeCheckResult& result : RunProbeCheck())
+        {
+            std::cout << result.ToString() << std::endl;
+            passed = passed && result.HasPassed();
+        }
+        return passed ? 0 : 1;
+    }
+
     InitApplication(1260, 768, 50.0f);
 
     gVars->pSceneManager->AddScene(new CSceneFluid());
@@ -34,6 +61,7 @@ int _tmain(int argc, char** argv)
     gVars->pSceneManager->AddScene(new CSceneSpheres());
     gVars->pSceneManager->AddScene(new CSceneSmallPhysic());
     gVars->pSceneManager->AddScene(new CSceneComplexPhysic(25));
+    gVars->pSceneManager->AddScene(new CSceneBroadPhaseBenchmark(10000));
 
 
     RunApplication();